@@ -0,0 +1,332 @@
+#include "BusBinaryLog.hpp"
+#include "BusMappedFile.hpp"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+
+namespace Bus {
+    static const char logMagic[8] = { 'B', 'U', 'S', 'L', 'O', 'G', 0, 2 };
+
+    enum class LogTag : uint8_t { End, Location, Message };
+
+    struct LogHeader final {
+        char magic[8];
+        uint64_t segment;
+        uint64_t used;
+        uint64_t reserved;
+    };
+
+    // Records are written field by field, so no padding reaches the file.
+    struct LocationRecord final {
+        uint32_t id;
+        int32_t line;
+        uint16_t moduleSize;
+        uint16_t fileSize;
+        uint16_t functionSize;
+        static constexpr size_t encodedSize = 14;
+    };
+
+    struct MessageRecord final {
+        uint8_t level;
+        uint64_t timestamp;
+        uint64_t thread;
+        uint32_t location;
+        uint32_t size;
+        static constexpr size_t encodedSize = 25;
+    };
+
+    template <typename T>
+    static char* put(char* ptr, const T& val) {
+        std::memcpy(ptr, &val, sizeof(T));
+        return ptr + sizeof(T);
+    }
+    static char* put(char* ptr, const char* str, size_t size) {
+        if(size)
+            std::memcpy(ptr, str, size);
+        return ptr + size;
+    }
+    static char* encode(char* ptr, const LocationRecord& record) {
+        ptr = put(ptr, record.id);
+        ptr = put(ptr, record.line);
+        ptr = put(ptr, record.moduleSize);
+        ptr = put(ptr, record.fileSize);
+        return put(ptr, record.functionSize);
+    }
+    static char* encode(char* ptr, const MessageRecord& record) {
+        ptr = put(ptr, record.level);
+        ptr = put(ptr, record.timestamp);
+        ptr = put(ptr, record.thread);
+        ptr = put(ptr, record.location);
+        return put(ptr, record.size);
+    }
+    static uint16_t clampSize(const char* str) {
+        return static_cast<uint16_t>(
+            (std::min)(str ? std::strlen(str) : 0, size_t(UINT16_MAX)));
+    }
+
+    size_t BinaryLogWriter::LocationKeyHash::
+    operator()(const LocationKey& key) const {
+        std::hash<const void*> hasher;
+        size_t res = hasher(key.module);
+        res = res * 31 + hasher(key.srcFile);
+        res = res * 31 + hasher(key.functionName);
+        return res * 31 + std::hash<int>{}(key.line);
+    }
+
+    // Index of the segment file <path>.<index>, or -1.
+    static int64_t segmentIndex(const fs::path& path, const fs::path& file) {
+        auto prefix = path.filename().string() + '.';
+        auto name = file.filename().string();
+        if(name.size() <= prefix.size() || name.size() > prefix.size() + 18 ||
+           name.compare(0, prefix.size(), prefix) != 0)
+            return -1;
+        int64_t res = 0;
+        for(size_t i = prefix.size(); i < name.size(); ++i) {
+            if(name[i] < '0' || name[i] > '9')
+                return -1;
+            res = res * 10 + (name[i] - '0');
+        }
+        return res;
+    }
+
+    BinaryLogWriter::BinaryLogWriter(const BinaryLogConfig& config)
+        : mConfig(config), mOffset(0), mSegment(0) {
+        // Large enough for a header plus the biggest possible location.
+        mConfig.segmentSize = (std::max)(mConfig.segmentSize, size_t(1) << 18);
+        mConfig.maxSegments = (std::max)(mConfig.maxSegments, 1U);
+        // Continue after the segments of an earlier run, so the numbering
+        // stays in write order, and drop those that fall out of the window.
+        auto dir = mConfig.path.parent_path();
+        std::error_code ec;
+        std::vector<std::pair<int64_t, fs::path>> existing;
+        for(auto&& entry :
+            fs::directory_iterator(dir.empty() ? "." : dir, ec)) {
+            int64_t index = segmentIndex(mConfig.path, entry.path());
+            if(index >= 0) {
+                existing.emplace_back(index, entry.path());
+                mSegment = (std::max)(mSegment,
+                                      static_cast<uint64_t>(index) + 1);
+            }
+        }
+        for(auto&& [index, file] : existing)
+            if(static_cast<uint64_t>(index) + mConfig.maxSegments <= mSegment)
+                fs::remove(file, ec);
+        open();
+    }
+    BinaryLogWriter::~BinaryLogWriter() {
+        close();
+    }
+
+    void BinaryLogWriter::open() {
+        mFilePath = mConfig.path;
+        mFilePath += '.' + std::to_string(mSegment);
+        mFile = std::make_unique<MappedFile>(mFilePath, mConfig.segmentSize);
+        LogHeader header{};
+        std::memcpy(header.magic, logMagic, sizeof(logMagic));
+        header.segment = mSegment;
+        header.used = mOffset = sizeof(LogHeader);
+        std::memcpy(mFile->data(), &header, sizeof(header));
+        mLocations.clear();
+        if(mSegment >= mConfig.maxSegments) {
+            fs::path old = mConfig.path;
+            old += '.' + std::to_string(mSegment - mConfig.maxSegments);
+            std::error_code ec;
+            fs::remove(old, ec);
+        }
+    }
+
+    void BinaryLogWriter::close() {
+        if(!mFile)
+            return;
+        mFile->flush(0, mOffset);
+        mFile.reset();
+        std::error_code ec;
+        fs::resize_file(mFilePath, mOffset, ec);
+    }
+
+    void BinaryLogWriter::rotate() {
+        close();
+        ++mSegment;
+        open();
+    }
+
+    bool BinaryLogWriter::fits(size_t size) const {
+        // One byte is kept for the End tag.
+        return mOffset + size + 1 <= mFile->size();
+    }
+
+    char* BinaryLogWriter::reserve(size_t size) {
+        if(!fits(size))
+            rotate();
+        char* base = static_cast<char*>(mFile->data());
+        char* res = base + mOffset;
+        mOffset += size;
+        base[mOffset] = static_cast<char>(LogTag::End);
+        return res;
+    }
+
+    uint32_t BinaryLogWriter::locate(const SourceLocation& loc) {
+        LocationKey key{ loc.module, loc.srcFile, loc.functionName, loc.line };
+        auto iter = mLocations.find(key);
+        if(iter != mLocations.cend())
+            return iter->second;
+        LocationRecord record{ static_cast<uint32_t>(mLocations.size()),
+                               loc.line, clampSize(loc.module),
+                               clampSize(loc.srcFile),
+                               clampSize(loc.functionName) };
+        char* ptr = reserve(1 + LocationRecord::encodedSize +
+                            record.moduleSize + record.fileSize +
+                            record.functionSize);
+        ptr = put(ptr, LogTag::Location);
+        ptr = encode(ptr, record);
+        ptr = put(ptr, loc.module, record.moduleSize);
+        ptr = put(ptr, loc.srcFile, record.fileSize);
+        put(ptr, loc.functionName, record.functionSize);
+        mLocations.emplace(key, record.id);
+        return record.id;
+    }
+
+    void BinaryLogWriter::write(ReportLevel level, const std::string& message,
+                                const SourceLocation& loc) {
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        MessageRecord record{
+            static_cast<uint8_t>(level),
+            static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now)
+                    .count()),
+            std::hash<std::thread::id>{}(std::this_thread::get_id()), 0, 0
+        };
+        std::lock_guard guard(mMutex);
+        size_t location = 1 + LocationRecord::encodedSize +
+            clampSize(loc.module) + clampSize(loc.srcFile) +
+            clampSize(loc.functionName);
+        size_t limit = mConfig.segmentSize - sizeof(LogHeader) - location -
+            MessageRecord::encodedSize - 2;
+        record.size = static_cast<uint32_t>((std::min)(message.size(), limit));
+        size_t size = 1 + MessageRecord::encodedSize + record.size;
+        // The location must live in the same segment as the message.
+        record.location = locate(loc);
+        if(!fits(size)) {
+            rotate();
+            record.location = locate(loc);
+        }
+        char* ptr = reserve(size);
+        ptr = put(ptr, LogTag::Message);
+        ptr = encode(ptr, record);
+        put(ptr, message.data(), record.size);
+        reinterpret_cast<LogHeader*>(mFile->data())->used = mOffset;
+    }
+
+    fs::path BinaryLogWriter::currentSegment() {
+        std::lock_guard guard(mMutex);
+        return mFilePath;
+    }
+
+    ReportFunction makeBinaryLogSink(std::shared_ptr<BinaryLogWriter> writer) {
+        return [writer](ReportLevel level, const std::string& message,
+                        const SourceLocation& loc) {
+            writer->write(level, message, loc);
+        };
+    }
+
+    static const char* levelName(uint8_t level) {
+        switch(static_cast<ReportLevel>(level)) {
+            case ReportLevel::Warning:
+                return "Warning";
+            case ReportLevel::Debug:
+                return "Debug";
+            case ReportLevel::Error:
+                return "Error";
+            case ReportLevel::Info:
+                return "Info";
+        }
+        return "Unknown";
+    }
+
+    void decodeBinaryLog(const fs::path& path, std::ostream& out) {
+        BUS_TRACE_BEGIN("BusBinaryLog") {
+            MappedFile file(path);
+            const char* base = static_cast<const char*>(file.data());
+            LogHeader header;
+            if(file.size() < sizeof(header))
+                BUS_TRACE_THROW(std::runtime_error("Bad log file " +
+                                                   path.string()));
+            std::memcpy(&header, base, sizeof(header));
+            if(std::memcmp(header.magic, logMagic, sizeof(logMagic)) != 0)
+                BUS_TRACE_THROW(std::runtime_error("Bad log file " +
+                                                   path.string()));
+            size_t end = (std::min)(static_cast<size_t>(header.used),
+                                    file.size());
+            struct Location final {
+                std::string_view module, srcFile, functionName;
+                int line;
+            };
+            std::vector<Location> locations;
+            size_t pos = sizeof(header);
+            auto fetch = [&](void* dst, size_t size) {
+                if(pos + size > end)
+                    BUS_TRACE_THROW(std::runtime_error("Truncated log file " +
+                                                       path.string()));
+                std::memcpy(dst, base + pos, size);
+                pos += size;
+            };
+            auto view = [&](size_t size) {
+                if(pos + size > end)
+                    BUS_TRACE_THROW(std::runtime_error("Truncated log file " +
+                                                       path.string()));
+                std::string_view res(base + pos, size);
+                pos += size;
+                return res;
+            };
+            while(pos < end) {
+                LogTag tag;
+                fetch(&tag, sizeof(tag));
+                if(tag == LogTag::End)
+                    break;
+                if(tag == LogTag::Location) {
+                    LocationRecord record;
+                    fetch(&record.id, sizeof(record.id));
+                    fetch(&record.line, sizeof(record.line));
+                    fetch(&record.moduleSize, sizeof(record.moduleSize));
+                    fetch(&record.fileSize, sizeof(record.fileSize));
+                    fetch(&record.functionSize, sizeof(record.functionSize));
+                    Location loc;
+                    loc.module = view(record.moduleSize);
+                    loc.srcFile = view(record.fileSize);
+                    loc.functionName = view(record.functionSize);
+                    loc.line = record.line;
+                    if(record.id >= locations.size())
+                        locations.resize(record.id + 1);
+                    locations[record.id] = loc;
+                } else if(tag == LogTag::Message) {
+                    MessageRecord record;
+                    fetch(&record.level, sizeof(record.level));
+                    fetch(&record.timestamp, sizeof(record.timestamp));
+                    fetch(&record.thread, sizeof(record.thread));
+                    fetch(&record.location, sizeof(record.location));
+                    fetch(&record.size, sizeof(record.size));
+                    auto message = view(record.size);
+                    auto sec = static_cast<std::time_t>(record.timestamp /
+                                                        1000000000ULL);
+                    out << '[' << std::put_time(std::gmtime(&sec), "%F %T")
+                        << '.' << std::setw(9) << std::setfill('0')
+                        << record.timestamp % 1000000000ULL << "] ["
+                        << levelName(record.level) << "] [" << std::hex
+                        << record.thread << std::dec << "] ";
+                    if(record.location < locations.size()) {
+                        auto&& loc = locations[record.location];
+                        out << loc.module << ' ' << loc.srcFile << ':'
+                            << loc.line << ' ' << loc.functionName << ": ";
+                    }
+                    out << message << '\n';
+                } else
+                    BUS_TRACE_THROW(std::runtime_error("Bad record in " +
+                                                       path.string()));
+            }
+        }
+        BUS_TRACE_END();
+    }
+}  // namespace Bus
@@ -0,0 +1,58 @@
+#pragma once
+#include "BusReporter.hpp"
+#include <iosfwd>
+#include <unordered_map>
+
+namespace Bus {
+    class MappedFile;
+
+    struct BinaryLogConfig final {
+        fs::path path;
+        size_t segmentSize = 64ULL << 20;
+        unsigned maxSegments = 4;
+    };
+
+    // Writes Reporter records into memory-mapped segments named
+    // <path>.<index>. Each SourceLocation is written once per segment and then
+    // referenced by id. A new writer continues after the segments already on
+    // disk. Use decodeBinaryLog to turn a segment back into text.
+    class BinaryLogWriter final : private Unmoveable {
+    private:
+        struct LocationKey final {
+            const char* module;
+            const char* srcFile;
+            const char* functionName;
+            int line;
+            bool operator==(const LocationKey& rhs) const {
+                return module == rhs.module && srcFile == rhs.srcFile &&
+                    functionName == rhs.functionName && line == rhs.line;
+            }
+        };
+        struct LocationKeyHash final {
+            size_t operator()(const LocationKey& key) const;
+        };
+        std::mutex mMutex;
+        BinaryLogConfig mConfig;
+        std::unique_ptr<MappedFile> mFile;
+        fs::path mFilePath;
+        size_t mOffset;
+        uint64_t mSegment;
+        std::unordered_map<LocationKey, uint32_t, LocationKeyHash> mLocations;
+        void open();
+        void close();
+        void rotate();
+        bool fits(size_t size) const;
+        char* reserve(size_t size);
+        uint32_t locate(const SourceLocation& loc);
+
+    public:
+        explicit BinaryLogWriter(const BinaryLogConfig& config);
+        ~BinaryLogWriter();
+        void write(ReportLevel level, const std::string& message,
+                   const SourceLocation& loc);
+        fs::path currentSegment();
+    };
+
+    ReportFunction makeBinaryLogSink(std::shared_ptr<BinaryLogWriter> writer);
+    void decodeBinaryLog(const fs::path& path, std::ostream& out);
+}  // namespace Bus
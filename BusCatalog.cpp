@@ -0,0 +1,251 @@
+#include "BusCatalog.hpp"
+#include "BusMappedFile.hpp"
+#include "BusReporter.hpp"
+#include <cstring>
+#include <fstream>
+
+namespace Bus {
+    static const char catalogMagic[8] = { 'B', 'U', 'S', 'C', 'A', 'T', 0, 2 };
+
+    struct CatalogHeader final {
+        char magic[8];
+        uint64_t moduleCount;
+        uint64_t interfaceCount;
+        uint64_t stringCount;
+        uint64_t dependencyCount;
+        uint64_t charCount;
+    };
+
+    static size_t align8(size_t size) {
+        return (size + 7) & ~size_t(7);
+    }
+
+    ModuleCatalog::ModuleCatalog(const fs::path& path)
+        : mModules(nullptr), mInterfaces(nullptr), mStrings(nullptr),
+          mDependencies(nullptr), mChars(nullptr), mModuleCount(0) {
+        std::error_code ec;
+        if(!fs::exists(path, ec))
+            return;
+        try {
+            mFile = std::make_unique<MappedFile>(path);
+        } catch(...) {
+            return;
+        }
+        if(!validate()) {
+            mModules = nullptr;
+            mModuleCount = 0;
+            return;
+        }
+        for(size_t i = 0; i < mModuleCount; ++i)
+            mPaths.emplace(string(mModules[i].path), i);
+    }
+
+    ModuleCatalog::~ModuleCatalog() = default;
+
+    bool ModuleCatalog::validate() {
+        auto base = static_cast<const char*>(mFile->data());
+        size_t size = mFile->size();
+        CatalogHeader header;
+        if(size < sizeof(header))
+            return false;
+        std::memcpy(&header, base, sizeof(header));
+        if(std::memcmp(header.magic, catalogMagic, sizeof(catalogMagic)) != 0)
+            return false;
+        // Guard the size computation below against overflow.
+        const uint64_t limit = UINT32_MAX;
+        if(header.moduleCount > limit || header.interfaceCount > limit ||
+           header.stringCount > limit || header.dependencyCount > limit ||
+           header.charCount > limit)
+            return false;
+        size_t offset = sizeof(header);
+        size_t modules = offset;
+        offset += align8(header.moduleCount * sizeof(CatalogModule));
+        size_t interfaces = offset;
+        offset += align8(header.interfaceCount * sizeof(CatalogInterface));
+        size_t strings = offset;
+        offset += align8(header.stringCount * sizeof(CatalogString));
+        size_t dependencies = offset;
+        offset += header.dependencyCount * 2 * sizeof(uint64_t);
+        size_t chars = offset;
+        offset += header.charCount;
+        if(offset > size)
+            return false;
+        mModules = reinterpret_cast<const CatalogModule*>(base + modules);
+        mInterfaces =
+            reinterpret_cast<const CatalogInterface*>(base + interfaces);
+        mStrings = reinterpret_cast<const CatalogString*>(base + strings);
+        mDependencies = reinterpret_cast<const uint64_t*>(base + dependencies);
+        mChars = base + chars;
+        mModuleCount = static_cast<size_t>(header.moduleCount);
+        auto checkString = [&](CatalogString str) {
+            return uint64_t(str.offset) + str.size <= header.charCount;
+        };
+        auto checkRange = [](uint32_t first, uint32_t count, uint64_t total) {
+            return uint64_t(first) + count <= total;
+        };
+        for(size_t i = 0; i < header.stringCount; ++i)
+            if(!checkString(mStrings[i]))
+                return false;
+        for(size_t i = 0; i < header.interfaceCount; ++i)
+            if(!checkString(mInterfaces[i].name) ||
+               !checkRange(mInterfaces[i].firstFunction,
+                           mInterfaces[i].functionCount, header.stringCount))
+                return false;
+        for(size_t i = 0; i < mModuleCount; ++i) {
+            auto&& module = mModules[i];
+            for(auto str : { module.path, module.name, module.busVersion,
+                             module.version, module.description,
+                             module.copyright })
+                if(!checkString(str))
+                    return false;
+            if(!checkRange(module.firstInterface, module.interfaceCount,
+                           header.interfaceCount) ||
+               !checkRange(module.firstSearchPath, module.searchPathCount,
+                           header.stringCount) ||
+               !checkRange(module.firstDependency, module.dependencyCount,
+                           header.dependencyCount))
+                return false;
+        }
+        return true;
+    }
+
+    const CatalogModule* ModuleCatalog::find(Name path) const {
+        auto iter = mPaths.find(path);
+        return iter == mPaths.cend() ? nullptr : mModules + iter->second;
+    }
+
+    ModuleInfo ModuleCatalog::info(const CatalogModule& module) const {
+        ModuleInfo res;
+        res.name = string(module.name);
+        res.guid = GUID(module.guidFirst, module.guidSecond);
+        res.busVersion = string(module.busVersion);
+        res.version = string(module.version);
+        res.description = string(module.description);
+        res.copyright = string(module.copyright);
+        for(uint32_t i = 0; i < module.searchPathCount; ++i)
+            res.thirdPartySearchPath.emplace_back(
+                string(mStrings[module.firstSearchPath + i]));
+        for(uint32_t i = 0; i < module.dependencyCount; ++i) {
+            auto dep = mDependencies + 2 * (module.firstDependency + i);
+            res.dependencies.emplace_back(dep[0], dep[1]);
+        }
+        res.modulePath = fs::u8path(string(module.path));
+        return res;
+    }
+
+    std::vector<Name>
+    ModuleCatalog::interfaces(const CatalogModule& module) const {
+        std::vector<Name> res;
+        for(uint32_t i = 0; i < module.interfaceCount; ++i)
+            res.emplace_back(
+                string(mInterfaces[module.firstInterface + i].name));
+        return res;
+    }
+
+    std::vector<Name> ModuleCatalog::list(const CatalogModule& module,
+                                          Name interfaceName) const {
+        std::vector<Name> res;
+        for(uint32_t i = 0; i < module.interfaceCount; ++i) {
+            auto&& inter = mInterfaces[module.firstInterface + i];
+            if(string(inter.name) != interfaceName)
+                continue;
+            for(uint32_t j = 0; j < inter.functionCount; ++j)
+                res.emplace_back(string(mStrings[inter.firstFunction + j]));
+        }
+        return res;
+    }
+
+    CatalogString CatalogWriter::store(Name str) {
+        auto iter = mPool.find(std::string(str));
+        if(iter != mPool.cend())
+            return iter->second;
+        CatalogString res{ static_cast<uint32_t>(mChars.size()),
+                           static_cast<uint32_t>(str.size()) };
+        mChars += str;
+        mPool.emplace(std::string(str), res);
+        return res;
+    }
+
+    void CatalogWriter::add(Name path, uint64_t fileSize, int64_t writeTime,
+                            const ModuleInfo& info,
+                            const ModuleDescriptor* functions,
+                            const std::vector<Name>& interfaces) {
+        CatalogModule module{};
+        module.fileSize = fileSize;
+        module.writeTime = writeTime;
+        module.guidFirst = info.guid.first;
+        module.guidSecond = info.guid.second;
+        module.path = store(path);
+        module.name = store(info.name);
+        module.busVersion = store(info.busVersion);
+        module.version = store(info.version);
+        module.description = store(info.description);
+        module.copyright = store(info.copyright);
+        module.firstSearchPath = static_cast<uint32_t>(mStrings.size());
+        module.searchPathCount =
+            static_cast<uint32_t>(info.thirdPartySearchPath.size());
+        for(auto p : info.thirdPartySearchPath)
+            mStrings.emplace_back(store(p));
+        module.firstDependency =
+            static_cast<uint32_t>(mDependencies.size() / 2);
+        module.dependencyCount =
+            static_cast<uint32_t>(info.dependencies.size());
+        for(auto dep : info.dependencies) {
+            mDependencies.emplace_back(dep.first);
+            mDependencies.emplace_back(dep.second);
+        }
+        module.opaque = functions == nullptr;
+        module.firstInterface = static_cast<uint32_t>(mInterfaces.size());
+        if(functions)
+            for(auto name : interfaces) {
+                CatalogInterface inter{ store(name),
+                                        static_cast<uint32_t>(mStrings.size()),
+                                        0 };
+                for(auto func : functions->list(name)) {
+                    mStrings.emplace_back(store(func));
+                    ++inter.functionCount;
+                }
+                mInterfaces.emplace_back(inter);
+            }
+        module.interfaceCount =
+            static_cast<uint32_t>(mInterfaces.size()) - module.firstInterface;
+        mModules.emplace_back(module);
+    }
+
+    void CatalogWriter::write(const fs::path& path) const {
+        BUS_TRACE_BEGIN("BusCatalog") {
+            fs::path tmp = path;
+            tmp += ".tmp";
+            {
+                std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                CatalogHeader header{};
+                std::memcpy(header.magic, catalogMagic, sizeof(catalogMagic));
+                header.moduleCount = mModules.size();
+                header.interfaceCount = mInterfaces.size();
+                header.stringCount = mStrings.size();
+                header.dependencyCount = mDependencies.size() / 2;
+                header.charCount = mChars.size();
+                const char padding[8] = {};
+                auto put = [&](const void* data, size_t size) {
+                    out.write(static_cast<const char*>(data),
+                              static_cast<std::streamsize>(size));
+                    out.write(padding, static_cast<std::streamsize>(
+                                           align8(size) - size));
+                };
+                put(&header, sizeof(header));
+                put(mModules.data(), mModules.size() * sizeof(CatalogModule));
+                put(mInterfaces.data(),
+                    mInterfaces.size() * sizeof(CatalogInterface));
+                put(mStrings.data(), mStrings.size() * sizeof(CatalogString));
+                put(mDependencies.data(),
+                    mDependencies.size() * sizeof(uint64_t));
+                put(mChars.data(), mChars.size());
+                if(!out)
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Failed to write catalog " + tmp.string()));
+            }
+            fs::rename(tmp, path);
+        }
+        BUS_TRACE_END();
+    }
+}  // namespace Bus
@@ -0,0 +1,115 @@
+#pragma once
+#include "BusManifest.hpp"
+#include <unordered_map>
+
+namespace Bus {
+    class MappedFile;
+
+    struct CatalogString final {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct CatalogModule final {
+        uint64_t fileSize;
+        int64_t writeTime;
+        uint64_t guidFirst;
+        uint64_t guidSecond;
+        CatalogString path;
+        CatalogString name;
+        CatalogString busVersion;
+        CatalogString version;
+        CatalogString description;
+        CatalogString copyright;
+        uint32_t firstInterface;
+        uint32_t interfaceCount;
+        uint32_t firstSearchPath;
+        uint32_t searchPathCount;
+        uint32_t firstDependency;
+        uint32_t dependencyCount;
+        // Set when the module doesn't enumerate its interfaces, so the
+        // catalog can't describe it and it has to be loaded eagerly.
+        uint32_t opaque;
+        uint32_t reserved;
+    };
+
+    struct CatalogInterface final {
+        CatalogString name;
+        uint32_t firstFunction;
+        uint32_t functionCount;
+    };
+
+    // Read-only view of a catalog file. All Names point into the mapping.
+    class ModuleCatalog final : private Unmoveable {
+    private:
+        std::unique_ptr<MappedFile> mFile;
+        const CatalogModule* mModules;
+        const CatalogInterface* mInterfaces;
+        const CatalogString* mStrings;
+        const uint64_t* mDependencies;
+        const char* mChars;
+        size_t mModuleCount;
+        std::unordered_map<Name, size_t> mPaths;
+        bool validate();
+
+    public:
+        explicit ModuleCatalog(const fs::path& path);
+        ~ModuleCatalog();
+        bool valid() const {
+            return mModules != nullptr;
+        }
+        size_t size() const {
+            return mModuleCount;
+        }
+        const CatalogModule& module(size_t index) const {
+            return mModules[index];
+        }
+        const CatalogModule* find(Name path) const;
+        Name string(CatalogString str) const {
+            return Name(mChars + str.offset, str.size);
+        }
+        ModuleInfo info(const CatalogModule& module) const;
+        std::vector<Name> interfaces(const CatalogModule& module) const;
+        std::vector<Name> list(const CatalogModule& module,
+                               Name interfaceName) const;
+    };
+
+    class CatalogDescriptor final : public ModuleDescriptor {
+    private:
+        std::shared_ptr<const ModuleCatalog> mCatalog;
+        const CatalogModule& mModule;
+
+    public:
+        CatalogDescriptor(std::shared_ptr<const ModuleCatalog> catalog,
+                          const CatalogModule& module)
+            : mCatalog(std::move(catalog)), mModule(module) {}
+        ModuleInfo info() const override {
+            return mCatalog->info(mModule);
+        }
+        std::vector<Name> list(Name interfaceName) const override {
+            return mCatalog->list(mModule, interfaceName);
+        }
+        // The registry keeps the mapped names instead of copying them.
+        std::shared_ptr<const void> nameStorage() const override {
+            return mCatalog;
+        }
+    };
+
+    class CatalogWriter final {
+    private:
+        std::vector<CatalogModule> mModules;
+        std::vector<CatalogInterface> mInterfaces;
+        std::vector<CatalogString> mStrings;
+        std::vector<uint64_t> mDependencies;
+        std::string mChars;
+        std::unordered_map<std::string, CatalogString> mPool;
+        CatalogString store(Name str);
+
+    public:
+        // opaque modules are recorded with their info only.
+        void add(Name path, uint64_t fileSize, int64_t writeTime,
+                 const ModuleInfo& info, const ModuleDescriptor* functions,
+                 const std::vector<Name>& interfaces);
+        void write(const fs::path& path) const;
+    };
+}  // namespace Bus
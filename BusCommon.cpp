@@ -1,38 +1,34 @@
 #include "BusCommon.hpp"
-#include <iomanip>
-#include <regex>
-#include <sstream>
 
 namespace Bus {
-    GUID str2GUID(const std::string& guid) {
-        std::regex pat("\\{[A-F0-9]{8}(-[A-F0-9]{4}){3}-[A-F0-9]{12}\\}",
-                       std::regex::ECMAScript | std::regex::nosubs);
-        if(std::regex_match(guid, pat)) {
-            char ch[32];
-            int cnt = 0;
-            auto cast = [](char c) { return c - (c <= '9' ? '0' : 'A' - 10); };
-            for(char c : guid)
-                if(isalnum(c))
-                    ch[cnt++] = cast(c);
-            GUID res;
-            res.first = res.second = 0;
-            for(int i = 0; i < 16; ++i)
-                res.first = res.first * 16ULL + ch[i];
-            for(int i = 16; i < 32; ++i)
-                res.second = res.second * 16ULL + ch[i];
+    bool tryParseGUID(Name str, GUID& guid) {
+        return Detail::parseGUID(str, guid);
+    }
+    GUID str2GUID(Name guid) {
+        GUID res;
+        if(tryParseGUID(guid, res))
             return res;
-        } else
-            throw std::logic_error("Bad GUID" + guid);
+        throw std::logic_error("Bad GUID" + std::string(guid));
+    }
+    void GUID2Str(GUID guid, char* buf) {
+        static const char hex[] = "0123456789ABCDEF";
+        buf[0] = '{';
+        uint64_t val[2] = { guid.first, guid.second };
+        unsigned digit = 0;
+        for(size_t i = 1; i < guidStrSize - 1; ++i) {
+            if(!Detail::isGUIDDigit(i)) {
+                buf[i] = '-';
+                continue;
+            }
+            unsigned shift = 60 - ((digit & 15) << 2);
+            buf[i] = hex[(val[digit >> 4] >> shift) & 15];
+            ++digit;
+        }
+        buf[guidStrSize - 1] = '}';
     }
     std::string GUID2Str(GUID guid) {
-        std::stringstream ss;
-        ss << std::setw(16) << std::setbase(16) << std::setfill('0')
-           << std::noshowbase << std::uppercase << guid.first;
-        ss << std::setw(16) << std::setbase(16) << std::setfill('0')
-           << std::noshowbase << std::uppercase << guid.second;
-        std::string str = ss.str();
-        return '{' + str.substr(0, 8) + '-' + str.substr(8, 4) + '-' +
-            str.substr(12, 4) + '-' + str.substr(16, 4) + '-' +
-            str.substr(20, 12) + '}';
+        std::string res(guidStrSize, '\0');
+        GUID2Str(guid, res.data());
+        return res;
     }
 }  // namespace Bus
@@ -2,7 +2,17 @@
 
 #define BUS_VERSION "0.0.1"
 
+// Functions that must run at compile time where the compiler can enforce it.
+#ifdef __cpp_consteval
+#define BUS_CONSTEVAL consteval
+#else
+#define BUS_CONSTEVAL constexpr
+#endif
+
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -20,13 +30,98 @@ namespace Bus {
     };
 
     using GUID = std::pair<uint64_t, uint64_t>;
-    GUID str2GUID(const std::string& guid);
+
+    // Format: {XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX} with upper-case hex.
+    constexpr size_t guidStrSize = 38;
+
+    namespace Detail {
+        // A table, since branches on random hex digits mispredict.
+        struct HexTable final {
+            unsigned char value[256];
+            constexpr HexTable() : value{} {
+                for(unsigned i = 0; i < 256; ++i)
+                    value[i] = 16;
+                for(unsigned i = 0; i < 10; ++i)
+                    value['0' + i] = static_cast<unsigned char>(i);
+                for(unsigned i = 0; i < 6; ++i)
+                    value['A' + i] = static_cast<unsigned char>(10 + i);
+            }
+        };
+        inline constexpr HexTable hexTable{};
+        constexpr uint64_t hexValue(char c) {
+            return hexTable.value[static_cast<unsigned char>(c)];
+        }
+        constexpr bool isGUIDDigit(size_t pos) {
+            return pos != 0 && pos != 9 && pos != 14 && pos != 19 &&
+                pos != 24 && pos != 37;
+        }
+        constexpr bool parseGUID(Name str, GUID& guid) {
+            if(str.size() != guidStrSize)
+                return false;
+            uint64_t bad = (str[0] != '{') | (str[9] != '-') |
+                (str[14] != '-') | (str[19] != '-') | (str[24] != '-') |
+                (str[37] != '}');
+            uint64_t val[2] = { 0, 0 };
+            unsigned digit = 0;
+            for(size_t i = 1; i < guidStrSize - 1; ++i) {
+                if(!isGUIDDigit(i))
+                    continue;
+                uint64_t hex = hexValue(str[i]);
+                bad |= hex >> 4;
+                val[digit >> 4] = val[digit >> 4] << 4 | (hex & 15);
+                ++digit;
+            }
+            guid.first = val[0], guid.second = val[1];
+            return bad == 0;
+        }
+    }  // namespace Detail
+
+    constexpr GUID parseGUID(Name str) {
+        GUID res(0, 0);
+        if(!Detail::parseGUID(str, res))
+            throw std::logic_error("Bad GUID");
+        return res;
+    }
+
+    inline namespace Literals {
+        // A malformed literal doesn't compile. Before C++20 that only holds
+        // in constant expressions, elsewhere it throws std::logic_error.
+        BUS_CONSTEVAL GUID operator""_guid(const char* str, size_t size) {
+            return parseGUID(Name(str, size));
+        }
+    }  // namespace Literals
+
+    bool tryParseGUID(Name str, GUID& guid);
+    GUID str2GUID(Name guid);
+    void GUID2Str(GUID guid, char* buf);
     std::string GUID2Str(GUID guid);
 
+    struct GUIDHash final {
+        size_t operator()(GUID guid) const {
+            uint64_t x = guid.first ^ (guid.second * 0x9e3779b97f4a7c15ULL);
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return static_cast<size_t>(x ^ (x >> 31));
+        }
+    };
+
     class ModuleSystem;
     class ModuleInstance;
     class Reporter;
     class ModuleFunctionBase;
+    struct FactoryEntry;
+
+    using FunctionFactory =
+        std::function<std::shared_ptr<ModuleFunctionBase>()>;
+
+    // FNV-1a of the interface name. Declare getInterface constexpr to have
+    // it computed at compile time.
+    constexpr uint64_t interfaceId(Name name) {
+        uint64_t res = 0xcbf29ce484222325ULL;
+        for(char c : name)
+            res = (res ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        return res;
+    }
 
     struct ModuleInfo final {
         Name name;
@@ -35,7 +130,12 @@ namespace Bus {
         Name version;
         Name description;
         Name copyright;
+        // Directories relative to the module. The libraries the module
+        // links to are only found there if its manifest or catalog entry
+        // declares them too, as the info itself is read after loading.
         std::vector<Name> thirdPartySearchPath;
+        // Modules that must be initialized before this one.
+        std::vector<GUID> dependencies;
         fs::path modulePath;
     };
 
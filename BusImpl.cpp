@@ -1,4 +1,19 @@
+#include "BusBinaryLog.cpp"
+#include "BusCatalog.cpp"
 #include "BusCommon.cpp"
+#include "BusIsolated.cpp"
+#include "BusManifest.cpp"
+#include "BusMappedFile.cpp"
+#include "BusMemory.cpp"
+#include "BusMessage.cpp"
+#include "BusMetrics.cpp"
 #include "BusModule.cpp"
+#include "BusPipeline.cpp"
+#include "BusPool.cpp"
+#include "BusProfiler.cpp"
+#include "BusRegistry.cpp"
 #include "BusReporter.cpp"
+#include "BusResult.cpp"
+#include "BusScheduler.cpp"
+#include "BusStatic.cpp"
 #include "BusSystem.cpp"
@@ -0,0 +1,924 @@
+#include "BusIsolated.hpp"
+#include "BusManifest.hpp"
+#include "BusReporter.hpp"
+#include "BusSystem.hpp"
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+extern char** environ;
+#endif
+
+namespace Bus {
+#ifdef _WIN32
+    bool ModuleSystem::loadModuleIsolated(const fs::path& path,
+                                          const IsolationConfig&) {
+        BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusIsolated"),
+                   "Isolated modules need posix_spawn and aren't supported "
+                   "on this platform [path=",
+                   path, "].");
+        return false;
+    }
+    int runIsolatedHost(int, char**) {
+        std::cerr << "Isolated modules aren't supported on this platform"
+                  << std::endl;
+        return 1;
+    }
+#else
+    using Word = std::atomic_uint32_t;
+    static_assert(sizeof(Word) == sizeof(uint32_t) &&
+                      Word::is_always_lock_free,
+                  "Words in shared memory must be plain lock-free integers");
+
+#ifdef __linux__
+    // Not FUTEX_PRIVATE_FLAG: the word is shared with another process.
+    static void waitWord(Word& word, uint32_t expected,
+                         std::chrono::nanoseconds timeout) {
+        timespec ts{ static_cast<time_t>(timeout.count() / 1000000000),
+                     static_cast<long>(timeout.count() % 1000000000) };
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT,
+                expected, &ts, nullptr, 0);
+    }
+    static void wakeWord(Word& word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE,
+                INT32_MAX, nullptr, nullptr, 0);
+    }
+#else
+    // Without futexes waiters poll.
+    static void waitWord(Word& word, uint32_t expected,
+                         std::chrono::nanoseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while(word.load(std::memory_order_acquire) == expected &&
+              std::chrono::steady_clock::now() < deadline) {
+            timespec ts{ 0, 50000 };
+            nanosleep(&ts, nullptr);
+        }
+    }
+    static void wakeWord(Word&) {}
+#endif
+
+    // Bounded MPMC queue of slot indices (Vyukov, as RingBuffer) laid out
+    // in place so that it can live in shared memory. The mask comes from
+    // the caller, not from the memory the other process can write.
+    struct SlotQueue final {
+        struct Cell final {
+            Word seq;
+            uint32_t value;
+        };
+        alignas(64) Word head;
+        alignas(64) Word tail;
+
+        Cell* cells() {
+            return reinterpret_cast<Cell*>(this + 1);
+        }
+        static size_t bytes(uint32_t capacity) {
+            return sizeof(SlotQueue) + sizeof(Cell) * capacity;
+        }
+        void init(uint32_t capacity) {
+            head.store(0, std::memory_order_relaxed);
+            tail.store(0, std::memory_order_relaxed);
+            for(uint32_t i = 0; i < capacity; ++i)
+                cells()[i].seq.store(i, std::memory_order_relaxed);
+        }
+        bool push(uint32_t mask, uint32_t value) {
+            uint32_t pos = head.load(std::memory_order_relaxed);
+            while(true) {
+                Cell& cell = cells()[pos & mask];
+                uint32_t seq = cell.seq.load(std::memory_order_acquire);
+                auto diff = static_cast<int32_t>(seq - pos);
+                if(diff == 0) {
+                    if(head.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if(diff < 0)
+                    return false;
+                else
+                    pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        bool pop(uint32_t mask, uint32_t& value) {
+            uint32_t pos = tail.load(std::memory_order_relaxed);
+            while(true) {
+                Cell& cell = cells()[pos & mask];
+                uint32_t seq = cell.seq.load(std::memory_order_acquire);
+                auto diff = static_cast<int32_t>(seq - (pos + 1));
+                if(diff == 0) {
+                    if(tail.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed)) {
+                        value = cell.value;
+                        cell.seq.store(pos + mask + 1,
+                                       std::memory_order_release);
+                        return true;
+                    }
+                } else if(diff < 0)
+                    return false;
+                else
+                    pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    enum HostState : uint32_t { hostStarting, hostReady, hostFailed };
+    enum SlotState : uint32_t { slotPending, slotDone, slotFailed };
+    enum SlotOp : uint32_t { opCreate, opInvoke, opDestroy };
+
+    struct HostHeader final {
+        // Written before the host starts, it lays the region out from them.
+        uint32_t slots;
+        uint32_t slotSize;
+        Word state;
+        // Bumped for every request, the idle host sleeps on it.
+        Word requests;
+        Word sleeping;
+        // Bumped for every freed slot, callers without one sleep on it.
+        Word freed;
+        Word slotWaiters;
+        Word stop;
+        uint32_t infoSize;
+    };
+
+    struct alignas(64) SlotHeader final {
+        Word state;
+        uint32_t op;
+        uint64_t object;
+        uint32_t inSize;
+        uint32_t outSize;
+    };
+
+    static size_t roundUp(size_t size, size_t align) {
+        return (size + align - 1) & ~(align - 1);
+    }
+
+    // The host finds the region at this descriptor.
+    constexpr int hostFd = 3;
+
+    // Shared memory without a name that only the host inherits.
+    static int createSharedFile(size_t size) {
+#ifdef __linux__
+        int fd = memfd_create("BusIsolated", MFD_CLOEXEC);
+#else
+        static std::atomic_uint32_t counter{ 0 };
+        auto name = "/BusIsolated." + std::to_string(getpid()) + '.' +
+            std::to_string(counter++);
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if(fd >= 0) {
+            shm_unlink(name.c_str());
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+#endif
+        // dup2 onto itself would keep FD_CLOEXEC in the host.
+        if(fd >= 0 && fd <= hostFd) {
+            int res = fcntl(fd, F_DUPFD_CLOEXEC, hostFd + 1);
+            close(fd);
+            fd = res;
+        }
+        if(fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        if(fd < 0)
+            throw std::runtime_error(
+                std::string("Failed to create host memory\nReason:") +
+                std::strerror(errno));
+        return fd;
+    }
+
+    // One shared mapping per host process: the header, the free and
+    // request queues, an area for the module description, then the slots
+    // that carry the calls. The parent creates it, the host maps it from
+    // hostFd.
+    class HostRegion final : private Unmoveable {
+    private:
+        int mFd = -1;
+        char* mBase = nullptr;
+        size_t mSize;
+        uint32_t mSlots;
+        uint32_t mSlotSize;
+        size_t mFree, mRequests, mInfo, mSlotBase, mSlotStride;
+
+        void layout() {
+            mFree = roundUp(sizeof(HostHeader), 64);
+            mRequests = mFree + roundUp(SlotQueue::bytes(mSlots), 64);
+            mInfo = mRequests + roundUp(SlotQueue::bytes(mSlots), 64);
+            mSlotBase = mInfo + mSlotSize;
+            mSlotStride = sizeof(SlotHeader) + mSlotSize;
+            mSize = mSlotBase + mSlotStride * mSlots;
+        }
+        void map(size_t size) {
+            void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, mFd, 0);
+            if(base == MAP_FAILED)
+                throw std::runtime_error(
+                    std::string("Failed to map host memory\nReason:") +
+                    std::strerror(errno));
+            mBase = static_cast<char*>(base);
+        }
+
+    public:
+        HostRegion(uint32_t slots, uint32_t slotSize)
+            : mSlots(2),
+              mSlotSize(static_cast<uint32_t>(roundUp(slotSize, 64))) {
+            while(mSlots < slots)
+                mSlots <<= 1;
+            layout();
+            mFd = createSharedFile(mSize);
+            map(mSize);
+            new(mBase) HostHeader{};
+            header().slots = mSlots;
+            header().slotSize = mSlotSize;
+            new(mBase + mFree) SlotQueue;
+            new(mBase + mRequests) SlotQueue;
+            freeSlots().init(mSlots);
+            requests().init(mSlots);
+            for(uint32_t i = 0; i < mSlots; ++i) {
+                new(&slot(i)) SlotHeader{};
+                freeSlots().push(mSlots - 1, i);
+            }
+        }
+        explicit HostRegion(int fd) : mFd(fd) {
+            struct stat info;
+            if(fstat(fd, &info) != 0 ||
+               static_cast<size_t>(info.st_size) < sizeof(HostHeader))
+                throw std::runtime_error("Bad host memory");
+            map(static_cast<size_t>(info.st_size));
+            mSize = static_cast<size_t>(info.st_size);
+            mSlots = header().slots;
+            mSlotSize = header().slotSize;
+            size_t size = mSize;
+            layout();
+            std::swap(size, mSize);
+            if(mSlots == 0 || (mSlots & (mSlots - 1)) || size > mSize)
+                throw std::runtime_error("Bad host memory layout");
+        }
+        ~HostRegion() {
+            if(mBase)
+                munmap(mBase, mSize);
+            if(mFd >= 0)
+                close(mFd);
+        }
+        int fd() const {
+            return mFd;
+        }
+        uint32_t slots() const {
+            return mSlots;
+        }
+        uint32_t mask() const {
+            return mSlots - 1;
+        }
+        uint32_t slotSize() const {
+            return mSlotSize;
+        }
+        HostHeader& header() {
+            return *reinterpret_cast<HostHeader*>(mBase);
+        }
+        SlotQueue& freeSlots() {
+            return *reinterpret_cast<SlotQueue*>(mBase + mFree);
+        }
+        SlotQueue& requests() {
+            return *reinterpret_cast<SlotQueue*>(mBase + mRequests);
+        }
+        char* info() {
+            return mBase + mInfo;
+        }
+        // Never beyond the info area, whatever the host wrote.
+        size_t infoSize() {
+            return (std::min)(size_t(header().infoSize), size_t(mSlotSize));
+        }
+        SlotHeader& slot(uint32_t index) {
+            return *reinterpret_cast<SlotHeader*>(mBase + mSlotBase +
+                                                  mSlotStride * index);
+        }
+        char* data(uint32_t index) {
+            return reinterpret_cast<char*>(&slot(index) + 1);
+        }
+    };
+
+    static std::string describe(std::exception_ptr ptr) {
+        try {
+            std::rethrow_exception(ptr);
+        } catch(const SourceLocation& loc) {
+            try {
+                std::rethrow_if_nested(loc);
+            } catch(...) {
+                return describe(std::current_exception());
+            }
+            return std::string("Exception at ") + loc.functionName;
+        } catch(const std::exception& ex) {
+            return ex.what();
+        } catch(...) {
+            return "Unknown exception";
+        }
+    }
+
+    // The module description is a list of length-prefixed strings: name,
+    // GUID, bus version, version, description, copyright and then the
+    // names of the isolated functions.
+    static bool writeStrings(char* out, size_t capacity,
+                             const std::vector<std::string>& strings,
+                             uint32_t& size) {
+        size_t pos = 0;
+        for(auto&& str : strings) {
+            auto len = static_cast<uint32_t>(str.size());
+            if(pos + sizeof(len) + len > capacity)
+                return false;
+            std::memcpy(out + pos, &len, sizeof(len));
+            std::memcpy(out + pos + sizeof(len), str.data(), len);
+            pos += sizeof(len) + len;
+        }
+        size = static_cast<uint32_t>(pos);
+        return true;
+    }
+    static std::vector<std::string> readStrings(const char* in, size_t size) {
+        std::vector<std::string> res;
+        size_t pos = 0;
+        while(pos + sizeof(uint32_t) <= size) {
+            uint32_t len;
+            std::memcpy(&len, in + pos, sizeof(len));
+            pos += sizeof(len);
+            if(pos + len > size)
+                break;
+            res.emplace_back(in + pos, len);
+            pos += len;
+        }
+        return res;
+    }
+
+    static void finishSlot(SlotHeader& slot, uint32_t state) {
+        slot.state.store(state, std::memory_order_release);
+        wakeWord(slot.state);
+    }
+
+    static void releaseSlot(HostRegion& region, uint32_t index) {
+        region.freeSlots().push(region.mask(), index);
+        HostHeader& header = region.header();
+        header.freed.fetch_add(1);
+        if(header.slotWaiters.load())
+            wakeWord(header.freed);
+    }
+
+    [[noreturn]] static void runHost(HostRegion& region, const fs::path& path,
+                                     pid_t parent) {
+        HostHeader& header = region.header();
+        auto fail = [&](const std::string& message) {
+            uint32_t size = static_cast<uint32_t>(
+                (std::min)(message.size(), size_t(region.slotSize())));
+            std::memcpy(region.info(), message.data(), size);
+            header.infoSize = size;
+            header.state.store(hostFailed, std::memory_order_release);
+            wakeWord(header.state);
+            _exit(1);
+        };
+        std::string error;
+        auto reporter = std::make_shared<Reporter>();
+        reporter->addAction(ReportLevel::Error,
+                            [&](ReportLevel, const std::string& message,
+                                const SourceLocation&) { error = message; });
+        ModuleSystem system(
+            reporter, [&] { error = describe(std::current_exception()); });
+        system.setLoadPolicy(LoadPolicy::Now);
+        try {
+            if(!system.loadModuleFile(path))
+                fail("Failed to register module " + path.string() + '\n' +
+                     error);
+        } catch(...) {
+            fail(describe(std::current_exception()));
+        }
+        ModuleInfo info = system.listModules().front();
+        std::vector<std::string> strings{ std::string(info.name),
+                                          GUID2Str(info.guid),
+                                          std::string(info.busVersion),
+                                          std::string(info.version),
+                                          std::string(info.description),
+                                          std::string(info.copyright) };
+        for(auto&& func : system.list<IsolatedFunction>())
+            strings.emplace_back(func.name);
+        if(!writeStrings(region.info(), region.slotSize(), strings,
+                         header.infoSize))
+            fail("The description of module " + path.string() +
+                 " doesn't fit in a slot");
+        header.state.store(hostReady, std::memory_order_release);
+        wakeWord(header.state);
+
+        std::unordered_map<uint64_t, std::shared_ptr<IsolatedFunction>> objects;
+        uint64_t nextObject = 1;
+        while(true) {
+            uint32_t index;
+            if(!region.requests().pop(region.mask(), index)) {
+                // Pairs with the caller: either it sees the flag and wakes
+                // us, or the counter differs from seen and the wait returns.
+                header.sleeping.store(1);
+                uint32_t seen = header.requests.load();
+                if(!region.requests().pop(region.mask(), index)) {
+                    if(header.stop.load() || getppid() != parent)
+                        _exit(0);
+                    waitWord(header.requests, seen, std::chrono::seconds(1));
+                    header.sleeping.store(0);
+                    continue;
+                }
+                header.sleeping.store(0);
+            }
+            SlotHeader& slot = region.slot(index);
+            char* data = region.data(index);
+            uint32_t state = slotDone;
+            try {
+                if(slot.op == opCreate) {
+                    Name name(data, slot.inSize);
+                    auto object = system.instantiate<IsolatedFunction>(
+                        FunctionId(info.guid, name));
+                    if(!object)
+                        throw std::runtime_error(
+                            "Failed to instantiate " + std::string(name) +
+                            '\n' + error);
+                    slot.object = nextObject++;
+                    slot.outSize = 0;
+                    objects.emplace(slot.object, std::move(object));
+                } else if(slot.op == opInvoke) {
+                    auto iter = objects.find(slot.object);
+                    if(iter == objects.cend())
+                        throw std::runtime_error("Unknown isolated object");
+                    size_t offset = roundUp(slot.inSize, 16);
+                    size_t capacity = region.slotSize() - offset;
+                    size_t size = iter->second->invoke(data, slot.inSize,
+                                                       data + offset, capacity);
+                    if(size > capacity)
+                        throw std::runtime_error(
+                            "The result doesn't fit in the slot");
+                    slot.outSize = static_cast<uint32_t>(size);
+                } else {
+                    // Nobody waits for a destroy, so the slot is freed here.
+                    objects.erase(slot.object);
+                    releaseSlot(region, index);
+                    continue;
+                }
+            } catch(...) {
+                std::string message = describe(std::current_exception());
+                slot.outSize = static_cast<uint32_t>(
+                    (std::min)(message.size(), size_t(region.slotSize())));
+                std::memcpy(data, message.data(), slot.outSize);
+                state = slotFailed;
+            }
+            finishSlot(slot, state);
+        }
+    }
+
+    // Arguments: the module and the pid of the parent.
+    int runIsolatedHost(int argc, char** argv) {
+        if(argc != 3) {
+            std::cerr << "Usage: " << (argc ? argv[0] : "BusIsolatedHost")
+                      << " <module> <parent pid>" << std::endl;
+            return 2;
+        }
+        auto parent = static_cast<pid_t>(std::strtol(argv[2], nullptr, 10));
+#ifdef __linux__
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+        // The parent may have exited before the death signal was set.
+        if(getppid() != parent)
+            return 1;
+        std::unique_ptr<HostRegion> region;
+        try {
+            region = std::make_unique<HostRegion>(hostFd);
+        } catch(const std::exception& ex) {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+        runHost(*region, argv[1], parent);
+    }
+
+    struct HostCrashed final : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    class HostProcess final : private Unmoveable {
+    private:
+        std::mutex mMutex;
+        bool mExited = false;
+        // False if the exit status went elsewhere.
+        bool mReaped = false;
+        int mStatus = 0;
+        int mPidfd = -1;
+
+        // Without a status: SIGCHLD is ignored, or someone else reaped the
+        // host. Its pidfd still tells whether it is gone.
+        bool exitedUnreaped() {
+            if(mPidfd >= 0) {
+                pollfd fd{ mPidfd, POLLIN, 0 };
+                return poll(&fd, 1, 0) > 0;
+            }
+            return kill(pid, 0) != 0 && errno == ESRCH;
+        }
+
+    public:
+        HostRegion region;
+        pid_t pid = -1;
+        std::chrono::milliseconds pollInterval;
+        // Set once a newer host replaces this one.
+        std::atomic_bool retired{ false };
+
+        explicit HostProcess(const IsolationConfig& config)
+            : region(config.slots, config.slotSize),
+              pollInterval(config.pollInterval) {}
+        ~HostProcess() {
+            if(pid > 0 && alive()) {
+                region.header().stop.store(1);
+                region.header().requests.fetch_add(1);
+                wakeWord(region.header().requests);
+                for(int i = 0; i < 50 && alive(); ++i)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                if(alive()) {
+                    kill(pid, SIGKILL);
+                    waitpid(pid, nullptr, 0);
+                }
+            }
+            if(mPidfd >= 0)
+                close(mPidfd);
+        }
+        void started(pid_t id) {
+            pid = id;
+#if defined(__linux__) && defined(SYS_pidfd_open)
+            mPidfd = static_cast<int>(syscall(SYS_pidfd_open, id, 0));
+#endif
+        }
+        bool alive() {
+            std::lock_guard guard(mMutex);
+            if(mExited)
+                return false;
+            int res = waitpid(pid, &mStatus, WNOHANG);
+            if(res == pid)
+                mExited = mReaped = true;
+            else if(res < 0 && errno == ECHILD)
+                mExited = exitedUnreaped();
+            return !mExited;
+        }
+        std::string exitReason() {
+            std::lock_guard guard(mMutex);
+            if(!mReaped)
+                return "exited";
+            if(WIFSIGNALED(mStatus))
+                return "was killed by signal " +
+                    std::to_string(WTERMSIG(mStatus));
+            return "exited with code " + std::to_string(WEXITSTATUS(mStatus));
+        }
+    };
+
+    static fs::path defaultHost() {
+        Dl_info info;
+        if(dladdr(reinterpret_cast<void*>(&runIsolatedHost), &info) &&
+           info.dli_fname)
+            return fs::absolute(info.dli_fname).parent_path() /
+                "BusIsolatedHost";
+        return "BusIsolatedHost";
+    }
+
+    // The host is a fresh executable rather than a fork, so it doesn't
+    // inherit locks other threads of this process held.
+    static std::shared_ptr<HostProcess>
+    spawnHost(const fs::path& path, const IsolationConfig& config) {
+        auto host = std::make_shared<HostProcess>(config);
+        HostHeader& header = host->region.header();
+        std::string executable =
+            (config.host.empty() ? defaultHost() : config.host).string();
+        std::string module = path.string();
+        std::string parent = std::to_string(getpid());
+        char* argv[] = { executable.data(), module.data(), parent.data(),
+                         nullptr };
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, host->region.fd(), hostFd);
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t mask;
+        sigemptyset(&mask);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+        pid_t pid = -1;
+        int res = posix_spawn(&pid, executable.c_str(), &actions, &attr, argv,
+                              environ);
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&actions);
+        if(res != 0)
+            throw std::runtime_error("Failed to start host " + executable +
+                                     " for module " + module +
+                                     "\nReason:" + std::strerror(res));
+        host->started(pid);
+        uint32_t state;
+        while((state = header.state.load(std::memory_order_acquire)) ==
+              hostStarting) {
+            waitWord(header.state, hostStarting, config.pollInterval);
+            if(header.state.load() == hostStarting && !host->alive())
+                throw std::runtime_error("Host for module " + module + ' ' +
+                                         host->exitReason() + " during init");
+        }
+        if(state == hostFailed)
+            throw std::runtime_error(
+                std::string(host->region.info(), host->region.infoSize()));
+        return host;
+    }
+
+    class IsolatedModule;
+
+    class IsolatedInstance final : public ModuleInstance {
+    private:
+        IsolatedModule& mModule;
+
+    public:
+        IsolatedInstance(const fs::path& path, ModuleSystem& system,
+                         IsolatedModule& module)
+            : ModuleInstance(path, system), mModule(module) {}
+        ModuleInfo info() const override;
+        std::vector<Name> list(Name interfaceName) const override;
+        std::vector<Name> interfaces() const override {
+            return { IsolatedFunction::getInterface() };
+        }
+        std::shared_ptr<ModuleFunctionBase> instantiate(Name name) override;
+    };
+
+    // Runs the module in a host process. The parent only keeps the
+    // description the host sent back and forwards calls through shared
+    // memory. A crashed host is reported and started again.
+    class IsolatedModule final : public ModuleLibrary {
+    private:
+        fs::path mPath;
+        IsolationConfig mConfig;
+        Reporter& mReporter;
+        std::mutex mMutex;
+        std::shared_ptr<HostProcess> mHost;
+        unsigned mRespawns = 0;
+        std::unique_ptr<ModuleManifest> mManifest;
+        std::shared_ptr<IsolatedInstance> mInstance;
+        LoadStats mStats;
+
+    public:
+        IsolatedModule(const fs::path& path, ModuleSystem& system,
+                       const IsolationConfig& config)
+            : mPath(fs::absolute(path)), mConfig(config),
+              mReporter(system.getReporter()) {
+            BUS_TRACE_BEGIN("BusIsolated") {
+                auto beg = std::chrono::steady_clock::now();
+                mHost = spawnHost(mPath, mConfig);
+                mStats.initNs = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - beg)
+                        .count());
+                auto strings = readStrings(mHost->region.info(),
+                                           mHost->region.infoSize());
+                if(strings.size() < 6)
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Bad description of module " + mPath.string()));
+                ModuleInfo info;
+                info.name = strings[0];
+                info.guid = str2GUID(strings[1]);
+                info.busVersion = strings[2];
+                info.version = strings[3];
+                info.description = strings[4];
+                info.copyright = strings[5];
+                std::map<Name, std::vector<Name>> functions;
+                if(strings.size() > 6)
+                    functions[IsolatedFunction::getInterface()].assign(
+                        strings.cbegin() + 6, strings.cend());
+                mManifest = std::make_unique<ModuleManifest>(info, functions);
+                mInstance =
+                    std::make_shared<IsolatedInstance>(mPath, system, *this);
+                BUS_REPORT(mReporter, Info, BUS_SRCLOC("BusIsolated"),
+                           "Started isolated module ", mPath,
+                           " [pid=", static_cast<int64_t>(mHost->pid),
+                           ",init=", mStats.initNs / 1000, "us]");
+            }
+            BUS_TRACE_END();
+        }
+        ~IsolatedModule() {
+            mInstance.reset();
+        }
+        std::shared_ptr<ModuleInstance> getInstance() override {
+            return mInstance;
+        }
+        LoadStats loadStats() const override {
+            return mStats;
+        }
+        ModuleInfo info() override {
+            ModuleInfo res = mManifest->info();
+            res.modulePath = mPath;
+            return res;
+        }
+        std::vector<Name> list(Name interfaceName) override {
+            return mManifest->list(interfaceName);
+        }
+        std::shared_ptr<HostProcess> host() {
+            std::lock_guard guard(mMutex);
+            return mHost;
+        }
+        void recover(const std::shared_ptr<HostProcess>& crashed) {
+            std::lock_guard guard(mMutex);
+            if(mHost != crashed)
+                return;
+            crashed->retired = true;
+            mHost.reset();
+            BUS_REPORT(mReporter, Error, BUS_SRCLOC("BusIsolated"),
+                       "Host of isolated module ", mPath, " [pid=",
+                       static_cast<int64_t>(crashed->pid), "] ",
+                       crashed->exitReason(), '.');
+            if(mRespawns >= mConfig.maxRespawns) {
+                BUS_REPORT(mReporter, Error, BUS_SRCLOC("BusIsolated"),
+                           "Isolated module ", mPath, " crashed ", mRespawns,
+                           " times and won't be restarted.");
+                return;
+            }
+            ++mRespawns;
+            try {
+                mHost = spawnHost(mPath, mConfig);
+                BUS_REPORT(mReporter, Info, BUS_SRCLOC("BusIsolated"),
+                           "Restarted isolated module ", mPath,
+                           " [pid=", static_cast<int64_t>(mHost->pid), "]");
+            } catch(const std::exception& ex) {
+                BUS_REPORT(mReporter, Error, BUS_SRCLOC("BusIsolated"),
+                           "Failed to restart isolated module ", mPath,
+                           '\n', ex.what());
+            }
+        }
+        size_t call(HostProcess& host, uint32_t op, uint64_t& object,
+                    const void* in, size_t inSize, void* out,
+                    size_t outCapacity) {
+            HostRegion& region = host.region;
+            size_t offset = roundUp(inSize, 16);
+            if(offset > region.slotSize())
+                throw std::runtime_error(
+                    "The arguments don't fit in the slot");
+            HostHeader& header = region.header();
+            uint32_t index;
+            // All slots busy: sleep until a call finishes. Pairs with
+            // releaseSlot: either it sees the waiter and wakes us, or the
+            // counter differs from seen and the wait returns.
+            while(!region.freeSlots().pop(region.mask(), index)) {
+                if(!host.alive())
+                    throw HostCrashed("The isolated host crashed");
+                header.slotWaiters.fetch_add(1);
+                uint32_t seen = header.freed.load();
+                bool popped = region.freeSlots().pop(region.mask(), index);
+                if(!popped)
+                    waitWord(header.freed, seen, host.pollInterval);
+                header.slotWaiters.fetch_sub(1);
+                if(popped)
+                    break;
+            }
+            // The host writes the queues and the sizes, so none of them is
+            // trusted beyond the slot.
+            if(index >= region.slots())
+                throw std::runtime_error(
+                    "The isolated host corrupted its free slots");
+            SlotHeader& slot = region.slot(index);
+            char* data = region.data(index);
+            slot.op = op;
+            slot.object = object;
+            slot.inSize = static_cast<uint32_t>(inSize);
+            if(inSize)
+                std::memcpy(data, in, inSize);
+            slot.state.store(slotPending, std::memory_order_relaxed);
+            region.requests().push(region.mask(), index);
+            header.requests.fetch_add(1);
+            if(header.sleeping.load())
+                wakeWord(header.requests);
+            if(op == opDestroy)
+                return 0;
+            uint32_t state;
+            while((state = slot.state.load(std::memory_order_acquire)) ==
+                  slotPending) {
+                waitWord(slot.state, slotPending, host.pollInterval);
+                if(slot.state.load() == slotPending && !host.alive())
+                    throw HostCrashed("The isolated host crashed");
+            }
+            size_t size = slot.outSize;
+            if(state == slotFailed) {
+                std::string message(
+                    data, (std::min)(size, size_t(region.slotSize())));
+                releaseSlot(region, index);
+                throw std::runtime_error(message);
+            }
+            if(size > region.slotSize() - offset) {
+                releaseSlot(region, index);
+                throw std::runtime_error(
+                    "The isolated host returned more than its slot holds");
+            }
+            if(size > outCapacity) {
+                releaseSlot(region, index);
+                throw std::runtime_error(
+                    "The result doesn't fit in the output buffer");
+            }
+            if(size)
+                std::memcpy(out, data + offset, size);
+            object = slot.object;
+            releaseSlot(region, index);
+            return size;
+        }
+    };
+
+    // Stands for an object living in the host. After a restart the object
+    // is created again on the new host when it is next called.
+    class IsolatedProxy final : public IsolatedFunction {
+    private:
+        IsolatedModule& mModule;
+        std::string mName;
+        std::mutex mMutex;
+        std::shared_ptr<HostProcess> mHost;
+        uint64_t mObject = 0;
+
+        // The host and the object on it, read together so that a rebind on
+        // another thread can't pair the new host with the old object.
+        std::pair<std::shared_ptr<HostProcess>, uint64_t> bind() {
+            std::lock_guard guard(mMutex);
+            if(mHost && !mHost->retired.load(std::memory_order_relaxed))
+                return { mHost, mObject };
+            auto host = mModule.host();
+            if(!host)
+                throw std::runtime_error("The isolated module isn't running");
+            uint64_t object = 0;
+            try {
+                mModule.call(*host, opCreate, object, mName.data(),
+                             mName.size(), nullptr, 0);
+            } catch(const HostCrashed&) {
+                mModule.recover(host);
+                throw;
+            }
+            mHost = host;
+            mObject = object;
+            return { std::move(host), object };
+        }
+
+    public:
+        IsolatedProxy(ModuleInstance& instance, IsolatedModule& module,
+                      Name name)
+            : IsolatedFunction(instance), mModule(module), mName(name) {
+            bind();
+        }
+        ~IsolatedProxy() override {
+            if(mHost && !mHost->retired && mHost->alive()) {
+                try {
+                    mModule.call(*mHost, opDestroy, mObject, nullptr, 0,
+                                 nullptr, 0);
+                } catch(...) {
+                }
+            }
+        }
+        size_t invoke(const void* in, size_t inSize, void* out,
+                      size_t outCapacity) override {
+            auto [host, object] = bind();
+            try {
+                return mModule.call(*host, opInvoke, object, in, inSize, out,
+                                    outCapacity);
+            } catch(const HostCrashed&) {
+                mModule.recover(host);
+                throw;
+            }
+        }
+    };
+
+    ModuleInfo IsolatedInstance::info() const {
+        return mModule.info();
+    }
+    std::vector<Name> IsolatedInstance::list(Name interfaceName) const {
+        return mModule.list(interfaceName);
+    }
+    std::shared_ptr<ModuleFunctionBase>
+    IsolatedInstance::instantiate(Name name) {
+        auto names = list(IsolatedFunction::getInterface());
+        if(std::find(names.cbegin(), names.cend(), name) == names.cend())
+            return nullptr;
+        try {
+            return std::make_shared<IsolatedProxy>(*this, mModule, name);
+        } catch(const std::exception& ex) {
+            BUS_REPORT(getSystem().getReporter(), Error,
+                       BUS_SRCLOC("BusIsolated"), "Failed to instantiate ",
+                       name, " in isolated module ", mModulePath, '\n',
+                       ex.what());
+            return nullptr;
+        }
+    }
+
+    bool ModuleSystem::loadModuleIsolated(const fs::path& path,
+                                          const IsolationConfig& config) {
+        return load(std::make_shared<IsolatedModule>(path, *this, config));
+    }
+#endif
+    bool ModuleSystem::loadModuleIsolated(const fs::path& path) {
+        return loadModuleIsolated(path, IsolationConfig{});
+    }
+}  // namespace Bus
@@ -0,0 +1,39 @@
+#pragma once
+#include "BusModule.hpp"
+#include <chrono>
+
+namespace Bus {
+    // Interface of functions that can run in an isolated host process. The
+    // arguments and the result are plain bytes, so a call only copies them
+    // into and out of shared memory. Failures are reported by throwing.
+    class IsolatedFunction : public ModuleFunctionBase {
+    protected:
+        explicit IsolatedFunction(ModuleInstance& instance)
+            : ModuleFunctionBase(instance) {}
+
+    public:
+        static Name getInterface() {
+            return "Bus.IsolatedFunction";
+        }
+        // Returns the size of the result written to out.
+        virtual size_t invoke(const void* in, size_t inSize, void* out,
+                              size_t outCapacity) = 0;
+    };
+
+    struct IsolationConfig final {
+        // Calls in flight at once, each one owns a slot until it returns.
+        uint32_t slots = 16;
+        // Bytes for the arguments plus the result of one call.
+        uint32_t slotSize = 1 << 16;
+        // How often a waiting caller checks that the host is alive.
+        std::chrono::milliseconds pollInterval{ 20 };
+        // Crashes after which the host isn't started again.
+        unsigned maxRespawns = 8;
+        // The host executable. If empty, BusIsolatedHost next to the Bus
+        // library.
+        fs::path host;
+    };
+
+    // Entry point of the host executable, see tools/BusIsolatedHost.cpp.
+    int runIsolatedHost(int argc, char** argv);
+}  // namespace Bus
@@ -0,0 +1,188 @@
+#include "BusManifest.hpp"
+#include "BusReporter.hpp"
+#include <fstream>
+
+namespace Bus {
+    Name ModuleManifest::store(Name str) {
+        return mStrings.emplace_back(str);
+    }
+
+    ModuleManifest::ModuleManifest(
+        const ModuleInfo& info,
+        const std::map<Name, std::vector<Name>>& functions) {
+        mInfo.name = store(info.name);
+        mInfo.guid = info.guid;
+        mInfo.busVersion = store(info.busVersion);
+        mInfo.version = store(info.version);
+        mInfo.description = store(info.description);
+        mInfo.copyright = store(info.copyright);
+        for(auto path : info.thirdPartySearchPath)
+            mInfo.thirdPartySearchPath.emplace_back(store(path));
+        mInfo.dependencies = info.dependencies;
+        mInfo.modulePath = info.modulePath;
+        for(auto&& inter : functions) {
+            auto& funcs = mFunctions[store(inter.first)];
+            for(auto func : inter.second)
+                funcs.emplace_back(store(func));
+        }
+    }
+
+    ModuleManifest::ModuleManifest(const ModuleManifest& rhs)
+        : ModuleManifest(rhs.mInfo, { rhs.mFunctions.cbegin(),
+                                      rhs.mFunctions.cend() }) {
+        mLibrary = rhs.mLibrary;
+    }
+
+    FileStamp FileStamp::of(const fs::path& path, std::error_code& ec) {
+        FileStamp res;
+        res.size = fs::file_size(path, ec);
+        if(ec)
+            return res;
+        res.writeTime = static_cast<int64_t>(
+            fs::last_write_time(path, ec).time_since_epoch().count());
+        return res;
+    }
+
+    std::vector<Name> ModuleManifest::interfaces() const {
+        std::vector<Name> res;
+        for(auto&& inter : mFunctions)
+            res.emplace_back(inter.first);
+        return res;
+    }
+
+    std::vector<Name> ModuleManifest::list(Name interfaceName) const {
+        auto iter = mFunctions.find(interfaceName);
+        if(iter == mFunctions.cend())
+            return {};
+        return iter->second;
+    }
+
+    bool ModuleManifest::describes(const fs::path& modulePath) const {
+        std::error_code ec;
+        auto library = FileStamp::of(modulePath, ec);
+        if(ec)
+            return false;
+        if(mLibrary != FileStamp{})
+            return mLibrary == library;
+        auto manifest = FileStamp::of(pathOf(modulePath), ec);
+        return !ec && manifest.writeTime >= library.writeTime;
+    }
+
+    fs::path ModuleManifest::pathOf(const fs::path& modulePath) {
+        fs::path res = modulePath;
+        res += ".manifest";
+        return res;
+    }
+
+    static std::string escape(Name str) {
+        std::string res;
+        for(char c : str) {
+            if(c == '\\')
+                res += "\\\\";
+            else if(c == '\n')
+                res += "\\n";
+            else
+                res += c;
+        }
+        return res;
+    }
+
+    static std::string unescape(Name str) {
+        std::string res;
+        for(size_t i = 0; i < str.size(); ++i) {
+            if(str[i] == '\\' && i + 1 < str.size())
+                res += str[++i] == 'n' ? '\n' : str[i];
+            else
+                res += str[i];
+        }
+        return res;
+    }
+
+    void ModuleManifest::write(const fs::path& path) const {
+        BUS_TRACE_BEGIN("BusManifest") {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if(!out)
+                BUS_TRACE_THROW(std::runtime_error("Failed to write manifest " +
+                                                   path.string()));
+            out << "name=" << escape(mInfo.name) << '\n';
+            out << "guid=" << GUID2Str(mInfo.guid) << '\n';
+            out << "busVersion=" << escape(mInfo.busVersion) << '\n';
+            out << "version=" << escape(mInfo.version) << '\n';
+            out << "description=" << escape(mInfo.description) << '\n';
+            out << "copyright=" << escape(mInfo.copyright) << '\n';
+            for(auto p : mInfo.thirdPartySearchPath)
+                out << "thirdPartySearchPath=" << escape(p) << '\n';
+            for(auto dep : mInfo.dependencies)
+                out << "dependency=" << GUID2Str(dep) << '\n';
+            if(mLibrary != FileStamp{})
+                out << "librarySize=" << mLibrary.size
+                    << "\nlibraryTime=" << mLibrary.writeTime << '\n';
+            for(auto&& inter : mFunctions) {
+                out << "interface=" << escape(inter.first) << '\n';
+                for(auto func : inter.second)
+                    out << "function=" << escape(func) << '\n';
+            }
+            if(!out)
+                BUS_TRACE_THROW(std::runtime_error("Failed to write manifest " +
+                                                   path.string()));
+        }
+        BUS_TRACE_END();
+    }
+
+    ModuleManifest ModuleManifest::read(const fs::path& path) {
+        BUS_TRACE_BEGIN("BusManifest") {
+            std::ifstream in(path, std::ios::binary);
+            if(!in)
+                BUS_TRACE_THROW(std::runtime_error("Failed to read manifest " +
+                                                   path.string()));
+            ModuleManifest res;
+            std::vector<Name>* funcs = nullptr;
+            std::string line;
+            unsigned lineNo = 0;
+            while(std::getline(in, line)) {
+                ++lineNo;
+                if(!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if(line.empty() || line.front() == '#')
+                    continue;
+                auto pos = line.find('=');
+                if(pos == line.npos)
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Bad manifest " + path.string() + " at line " +
+                        std::to_string(lineNo)));
+                Name key(line.data(), pos);
+                Name val = res.store(unescape(Name(line).substr(pos + 1)));
+                if(key == "name")
+                    res.mInfo.name = val;
+                else if(key == "guid")
+                    res.mInfo.guid = str2GUID(val);
+                else if(key == "busVersion")
+                    res.mInfo.busVersion = val;
+                else if(key == "version")
+                    res.mInfo.version = val;
+                else if(key == "description")
+                    res.mInfo.description = val;
+                else if(key == "copyright")
+                    res.mInfo.copyright = val;
+                else if(key == "thirdPartySearchPath")
+                    res.mInfo.thirdPartySearchPath.emplace_back(val);
+                else if(key == "dependency")
+                    res.mInfo.dependencies.emplace_back(str2GUID(val));
+                else if(key == "librarySize")
+                    res.mLibrary.size = std::stoull(std::string(val));
+                else if(key == "libraryTime")
+                    res.mLibrary.writeTime = std::stoll(std::string(val));
+                else if(key == "interface")
+                    funcs = &res.mFunctions[val];
+                else if(key == "function" && funcs)
+                    funcs->emplace_back(val);
+                else
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Bad manifest " + path.string() + " at line " +
+                        std::to_string(lineNo)));
+            }
+            return res;
+        }
+        BUS_TRACE_END();
+    }
+}  // namespace Bus
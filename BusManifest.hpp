@@ -0,0 +1,69 @@
+#pragma once
+#include "BusCommon.hpp"
+#include <deque>
+#include <map>
+
+namespace Bus {
+    // Everything the registry needs to know about a module that has not been
+    // loaded yet.
+    class ModuleDescriptor {
+    public:
+        virtual ~ModuleDescriptor() = default;
+        virtual ModuleInfo info() const = 0;
+        virtual std::vector<Name> list(Name interfaceName) const = 0;
+        // Owner of the strings info and list point into, if they stay valid
+        // as long as it lives. Null if they may not outlive the call.
+        virtual std::shared_ptr<const void> nameStorage() const {
+            return nullptr;
+        }
+    };
+
+    // Size and write time of a file, to tell whether it changed since a
+    // description of it was made.
+    struct FileStamp final {
+        uint64_t size = 0;
+        int64_t writeTime = 0;
+        static FileStamp of(const fs::path& path, std::error_code& ec);
+        bool operator==(const FileStamp& rhs) const {
+            return size == rhs.size && writeTime == rhs.writeTime;
+        }
+        bool operator!=(const FileStamp& rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    // Text description of a module: its ModuleInfo plus the result of
+    // ModuleInstance::list for every interface it implements. Lets the
+    // system register a module without loading the library.
+    class ModuleManifest final : public ModuleDescriptor {
+    private:
+        std::deque<std::string> mStrings;
+        ModuleInfo mInfo;
+        std::map<Name, std::vector<Name>, std::less<>> mFunctions;
+        FileStamp mLibrary;
+        Name store(Name str);
+
+    public:
+        ModuleManifest() = default;
+        ModuleManifest(const ModuleInfo& info,
+                       const std::map<Name, std::vector<Name>>& functions);
+        ModuleManifest(const ModuleManifest& rhs);
+        ModuleManifest(ModuleManifest&&) = default;
+        ModuleManifest& operator=(const ModuleManifest&) = delete;
+        ModuleInfo info() const override {
+            return mInfo;
+        }
+        std::vector<Name> interfaces() const;
+        std::vector<Name> list(Name interfaceName) const override;
+        // Stamp of the library the manifest was generated from. Manifests
+        // written by hand have none and must not be older than the library.
+        void setLibrary(const FileStamp& stamp) {
+            mLibrary = stamp;
+        }
+        bool describes(const fs::path& modulePath) const;
+
+        static ModuleManifest read(const fs::path& path);
+        void write(const fs::path& path) const;
+        static fs::path pathOf(const fs::path& modulePath);
+    };
+}  // namespace Bus
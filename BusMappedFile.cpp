@@ -0,0 +1,160 @@
+#include "BusMappedFile.hpp"
+#include "BusReporter.hpp"
+#include <stdexcept>
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace Bus {
+#ifdef _WIN32
+    MappedFile::MappedFile(const fs::path& path)
+        : mData(nullptr), mSize(0), mFile(INVALID_HANDLE_VALUE),
+          mMapping(NULL) {
+        BUS_TRACE_BEGIN("BusMappedFile") {
+            mFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                                NULL);
+            if(mFile == INVALID_HANDLE_VALUE)
+                BUS_TRACE_THROW(std::runtime_error("Failed to open file " +
+                                                   path.string()));
+            LARGE_INTEGER size;
+            GetFileSizeEx(mFile, &size);
+            mSize = static_cast<size_t>(size.QuadPart);
+            if(mSize == 0)
+                return;
+            mMapping =
+                CreateFileMappingW(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mMapping != NULL)
+                mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+            if(mData == nullptr) {
+                release();
+                BUS_TRACE_THROW(std::runtime_error("Failed to map file " +
+                                                   path.string()));
+            }
+        }
+        BUS_TRACE_END();
+    }
+    MappedFile::MappedFile(const fs::path& path, size_t size)
+        : mData(nullptr), mSize(size), mFile(INVALID_HANDLE_VALUE),
+          mMapping(NULL) {
+        BUS_TRACE_BEGIN("BusMappedFile") {
+            mFile = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                                FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+            if(mFile == INVALID_HANDLE_VALUE)
+                BUS_TRACE_THROW(std::runtime_error("Failed to open file " +
+                                                   path.string()));
+            LARGE_INTEGER li;
+            li.QuadPart = static_cast<LONGLONG>(size);
+            mMapping = CreateFileMappingW(mFile, NULL, PAGE_READWRITE,
+                                          static_cast<DWORD>(li.HighPart),
+                                          li.LowPart, NULL);
+            if(mMapping != NULL)
+                mData = MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, size);
+            if(mData == nullptr) {
+                release();
+                BUS_TRACE_THROW(std::runtime_error("Failed to map file " +
+                                                   path.string()));
+            }
+        }
+        BUS_TRACE_END();
+    }
+    void MappedFile::release() {
+        if(mData)
+            UnmapViewOfFile(mData);
+        if(mMapping != NULL)
+            CloseHandle(mMapping);
+        if(mFile != INVALID_HANDLE_VALUE)
+            CloseHandle(mFile);
+        mData = nullptr, mMapping = NULL, mFile = INVALID_HANDLE_VALUE;
+    }
+    void MappedFile::flush(size_t offset, size_t size) {
+        if(mData)
+            FlushViewOfFile(static_cast<char*>(mData) + offset, size);
+    }
+#else
+    static std::string syserr2String(const std::string& func) {
+        return "Failed to call function " + func +
+            "\nReason:" + std::strerror(errno);
+    }
+    MappedFile::MappedFile(const fs::path& path)
+        : mData(nullptr), mSize(0), mFile(-1) {
+        BUS_TRACE_BEGIN("BusMappedFile") {
+            mFile = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(mFile < 0)
+                BUS_TRACE_THROW(std::runtime_error("Failed to open file " +
+                                                   path.string() + '\n' +
+                                                   syserr2String("open")));
+            struct stat st;
+            if(fstat(mFile, &st) != 0) {
+                release();
+                BUS_TRACE_THROW(std::runtime_error("Failed to open file " +
+                                                   path.string() + '\n' +
+                                                   syserr2String("fstat")));
+            }
+            mSize = static_cast<size_t>(st.st_size);
+            if(mSize == 0)
+                return;
+            mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+            if(mData == MAP_FAILED) {
+                mData = nullptr;
+                release();
+                BUS_TRACE_THROW(std::runtime_error("Failed to map file " +
+                                                   path.string() + '\n' +
+                                                   syserr2String("mmap")));
+            }
+        }
+        BUS_TRACE_END();
+    }
+    MappedFile::MappedFile(const fs::path& path, size_t size)
+        : mData(nullptr), mSize(size), mFile(-1) {
+        BUS_TRACE_BEGIN("BusMappedFile") {
+            mFile = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if(mFile < 0)
+                BUS_TRACE_THROW(std::runtime_error("Failed to open file " +
+                                                   path.string() + '\n' +
+                                                   syserr2String("open")));
+            if(ftruncate(mFile, static_cast<off_t>(size)) != 0) {
+                release();
+                BUS_TRACE_THROW(std::runtime_error(
+                    "Failed to resize file " + path.string() + '\n' +
+                    syserr2String("ftruncate")));
+            }
+            mData = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         mFile, 0);
+            if(mData == MAP_FAILED) {
+                mData = nullptr;
+                release();
+                BUS_TRACE_THROW(std::runtime_error("Failed to map file " +
+                                                   path.string() + '\n' +
+                                                   syserr2String("mmap")));
+            }
+        }
+        BUS_TRACE_END();
+    }
+    void MappedFile::release() {
+        if(mData)
+            munmap(mData, mSize);
+        if(mFile >= 0)
+            close(mFile);
+        mData = nullptr, mFile = -1;
+    }
+    void MappedFile::flush(size_t offset, size_t size) {
+        if(mData == nullptr)
+            return;
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t beg = offset / page * page;
+        msync(static_cast<char*>(mData) + beg, offset + size - beg, MS_ASYNC);
+    }
+#endif
+    MappedFile::~MappedFile() {
+        release();
+    }
+}  // namespace Bus
@@ -0,0 +1,31 @@
+#pragma once
+#include "BusCommon.hpp"
+
+namespace Bus {
+    class MappedFile final : private Unmoveable {
+    private:
+        void* mData;
+        size_t mSize;
+#ifdef _WIN32
+        void* mFile;
+        void* mMapping;
+#else
+        int mFile;
+#endif
+        void release();
+
+    public:
+        // Maps the whole file read-only, or creates/extends it to size bytes
+        // and maps it writable.
+        explicit MappedFile(const fs::path& path);
+        MappedFile(const fs::path& path, size_t size);
+        ~MappedFile();
+        void* data() const {
+            return mData;
+        }
+        size_t size() const {
+            return mSize;
+        }
+        void flush(size_t offset, size_t size);
+    };
+}  // namespace Bus
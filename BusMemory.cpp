@@ -0,0 +1,165 @@
+#include "BusMemory.hpp"
+#include "BusReporter.hpp"
+#include "BusSystem.hpp"
+#include <algorithm>
+
+namespace Bus {
+    static std::unique_ptr<std::pmr::memory_resource>
+    makeUpstream(const MemoryConfig& config) {
+        if(config.kind == MemoryKind::Monotonic) {
+            if(config.initialSize)
+                return std::make_unique<std::pmr::monotonic_buffer_resource>(
+                    config.initialSize);
+            return std::make_unique<std::pmr::monotonic_buffer_resource>();
+        }
+        // Guarded by ModuleMemory instead of synchronized_pool_resource,
+        // which takes a thread-specific key per resource in libstdc++ and
+        // so runs out after about a thousand modules.
+        std::pmr::pool_options options;
+        options.largest_required_pool_block = config.largestPooledBlock;
+        return std::make_unique<std::pmr::unsynchronized_pool_resource>(
+            options);
+    }
+
+    ModuleMemory::ModuleMemory(const MemoryConfig& config,
+                               std::shared_ptr<Reporter> reporter)
+        : mReporter(std::move(reporter)), mKind(config.kind),
+          mUpstream(makeUpstream(config)), mSoftLimit(config.softLimit),
+          mGUID{} {}
+    ModuleMemory::~ModuleMemory() {
+        uint64_t live = mLive;
+        if(live)
+            BUS_REPORT(*mReporter, Info, BUS_SRCLOC("BusMemory"),
+                       "Released ", live, " bytes still held by module ",
+                       mGUID, " [name=", mName, "].");
+    }
+    void* ModuleMemory::do_allocate(size_t bytes, size_t align) {
+        void* ptr;
+        {
+            std::lock_guard guard(mUpstreamMutex);
+            ptr = mUpstream->allocate(bytes, align);
+        }
+        // Counters are only statistics, so relaxed ordering is enough.
+        constexpr auto relaxed = std::memory_order_relaxed;
+        mAllocations.fetch_add(1, relaxed);
+        uint64_t live = mLive.fetch_add(bytes, relaxed) + bytes;
+        uint64_t peak = mPeak.load(relaxed);
+        while(peak < live &&
+              !mPeak.compare_exchange_weak(peak, live, relaxed))
+            ;
+        size_t limit = mSoftLimit.load(relaxed);
+        if(limit && live > limit && !mOverLimit.exchange(true)) {
+            // Reported unlocked, the reporter may ask for the stats.
+            GUID guid;
+            std::string name;
+            {
+                std::lock_guard guard(mLabelMutex);
+                guid = mGUID;
+                name = mName;
+            }
+            BUS_REPORT(*mReporter, Warning, BUS_SRCLOC("BusMemory"),
+                       "Module ", guid, " [name=", name, "] uses ", live,
+                       " bytes, over its soft limit of ", limit, " bytes.");
+        }
+        return ptr;
+    }
+    void ModuleMemory::do_deallocate(void* ptr, size_t bytes, size_t align) {
+        {
+            std::lock_guard guard(mUpstreamMutex);
+            mUpstream->deallocate(ptr, bytes, align);
+        }
+        constexpr auto relaxed = std::memory_order_relaxed;
+        uint64_t live = mLive.fetch_sub(bytes, relaxed) - bytes;
+        if(live <= mSoftLimit.load(relaxed) && mOverLimit.load(relaxed))
+            mOverLimit = false;
+    }
+    bool ModuleMemory::do_is_equal(
+        const std::pmr::memory_resource& rhs) const noexcept {
+        return this == &rhs;
+    }
+    void ModuleMemory::label(GUID guid, Name name) {
+        std::lock_guard guard(mLabelMutex);
+        mGUID = guid;
+        mName = name;
+    }
+    GUID ModuleMemory::guid() const {
+        std::lock_guard guard(mLabelMutex);
+        return mGUID;
+    }
+    void ModuleMemory::setSoftLimit(size_t bytes) {
+        mSoftLimit = bytes;
+        mOverLimit = false;
+    }
+    MemoryStats ModuleMemory::stats() const {
+        std::lock_guard guard(mLabelMutex);
+        return { mGUID, mName,        mKind,     mLive,
+                 mPeak, mAllocations, mSoftLimit };
+    }
+
+    void MemoryRegistry::setConfig(const MemoryConfig& config) {
+        std::lock_guard guard(mMutex);
+        mConfig = config;
+    }
+    std::shared_ptr<ModuleMemory>
+    MemoryRegistry::create(std::shared_ptr<Reporter> reporter) {
+        std::lock_guard guard(mMutex);
+        mMemory.erase(std::remove_if(mMemory.begin(), mMemory.end(),
+                                     [](auto&& memory) {
+                                         return memory.expired();
+                                     }),
+                      mMemory.end());
+        auto memory =
+            std::make_shared<ModuleMemory>(mConfig, std::move(reporter));
+        mMemory.emplace_back(memory);
+        return memory;
+    }
+    std::vector<std::shared_ptr<ModuleMemory>> MemoryRegistry::live() {
+        std::lock_guard guard(mMutex);
+        std::vector<std::shared_ptr<ModuleMemory>> res;
+        for(auto&& weak : mMemory)
+            if(auto memory = weak.lock())
+                res.emplace_back(std::move(memory));
+        return res;
+    }
+
+    static thread_local std::shared_ptr<ModuleMemory> currentMemory;
+
+    MemoryScope::MemoryScope(std::shared_ptr<ModuleMemory> memory)
+        : mMemory(std::move(memory)), mPrevious(currentMemory) {
+        currentMemory = mMemory;
+    }
+    MemoryScope::~MemoryScope() {
+        currentMemory = std::move(mPrevious);
+    }
+    void MemoryScope::label(const ModuleInfo& info) {
+        mMemory->label(info.guid, info.name);
+    }
+    std::shared_ptr<ModuleMemory> MemoryScope::current() {
+        return currentMemory;
+    }
+
+    void ModuleSystem::setMemoryConfig(const MemoryConfig& config) {
+        mMemory->setConfig(config);
+    }
+    std::shared_ptr<ModuleMemory> ModuleSystem::createModuleMemory() {
+        return mMemory->create(mReporter);
+    }
+    bool ModuleSystem::setMemoryLimit(GUID guid, size_t softLimit) {
+        bool found = false;
+        for(auto&& memory : mMemory->live())
+            if(memory->guid() == guid) {
+                memory->setSoftLimit(softLimit);
+                found = true;
+            }
+        if(!found)
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusMemory"),
+                       "No loaded module's GUID is ", guid, '.');
+        return found;
+    }
+    std::vector<MemoryStats> ModuleSystem::memoryStats() {
+        std::vector<MemoryStats> res;
+        for(auto&& memory : mMemory->live())
+            res.emplace_back(memory->stats());
+        return res;
+    }
+}  // namespace Bus
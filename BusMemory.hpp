@@ -0,0 +1,92 @@
+#pragma once
+#include "BusCommon.hpp"
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace Bus {
+    enum class MemoryKind { Pool, Monotonic };
+
+    struct MemoryConfig final {
+        MemoryKind kind = MemoryKind::Pool;
+        // Size of the first buffer of a monotonic arena, 0 for the default.
+        size_t initialSize = 0;
+        // Larger blocks bypass the pools, 0 for the default.
+        size_t largestPooledBlock = 0;
+        // Live bytes above this are reported as a warning, 0 for no limit.
+        size_t softLimit = 0;
+    };
+
+    struct MemoryStats final {
+        GUID guid;
+        std::string name;
+        MemoryKind kind;
+        uint64_t live;
+        uint64_t peak;
+        uint64_t allocations;
+        size_t softLimit;
+    };
+
+    // Memory resource of one module. Everything still allocated from it is
+    // released at once when it is destroyed with the module instance.
+    class ModuleMemory final : public std::pmr::memory_resource,
+                               private Unmoveable {
+    private:
+        std::shared_ptr<Reporter> mReporter;
+        MemoryKind mKind;
+        // Neither upstream resource is thread safe.
+        std::mutex mUpstreamMutex;
+        std::unique_ptr<std::pmr::memory_resource> mUpstream;
+        std::atomic_uint64_t mLive{ 0 };
+        std::atomic_uint64_t mPeak{ 0 };
+        std::atomic_uint64_t mAllocations{ 0 };
+        std::atomic_size_t mSoftLimit;
+        std::atomic_bool mOverLimit{ false };
+        mutable std::mutex mLabelMutex;
+        GUID mGUID;
+        std::string mName;
+
+        void* do_allocate(size_t bytes, size_t align) override;
+        void do_deallocate(void* ptr, size_t bytes, size_t align) override;
+        bool do_is_equal(
+            const std::pmr::memory_resource& rhs) const noexcept override;
+
+    public:
+        ModuleMemory(const MemoryConfig& config,
+                     std::shared_ptr<Reporter> reporter);
+        ~ModuleMemory() override;
+        void label(GUID guid, Name name);
+        GUID guid() const;
+        void setSoftLimit(size_t bytes);
+        MemoryStats stats() const;
+    };
+
+    class MemoryRegistry final : private Unmoveable {
+    private:
+        std::mutex mMutex;
+        MemoryConfig mConfig;
+        std::vector<std::weak_ptr<ModuleMemory>> mMemory;
+
+    public:
+        void setConfig(const MemoryConfig& config);
+        std::shared_ptr<ModuleMemory>
+        create(std::shared_ptr<Reporter> reporter);
+        std::vector<std::shared_ptr<ModuleMemory>> live();
+    };
+
+    // ModuleInstance objects constructed on this thread while a scope is
+    // active use its memory. Loaders open one around busInitModule.
+    class MemoryScope final : private Unmoveable {
+    private:
+        std::shared_ptr<ModuleMemory> mMemory;
+        std::shared_ptr<ModuleMemory> mPrevious;
+
+    public:
+        explicit MemoryScope(std::shared_ptr<ModuleMemory> memory);
+        ~MemoryScope();
+        void label(const ModuleInfo& info);
+        static std::shared_ptr<ModuleMemory> current();
+    };
+}  // namespace Bus
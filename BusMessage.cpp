@@ -0,0 +1,160 @@
+#include "BusMessage.hpp"
+#include "BusSystem.hpp"
+#include <algorithm>
+
+namespace Bus {
+    Mailbox::Mailbox(size_t capacity, OverflowPolicy policy)
+        : mQueue(capacity), mPolicy(policy) {}
+    bool Mailbox::push(const Payload& payload) {
+        while(!mQueue.tryPush(payload)) {
+            if(mClosed.load())
+                return false;
+            if(mPolicy == OverflowPolicy::Drop) {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if(mPolicy == OverflowPolicy::DropOldest) {
+                Payload oldest;
+                if(mQueue.tryPop(oldest))
+                    mOverwritten.fetch_add(1, std::memory_order_relaxed);
+            } else if(block(payload))
+                break;
+        }
+        mDelivered.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    // Returns true once the payload is pushed, false to go round again.
+    bool Mailbox::block(const Payload& payload) {
+        wake();
+        std::unique_lock lock(mSpaceMutex);
+        mBlocked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t freed = mFreed;
+        bool pushed = mQueue.tryPush(payload);
+        if(!pushed)
+            mSpace.wait(lock, [&] {
+                return mFreed != freed || mClosed.load();
+            });
+        mBlocked.fetch_sub(1);
+        return pushed;
+    }
+    void Mailbox::freed() {
+        std::lock_guard guard(mSpaceMutex);
+        ++mFreed;
+        mSpace.notify_all();
+    }
+    void Mailbox::close() {
+        mClosed = true;
+        freed();
+    }
+    // The fences order the queue update against mSleeping on both sides,
+    // so a waiting consumer can't miss the wake up.
+    void Mailbox::wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(mSleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard guard(mWaitMutex);
+            mWait.notify_all();
+        }
+    }
+    bool Mailbox::wait(std::chrono::nanoseconds timeout) {
+        if(mQueue.size())
+            return true;
+        std::unique_lock lock(mWaitMutex);
+        mSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ready = mWait.wait_for(lock, timeout,
+                                    [this] { return mQueue.size() != 0; });
+        mSleeping.store(false, std::memory_order_relaxed);
+        return ready;
+    }
+
+    Topic::Topic(Name name, std::type_index type)
+        : mName(name), mType(type),
+          mMailboxes(std::make_shared<const Mailboxes>()) {}
+    void Topic::add(std::shared_ptr<Mailbox> mailbox) {
+        std::lock_guard guard(mMutex);
+        auto mailboxes = std::make_shared<Mailboxes>(*mMailboxes.load());
+        mailboxes->emplace_back(std::move(mailbox));
+        mMailboxes.store(std::move(mailboxes));
+    }
+    void Topic::remove(const std::shared_ptr<Mailbox>& mailbox) {
+        std::lock_guard guard(mMutex);
+        auto mailboxes = std::make_shared<Mailboxes>(*mMailboxes.load());
+        mailboxes->erase(
+            std::remove(mailboxes->begin(), mailboxes->end(), mailbox),
+            mailboxes->end());
+        mMailboxes.store(std::move(mailboxes));
+    }
+    // Copies the list rather than reading it in place, a blocked push must
+    // not hold up add and remove.
+    size_t Topic::publish(const Payload* payloads, size_t count) {
+        auto mailboxes = mMailboxes.load();
+        mPublished.fetch_add(count, std::memory_order_relaxed);
+        size_t res = 0;
+        for(auto&& mailbox : *mailboxes) {
+            bool delivered = false;
+            for(size_t i = 0; i < count; ++i)
+                delivered |= mailbox->push(payloads[i]);
+            mailbox->wake();
+            res += delivered;
+        }
+        return res;
+    }
+    TopicStats Topic::stats() {
+        auto mailboxes = mMailboxes.load();
+        TopicStats res{ mName,
+                        mailboxes->size(),
+                        mPublished.load(std::memory_order_relaxed),
+                        0,
+                        0,
+                        0 };
+        for(auto&& mailbox : *mailboxes) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            res.delivered += mailbox->mDelivered.load(relaxed);
+            res.dropped += mailbox->mDropped.load(relaxed);
+            res.overwritten += mailbox->mOverwritten.load(relaxed);
+        }
+        return res;
+    }
+
+    MessageBus::MessageBus(std::shared_ptr<Reporter> reporter)
+        : mReporter(std::move(reporter)) {}
+    std::shared_ptr<Topic> MessageBus::topic(Name name,
+                                             std::type_index type) {
+        std::shared_ptr<Topic> res;
+        {
+            std::lock_guard guard(mMutex);
+            auto& topic = mTopics[std::string(name)];
+            if(!topic)
+                topic = std::make_shared<Topic>(name, type);
+            res = topic;
+        }
+        if(res->type() != type) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusMessage"), "Topic ",
+                       name, " carries ", res->type().name(), ", not ",
+                       type.name(), '.');
+            return nullptr;
+        }
+        return res;
+    }
+    std::vector<TopicStats> MessageBus::stats() {
+        std::vector<std::shared_ptr<Topic>> topics;
+        {
+            std::lock_guard guard(mMutex);
+            for(auto&& topic : mTopics)
+                topics.emplace_back(topic.second);
+        }
+        std::vector<TopicStats> res;
+        for(auto&& topic : topics)
+            res.emplace_back(topic->stats());
+        std::sort(res.begin(), res.end(),
+                  [](const TopicStats& lhs, const TopicStats& rhs) {
+                      return lhs.name < rhs.name;
+                  });
+        return res;
+    }
+
+    MessageBus& ModuleSystem::getMessageBus() {
+        return *mBus;
+    }
+}  // namespace Bus
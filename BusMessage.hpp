@@ -0,0 +1,221 @@
+#pragma once
+#include "BusPublished.hpp"
+#include "BusReporter.hpp"
+#include "BusRingBuffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+namespace Bus {
+    // Payloads are immutable and refcounted, so one message reaches every
+    // subscriber of a topic without being copied. A topic carries a single
+    // payload type, fixed by its first publisher or subscriber.
+    using Payload = std::shared_ptr<const void>;
+
+    struct TopicStats final {
+        std::string name;
+        size_t subscribers;
+        uint64_t published;
+        uint64_t delivered;
+        uint64_t dropped;
+        uint64_t overwritten;
+    };
+
+    class Mailbox final : private Unmoveable {
+    private:
+        RingBuffer<Payload> mQueue;
+        OverflowPolicy mPolicy;
+        std::atomic_bool mSleeping{ false };
+        std::atomic_bool mClosed{ false };
+        std::mutex mWaitMutex;
+        std::condition_variable mWait;
+        // Eventcount for publishers blocked on a full queue: they announce
+        // themselves before their last try, pop bumps mFreed under the
+        // mutex.
+        std::atomic_uint32_t mBlocked{ 0 };
+        uint64_t mFreed = 0;
+        std::mutex mSpaceMutex;
+        std::condition_variable mSpace;
+        std::atomic_uint64_t mDelivered{ 0 };
+        std::atomic_uint64_t mDropped{ 0 };
+        std::atomic_uint64_t mOverwritten{ 0 };
+
+        bool block(const Payload& payload);
+        void freed();
+
+    public:
+        Mailbox(size_t capacity, OverflowPolicy policy);
+        // Returns false if the message was dropped or the mailbox is
+        // closed.
+        bool push(const Payload& payload);
+        // Called when the subscriber goes away, so that publishers blocked
+        // on a full mailbox give up.
+        void close();
+        bool pop(Payload& payload) {
+            if(!mQueue.tryPop(payload))
+                return false;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(mBlocked.load(std::memory_order_relaxed))
+                freed();
+            return true;
+        }
+        bool wait(std::chrono::nanoseconds timeout);
+        void wake();
+        friend class Topic;
+    };
+
+    // Subscribers are kept in a copy-on-write list, so publishing never
+    // takes a lock.
+    class Topic final : private Unmoveable {
+    private:
+        using Mailboxes = std::vector<std::shared_ptr<Mailbox>>;
+        std::string mName;
+        std::type_index mType;
+        std::mutex mMutex;
+        Published<const Mailboxes> mMailboxes;
+        std::atomic_uint64_t mPublished{ 0 };
+
+    public:
+        Topic(Name name, std::type_index type);
+        Name name() const {
+            return mName;
+        }
+        std::type_index type() const {
+            return mType;
+        }
+        void add(std::shared_ptr<Mailbox> mailbox);
+        void remove(const std::shared_ptr<Mailbox>& mailbox);
+        // Returns the number of subscribers that received the messages.
+        size_t publish(const Payload* payloads, size_t count);
+        TopicStats stats();
+    };
+
+    template <typename T>
+    class Publisher final {
+    private:
+        std::shared_ptr<Topic> mTopic;
+
+    public:
+        Publisher() = default;
+        explicit Publisher(std::shared_ptr<Topic> topic)
+            : mTopic(std::move(topic)) {}
+        explicit operator bool() const {
+            return mTopic != nullptr;
+        }
+        size_t publish(std::shared_ptr<const T> message) {
+            Payload payload = std::move(message);
+            return mTopic ? mTopic->publish(&payload, 1) : 0;
+        }
+        // Moves the value into a new shared payload.
+        size_t publish(T&& value) {
+            return publish(std::make_shared<const T>(std::move(value)));
+        }
+        size_t publish(const std::vector<std::shared_ptr<const T>>& batch) {
+            if(!mTopic)
+                return 0;
+            std::vector<Payload> payloads(batch.cbegin(), batch.cend());
+            return mTopic->publish(payloads.data(), payloads.size());
+        }
+    };
+
+    // Owned by one consumer thread. Messages are delivered in batches by
+    // poll, and the policy decides what a full queue does to publishers.
+    // Under OverflowPolicy::Block a publisher sleeps until the consumer
+    // makes room, so the consumer's thread must not publish to its own
+    // topic: once the mailbox is full it would wait for itself.
+    template <typename T>
+    class Subscription final {
+    private:
+        std::shared_ptr<Topic> mTopic;
+        std::shared_ptr<Mailbox> mMailbox;
+
+    public:
+        Subscription() = default;
+        Subscription(std::shared_ptr<Topic> topic, size_t capacity,
+                     OverflowPolicy policy)
+            : mTopic(std::move(topic)) {
+            if(!mTopic)
+                return;
+            mMailbox = std::make_shared<Mailbox>(capacity, policy);
+            mTopic->add(mMailbox);
+        }
+        Subscription(Subscription&& rhs) noexcept = default;
+        Subscription& operator=(Subscription&& rhs) noexcept {
+            reset();
+            mTopic = std::move(rhs.mTopic);
+            mMailbox = std::move(rhs.mMailbox);
+            return *this;
+        }
+        ~Subscription() {
+            reset();
+        }
+        void reset() {
+            if(mTopic) {
+                mMailbox->close();
+                mTopic->remove(mMailbox);
+            }
+            mTopic.reset();
+            mMailbox.reset();
+        }
+        explicit operator bool() const {
+            return mTopic != nullptr;
+        }
+        // Appends up to maxCount messages to batch.
+        size_t poll(std::vector<std::shared_ptr<const T>>& batch,
+                    size_t maxCount) {
+            Payload payload;
+            size_t count = 0;
+            // The topic checked T, so the casts are safe.
+            while(mMailbox && count < maxCount && mMailbox->pop(payload)) {
+                batch.emplace_back(std::static_pointer_cast<const T>(
+                    std::move(payload)));
+                ++count;
+            }
+            return count;
+        }
+        template <typename Callable>
+        size_t poll(Callable&& callable, size_t maxCount) {
+            Payload payload;
+            size_t count = 0;
+            while(mMailbox && count < maxCount && mMailbox->pop(payload)) {
+                callable(*static_cast<const T*>(payload.get()));
+                ++count;
+            }
+            return count;
+        }
+        // Sleeps until a message arrives or the timeout expires.
+        bool wait(std::chrono::nanoseconds timeout) {
+            return mMailbox && mMailbox->wait(timeout);
+        }
+    };
+
+    // Publishers and subscriptions of a topic used with another payload
+    // type than its first one are reported and come back empty.
+    class MessageBus final : private Unmoveable {
+    private:
+        std::shared_ptr<Reporter> mReporter;
+        std::mutex mMutex;
+        std::unordered_map<std::string, std::shared_ptr<Topic>> mTopics;
+
+    public:
+        explicit MessageBus(std::shared_ptr<Reporter> reporter);
+        std::shared_ptr<Topic> topic(Name name, std::type_index type);
+        template <typename T>
+        Publisher<T> publisher(Name name) {
+            return Publisher<T>(topic(name, typeid(T)));
+        }
+        template <typename T>
+        Subscription<T>
+        subscribe(Name name, size_t capacity = 1024,
+                  OverflowPolicy policy = OverflowPolicy::Block) {
+            return Subscription<T>(topic(name, typeid(T)), capacity, policy);
+        }
+        std::vector<TopicStats> stats();
+    };
+}  // namespace Bus
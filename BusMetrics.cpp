@@ -0,0 +1,244 @@
+#include "BusMetrics.hpp"
+#include <algorithm>
+#include <ostream>
+#include <thread>
+
+namespace Bus {
+    uint64_t threadHash() {
+        thread_local uint64_t id =
+            std::hash<std::thread::id>{}(std::this_thread::get_id());
+        return id;
+    }
+
+    FunctionMetrics::Stripe&
+    FunctionMetrics::local(std::array<Stripe, stripeCount>& stripes) {
+        static std::atomic_uint32_t next{ 0 };
+        thread_local uint32_t index = next++ % stripeCount;
+        return stripes[index];
+    }
+
+    FunctionMetrics::FunctionMetrics(Name name) : mName(name) {}
+
+    void FunctionMetrics::recordCreate(uint64_t ns) {
+        Stripe& stripe = local(mStripes);
+        stripe.calls.fetch_add(1, std::memory_order_relaxed);
+        stripe.totalNs.fetch_add(ns, std::memory_order_relaxed);
+        stripe.live.fetch_add(1, std::memory_order_relaxed);
+        size_t bucket = 0;
+        while(bucket + 1 < latencyBuckets && (ns >> (bucket + 1)))
+            ++bucket;
+        stripe.latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void FunctionMetrics::recordRelease() {
+        local(mStripes).live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    FunctionStats FunctionMetrics::stats() const {
+        FunctionStats res{ mName, 0, 0, 0, {} };
+        for(auto&& stripe : mStripes) {
+            res.instantiations += stripe.calls.load(std::memory_order_relaxed);
+            res.totalNs += stripe.totalNs.load(std::memory_order_relaxed);
+            res.live += stripe.live.load(std::memory_order_relaxed);
+            for(size_t i = 0; i < latencyBuckets; ++i)
+                res.latency[i] +=
+                    stripe.latency[i].load(std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+    ModuleMetrics::ModuleMetrics(GUID guid, Name name, uint64_t loadNs,
+                                 uint64_t initNs,
+                                 std::shared_ptr<MetricNames> names)
+        : mTable(std::make_shared<const Table>()), mNames(std::move(names)),
+          mGUID(guid), mName(mNames->intern(name)), mLoadNs(loadNs),
+          mInitNs(initNs) {}
+
+    FunctionMetrics& ModuleMetrics::function(Name name) {
+        auto find = [name](const Table* table) -> FunctionMetrics* {
+            auto iter = table->find(name);
+            return iter == table->cend() ? nullptr : iter->second;
+        };
+        if(auto res = mTable.read(find))
+            return *res;
+        std::lock_guard guard(mMutex);
+        if(auto res = mTable.read(find))
+            return *res;
+        FunctionMetrics& res = mFunctions.emplace_back(mNames->intern(name));
+        auto updated = std::make_shared<Table>(*mTable.load());
+        updated->emplace(res.name(), &res);
+        mTable.store(std::move(updated));
+        return res;
+    }
+
+    void ModuleMetrics::setLoadStats(uint64_t loadNs, uint64_t initNs) {
+        mLoadNs.store(loadNs, std::memory_order_relaxed);
+        mInitNs.store(initNs, std::memory_order_relaxed);
+    }
+
+    ModuleStats ModuleMetrics::stats() const {
+        ModuleStats res{ mGUID, mName,
+                         mLoadNs.load(std::memory_order_relaxed),
+                         mInitNs.load(std::memory_order_relaxed),
+                         {} };
+        auto table = mTable.load();
+        res.functions.reserve(table->size());
+        for(auto&& func : *table)
+            res.functions.emplace_back(func.second->stats());
+        return res;
+    }
+
+    SystemMetrics::SystemMetrics()
+        : mEpoch(Clock::now()), mEnabled(false),
+          mNames(std::make_shared<MetricNames>()), mTracing(false),
+          mTrace(nullptr), mTraceDropped(0) {}
+
+    void SystemMetrics::enable(bool enable) {
+        mEnabled.store(enable, std::memory_order_relaxed);
+    }
+
+    void SystemMetrics::enableTrace(size_t capacity) {
+        std::lock_guard guard(mMutex);
+        mTracing.store(false);
+        mTrace.store(capacity ?
+                         std::make_shared<RingBuffer<TraceEvent>>(capacity) :
+                         nullptr);
+        mTracing.store(capacity != 0);
+    }
+
+    uint64_t SystemMetrics::now() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                 mEpoch)
+                .count());
+    }
+
+    std::shared_ptr<ModuleMetrics> SystemMetrics::addModule(GUID guid,
+                                                            Name name,
+                                                            uint64_t loadNs,
+                                                            uint64_t initNs) {
+        auto res = std::make_shared<ModuleMetrics>(guid, name, loadNs, initNs,
+                                                   mNames);
+        if(loadNs || initNs)
+            recordLoad(*res, loadNs, initNs);
+        std::lock_guard guard(mMutex);
+        mModules.emplace_back(res);
+        return res;
+    }
+
+    void SystemMetrics::removeModule(const ModuleMetrics& module) {
+        std::lock_guard guard(mMutex);
+        mModules.erase(std::remove_if(mModules.begin(), mModules.end(),
+                                      [&](const auto& entry) {
+                                          return entry.get() == &module;
+                                      }),
+                       mModules.end());
+    }
+
+    void SystemMetrics::recordLoad(ModuleMetrics& module, uint64_t loadNs,
+                                   uint64_t initNs) {
+        module.setLoadStats(loadNs, initNs);
+        uint64_t end = now();
+        uint64_t duration = loadNs + initNs;
+        trace("load", module.name(), {}, end > duration ? end - duration : 0,
+              duration);
+    }
+
+    void SystemMetrics::trace(const char* category, Name module,
+                              Name function, uint64_t beginNs,
+                              uint64_t durationNs) {
+        if(!mTracing.load(std::memory_order_relaxed))
+            return;
+        mTrace.read([&](RingBuffer<TraceEvent>* buffer) {
+            if(buffer &&
+               !buffer->tryPush(TraceEvent{ category, module, function,
+                                            threadHash(), beginNs,
+                                            durationNs }))
+                mTraceDropped.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+
+    std::vector<ModuleStats> SystemMetrics::stats() {
+        std::lock_guard guard(mMutex);
+        std::vector<ModuleStats> res;
+        res.reserve(mModules.size());
+        for(auto&& module : mModules)
+            res.emplace_back(module->stats());
+        return res;
+    }
+
+    void writeJSONString(std::ostream& out, Name str) {
+        static const char hex[] = "0123456789abcdef";
+        out << '"';
+        for(char c : str) {
+            if(c == '"' || c == '\\')
+                out << '\\' << c;
+            else if(static_cast<unsigned char>(c) < 0x20)
+                out << "\\u00" << hex[(c >> 4) & 15] << hex[c & 15];
+            else
+                out << c;
+        }
+        out << '"';
+    }
+
+    void writeMicroseconds(std::ostream& out, uint64_t ns) {
+        char fraction[4] = { static_cast<char>('0' + ns / 100 % 10),
+                             static_cast<char>('0' + ns / 10 % 10),
+                             static_cast<char>('0' + ns % 10), 0 };
+        out << ns / 1000 << '.' << fraction;
+    }
+
+    void SystemMetrics::exportStats(std::ostream& out) {
+        auto modules = stats();
+        out << "{\"modules\":[";
+        for(size_t i = 0; i < modules.size(); ++i) {
+            auto&& module = modules[i];
+            out << (i ? ",{" : "{") << "\"guid\":";
+            writeJSONString(out, GUID2Str(module.guid));
+            out << ",\"name\":";
+            writeJSONString(out, module.name);
+            out << ",\"loadNs\":" << module.loadNs
+                << ",\"initNs\":" << module.initNs << ",\"functions\":[";
+            for(size_t j = 0; j < module.functions.size(); ++j) {
+                auto&& func = module.functions[j];
+                out << (j ? ",{" : "{") << "\"name\":";
+                writeJSONString(out, func.name);
+                out << ",\"instantiations\":" << func.instantiations
+                    << ",\"live\":" << func.live
+                    << ",\"totalNs\":" << func.totalNs << ",\"latencyNs\":[";
+                for(size_t k = 0; k < latencyBuckets; ++k)
+                    out << (k ? "," : "") << func.latency[k];
+                out << "]}";
+            }
+            out << "]}";
+        }
+        out << "]}";
+    }
+
+    void SystemMetrics::exportTrace(std::ostream& out) {
+        std::lock_guard guard(mMutex);
+        out << "{\"traceEvents\":[";
+        if(auto trace = mTrace.load()) {
+            TraceEvent event;
+            bool first = true;
+            while(trace->tryPop(event)) {
+                out << (first ? "{" : ",{") << "\"name\":";
+                std::string name(event.module);
+                if(!event.function.empty())
+                    name += '.', name += event.function;
+                writeJSONString(out, name);
+                out << ",\"cat\":\"" << event.category
+                    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                    << event.thread % 1000000007ULL
+                    << ",\"ts\":";
+                writeMicroseconds(out, event.beginNs);
+                out << ",\"dur\":";
+                writeMicroseconds(out, event.durationNs);
+                out << '}';
+                first = false;
+            }
+        }
+        out << "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":"
+            << mTraceDropped.load(std::memory_order_relaxed) << "}}";
+    }
+}  // namespace Bus
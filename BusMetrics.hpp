@@ -0,0 +1,175 @@
+#pragma once
+#include "BusNamePool.hpp"
+#include "BusPublished.hpp"
+#include "BusRingBuffer.hpp"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Bus {
+    uint64_t threadHash();
+    void writeJSONString(std::ostream& out, Name str);
+    // Writes ns as microseconds with all three fractional digits.
+    void writeMicroseconds(std::ostream& out, uint64_t ns);
+
+    // Bucket i counts instantiations that took [2^i, 2^(i+1)) nanoseconds.
+    constexpr size_t latencyBuckets = 32;
+
+    struct FunctionStats final {
+        Name name;
+        uint64_t instantiations;
+        int64_t live;
+        uint64_t totalNs;
+        std::array<uint64_t, latencyBuckets> latency;
+    };
+
+    struct ModuleStats final {
+        GUID guid;
+        Name name;
+        uint64_t loadNs;
+        uint64_t initNs;
+        std::vector<FunctionStats> functions;
+    };
+
+    // Names the metrics and their trace events point into. They are never
+    // freed, so events of a module whose metrics were dropped stay valid.
+    class MetricNames final : private Unmoveable {
+    private:
+        std::mutex mMutex;
+        NamePool mPool;
+
+    public:
+        Name intern(Name name) {
+            std::lock_guard guard(mMutex);
+            return mPool.intern(name);
+        }
+    };
+
+    // Counters are striped by thread so that concurrent instantiations
+    // rarely touch the same cache line.
+    class FunctionMetrics final : private Unmoveable {
+    private:
+        static constexpr size_t stripeCount = 8;
+        struct alignas(64) Stripe final {
+            std::atomic_uint64_t calls{ 0 };
+            std::atomic_uint64_t totalNs{ 0 };
+            std::atomic_int64_t live{ 0 };
+            std::array<std::atomic_uint64_t, latencyBuckets> latency{};
+        };
+        Name mName;
+        std::array<Stripe, stripeCount> mStripes;
+        static Stripe& local(std::array<Stripe, stripeCount>& stripes);
+
+    public:
+        explicit FunctionMetrics(Name name);
+        Name name() const {
+            return mName;
+        }
+        void recordCreate(uint64_t ns);
+        void recordRelease();
+        FunctionStats stats() const;
+    };
+
+    class ModuleMetrics final : private Unmoveable {
+    private:
+        using Table = std::unordered_map<Name, FunctionMetrics*>;
+        std::mutex mMutex;
+        std::deque<FunctionMetrics> mFunctions;
+        Published<const Table> mTable;
+        std::shared_ptr<MetricNames> mNames;
+        GUID mGUID;
+        Name mName;
+        std::atomic_uint64_t mLoadNs, mInitNs;
+
+    public:
+        ModuleMetrics(GUID guid, Name name, uint64_t loadNs, uint64_t initNs,
+                      std::shared_ptr<MetricNames> names =
+                          std::make_shared<MetricNames>());
+        FunctionMetrics& function(Name name);
+        // Lazily loaded modules only know their load times on first use.
+        void setLoadStats(uint64_t loadNs, uint64_t initNs);
+        ModuleStats stats() const;
+        GUID guid() const {
+            return mGUID;
+        }
+        Name name() const {
+            return mName;
+        }
+    };
+
+    struct TraceEvent final {
+        const char* category;
+        Name module;
+        Name function;
+        uint64_t thread;
+        uint64_t beginNs;
+        uint64_t durationNs;
+    };
+
+    class SystemMetrics final : private Unmoveable {
+    private:
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point mEpoch;
+        std::atomic_bool mEnabled;
+        std::mutex mMutex;
+        std::vector<std::shared_ptr<ModuleMetrics>> mModules;
+        std::shared_ptr<MetricNames> mNames;
+        std::atomic_bool mTracing;
+        Published<RingBuffer<TraceEvent>> mTrace;
+        std::atomic_uint64_t mTraceDropped;
+
+    public:
+        SystemMetrics();
+        bool enabled() const {
+            return mEnabled.load(std::memory_order_relaxed);
+        }
+        void enable(bool enable);
+        // Events still being pushed into the previous buffer finish before
+        // it is freed.
+        void enableTrace(size_t capacity);
+        uint64_t now() const;
+        std::shared_ptr<ModuleMetrics> addModule(GUID guid, Name name,
+                                                 uint64_t loadNs,
+                                                 uint64_t initNs);
+        // Drops a replaced module from stats. Objects it created still
+        // update its counters.
+        void removeModule(const ModuleMetrics& module);
+        void recordLoad(ModuleMetrics& module, uint64_t loadNs,
+                        uint64_t initNs);
+        void trace(const char* category, Name module, Name function,
+                   uint64_t beginNs, uint64_t durationNs);
+        std::vector<ModuleStats> stats();
+        void exportStats(std::ostream& out);
+        // Moves the buffered events out, so each event is written by one
+        // export only and the buffer has room for new ones again.
+        void exportTrace(std::ostream& out);
+
+        // keep is released after the object, see pin in BusSystem.cpp.
+        template <typename Create>
+        std::shared_ptr<ModuleFunctionBase>
+        track(const std::shared_ptr<ModuleMetrics>& module, Name function,
+              Create&& create, std::shared_ptr<void> keep = nullptr) {
+            FunctionMetrics& metrics = module->function(function);
+            uint64_t beg = now();
+            std::shared_ptr<ModuleFunctionBase> res = create();
+            uint64_t duration = now() - beg;
+            if(!res)
+                return res;
+            metrics.recordCreate(duration);
+            trace("instantiate", module->name(), metrics.name(), beg,
+                  duration);
+            ModuleFunctionBase* ptr = res.get();
+            return std::shared_ptr<ModuleFunctionBase>(
+                ptr, [res = std::move(res), module, &metrics,
+                      keep = std::move(keep)](ModuleFunctionBase*) mutable {
+                    res.reset();
+                    metrics.recordRelease();
+                    keep.reset();
+                });
+        }
+    };
+}  // namespace Bus
@@ -1,4 +1,5 @@
 #include "BusModule.hpp"
+#include "BusMemory.hpp"
 #include "BusSystem.hpp"
 
 namespace Bus {
@@ -13,13 +14,31 @@ namespace Bus {
     Reporter& ModuleFunctionBase::reporter() {
         return system().getReporter();
     }
+    MessageBus& ModuleFunctionBase::bus() {
+        return system().getMessageBus();
+    }
+    std::pmr::memory_resource& ModuleFunctionBase::memory() {
+        return mInstance.memory();
+    }
     ModuleInstance::ModuleInstance(const fs::path& path,
                                             ModuleSystem& system)
-        : mModulePath(path), mSystem(system) {}
+        : mModulePath(path), mSystem(system),
+          mMemory(MemoryScope::current()) {}
     fs::path ModuleInstance::getModulePath() const {
         return mModulePath;
     }
     ModuleSystem& ModuleInstance::getSystem() {
         return mSystem;
     }
+    std::pmr::memory_resource& ModuleInstance::memory() {
+        if(mMemory)
+            return *mMemory;
+        return *std::pmr::get_default_resource();
+    }
+    std::vector<Name> ModuleInstance::interfaces() const {
+        return {};
+    }
+    FunctionFactory ModuleInstance::factory(Name name) {
+        return [this, name] { return instantiate(name); };
+    }
 }  // namespace Bus
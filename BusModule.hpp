@@ -1,10 +1,18 @@
 #pragma once
 #include "BusCommon.hpp"
 #include <memory>
+#include <memory_resource>
 #include <vector>
 
 namespace Bus {
+#ifdef _WIN32
 #define BUS_API extern "C" __declspec(dllexport)
+#else
+#define BUS_API extern "C" __attribute__((visibility("default")))
+#endif
+
+    class ModuleMemory;
+    class MessageBus;
 
     class ModuleFunctionBase : private Unmoveable {
     protected:
@@ -12,6 +20,8 @@ namespace Bus {
         fs::path modulePath();
         ModuleSystem& system();
         Reporter& reporter();
+        MessageBus& bus();
+        std::pmr::memory_resource& memory();
         explicit ModuleFunctionBase(ModuleInstance& instance);
         virtual ~ModuleFunctionBase() = default;
     };
@@ -20,14 +30,90 @@ namespace Bus {
     protected:
         fs::path mModulePath;
         ModuleSystem& mSystem;
+        std::shared_ptr<ModuleMemory> mMemory;
         explicit ModuleInstance(const fs::path& path, ModuleSystem& system);
 
     public:
         fs::path getModulePath() const;
         ModuleSystem& getSystem();
+        // The module's own memory, see BusMemory.hpp.
+        std::pmr::memory_resource& memory();
         virtual ModuleInfo info() const = 0;
         virtual std::vector<Name> list(Name interfaceName) const = 0;
+        virtual std::vector<Name> interfaces() const;
         virtual std::shared_ptr<ModuleFunctionBase> instantiate(Name name) = 0;
+        // The default dispatches through instantiate on every call.
+        // Override it, or export a factory table, to skip the dispatch.
+        virtual FunctionFactory factory(Name name);
         virtual ~ModuleInstance() = default;
     };
+
+    // Optional export that lets loadModuleDirectory order a module without a
+    // manifest. It runs before busInitModule and reports the module's GUID
+    // and ModuleInfo::dependencies:
+    // BUS_API void busGetDependencies(const Bus::fs::path& path,
+    //                                 Bus::GUID& guid,
+    //                                 std::vector<Bus::GUID>& dependencies);
+
+    // Bumped whenever the layout of FactoryEntry changes.
+    constexpr uint64_t factoryEntryVersion = 2;
+
+    using StaticFactory =
+        std::shared_ptr<ModuleFunctionBase> (*)(ModuleInstance& instance);
+
+    // Entry of the table returned by the optional busGetFactories export:
+    // BUS_API void busGetFactories(const Bus::FactoryEntry*& entries,
+    //                              size_t& count);
+    // The object created by factory must derive from the interface whose id
+    // is given. The system looks entries up by id and, once interfaceName
+    // confirms it, skips dynamic_cast. construct/destroy build the object in
+    // storage provided by the system (size and align describe it), which is
+    // what pooled instantiation uses.
+    struct FactoryEntry final {
+        // factoryEntryVersion of the headers the module was built with.
+        // Tables of another version are ignored.
+        uint64_t version;
+        uint64_t interfaceId;
+        // A function, so that getInterface doesn't have to be constexpr.
+        Name (*interfaceName)();
+        const char* name;
+        StaticFactory factory;
+        ModuleFunctionBase* (*construct)(void* storage,
+                                         ModuleInstance& instance);
+        void (*destroy)(ModuleFunctionBase* object);
+        size_t size;
+        size_t align;
+    };
+
+    namespace Detail {
+        template <typename T>
+        std::shared_ptr<ModuleFunctionBase>
+        createStatic(ModuleInstance& instance) {
+            return std::make_shared<T>(instance);
+        }
+        template <typename T>
+        ModuleFunctionBase* constructStatic(void* storage,
+                                            ModuleInstance& instance) {
+            return new(storage) T(instance);
+        }
+        template <typename T>
+        void destroyStatic(ModuleFunctionBase* object) {
+            static_cast<T*>(object)->~T();
+        }
+        template <typename T>
+        constexpr FactoryEntry makeFactoryEntry(uint64_t interfaceId,
+                                                Name (*interfaceName)(),
+                                                const char* name) {
+            return { factoryEntryVersion, interfaceId,
+                     interfaceName,       name,
+                     &createStatic<T>,    &constructStatic<T>,
+                     &destroyStatic<T>,   sizeof(T),
+                     alignof(T) };
+        }
+    }  // namespace Detail
+
+#define BUS_FACTORY(INTERFACE, NAME, CLASS)                     \
+    Bus::Detail::makeFactoryEntry<CLASS>(                       \
+        Bus::interfaceId(INTERFACE::getInterface()),            \
+        &INTERFACE::getInterface, NAME)
 }  // namespace Bus
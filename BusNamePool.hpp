@@ -0,0 +1,36 @@
+#pragma once
+#include "BusCommon.hpp"
+#include <deque>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace Bus {
+    // Stable copies of names, one per distinct string. Not synchronized.
+    class NamePool final : private Unmoveable {
+    private:
+        std::deque<std::string> mStorage;
+        std::unordered_set<Name> mNames;
+        std::vector<std::shared_ptr<const void>> mOwners;
+
+    public:
+        Name intern(Name name) {
+            auto iter = mNames.find(name);
+            if(iter != mNames.cend())
+                return *iter;
+            Name res = mStorage.emplace_back(name);
+            mNames.insert(res);
+            return res;
+        }
+        // A new name is kept where it is instead of copied, and owner,
+        // which keeps it valid, stays alive with the pool.
+        Name intern(Name name, const std::shared_ptr<const void>& owner) {
+            if(!owner)
+                return intern(name);
+            auto [iter, inserted] = mNames.insert(name);
+            if(inserted && (mOwners.empty() || mOwners.back() != owner))
+                mOwners.push_back(owner);
+            return *iter;
+        }
+    };
+}  // namespace Bus
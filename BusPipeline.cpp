@@ -0,0 +1,152 @@
+#include "BusPipeline.hpp"
+#include "BusReporter.hpp"
+#include "BusScheduler.hpp"
+#include <chrono>
+#include <mutex>
+
+namespace Bus {
+    PipelineCore::PipelineCore(const std::vector<FunctionId>& ids,
+                               const PipelineConfig& config,
+                               ModuleSystem& system)
+        : mCounters(std::make_unique<Counters[]>(ids.size())),
+          mConfig(config),
+          mScheduler(config.parallel ? &system.getScheduler() : nullptr) {
+        if(mConfig.batchSize == 0)
+            mConfig.batchSize = 1;
+        for(auto&& id : ids)
+            mIds.emplace_back(id.guid, std::string(id.name));
+    }
+
+    void PipelineCore::runStage(
+        const std::function<void(size_t, size_t, size_t)>& stage,
+        size_t index, size_t begin, size_t end) {
+        auto beg = std::chrono::steady_clock::now();
+        stage(index, begin, end);
+        addCounters(index, 1, end - begin,
+                    std::chrono::steady_clock::now() - beg);
+    }
+    void PipelineCore::addCounters(size_t index, uint64_t batches,
+                                   uint64_t items,
+                                   std::chrono::nanoseconds busy) {
+        Counters& counters = mCounters[index];
+        counters.batches.fetch_add(batches, std::memory_order_relaxed);
+        counters.items.fetch_add(items, std::memory_order_relaxed);
+        counters.busyNs.fetch_add(static_cast<uint64_t>(busy.count()),
+                                  std::memory_order_relaxed);
+    }
+
+    void PipelineCore::execute(
+        size_t count,
+        const std::function<void(size_t, size_t, size_t)>& stage) {
+        size_t stages = mIds.size();
+        size_t batchSize = mConfig.batchSize;
+        size_t batches = (count + batchSize - 1) / batchSize;
+        if(stages == 0 || batches == 0)
+            return;
+        if(!mScheduler || (stages == 1 && batches == 1)) {
+            // Batch by batch, so that a batch stays in cache across stages.
+            // The end of a stage is the start of the next one and the
+            // counters are only published once.
+            std::vector<std::chrono::nanoseconds> busy(stages);
+            auto publish = [&](size_t done) {
+                for(size_t i = 0; i < stages; ++i) {
+                    size_t runs = done / stages + (i < done % stages);
+                    size_t items = (std::min)(count, runs * batchSize);
+                    addCounters(i, runs, items, busy[i]);
+                }
+            };
+            size_t done = 0;
+            try {
+                for(size_t begin = 0; begin < count; begin += batchSize) {
+                    size_t end = (std::min)(count, begin + batchSize);
+                    auto last = std::chrono::steady_clock::now();
+                    for(size_t i = 0; i < stages; ++i) {
+                        stage(i, begin, end);
+                        auto now = std::chrono::steady_clock::now();
+                        busy[i] += now - last;
+                        last = now;
+                        ++done;
+                    }
+                }
+            } catch(...) {
+                publish(done);
+                throw;
+            }
+            publish(done);
+            return;
+        }
+
+        // Stage i of batch j waits for stage i - 1 of batch j and for stage
+        // i of batch j - 1, whichever finishes last starts it.
+        auto pending =
+            std::make_unique<std::atomic_uint8_t[]>(stages * batches);
+        for(size_t i = 0; i < stages; ++i)
+            for(size_t j = 0; j < batches; ++j)
+                pending[i * batches + j].store(
+                    static_cast<uint8_t>((i > 0) + (j > 0)),
+                    std::memory_order_relaxed);
+        std::mutex mutex;
+        std::exception_ptr error;
+        std::atomic_bool failed{ false };
+        TaskGroup group(*mScheduler);
+        std::function<void(size_t, size_t)> launch = [&](size_t i, size_t j) {
+            group.run([&, i, j] {
+                if(failed.load(std::memory_order_relaxed))
+                    return;
+                // Starting a successor can fail as well, it must not leave
+                // the remaining batches unprocessed without an error.
+                try {
+                    size_t begin = j * batchSize;
+                    size_t end = (std::min)(count, begin + batchSize);
+                    runStage(stage, i, begin, end);
+                    if(i + 1 < stages &&
+                       pending[(i + 1) * batches + j].fetch_sub(1) == 1)
+                        launch(i + 1, j);
+                    if(j + 1 < batches &&
+                       pending[i * batches + j + 1].fetch_sub(1) == 1)
+                        launch(i, j + 1);
+                } catch(...) {
+                    std::lock_guard guard(mutex);
+                    if(!error)
+                        error = std::current_exception();
+                    failed = true;
+                }
+            });
+        };
+        launch(0, 0);
+        group.wait();
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+    std::vector<StageStats> PipelineCore::stats() const {
+        std::vector<StageStats> res;
+        for(size_t i = 0; i < mIds.size(); ++i) {
+            const Counters& counters = mCounters[i];
+            res.push_back({ mIds[i].first, mIds[i].second,
+                            counters.batches.load(std::memory_order_relaxed),
+                            counters.items.load(std::memory_order_relaxed),
+                            counters.busyNs.load(std::memory_order_relaxed) });
+        }
+        return res;
+    }
+    void PipelineCore::resetStats() {
+        for(size_t i = 0; i < mIds.size(); ++i) {
+            mCounters[i].batches = 0;
+            mCounters[i].items = 0;
+            mCounters[i].busyNs = 0;
+        }
+    }
+
+    void ModuleSystem::reportBadStage(FunctionId id, Name interfaceName) {
+        BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Pipeline"),
+                   "Pipeline stage ", id.guid, '.', id.name,
+                   " can't be instantiated as ", interfaceName, '.');
+    }
+    void ModuleSystem::reportBadStage(Name name, Name interfaceName,
+                                      const Error& error) {
+        BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Pipeline"),
+                   "Pipeline stage ", name, " [interface=", interfaceName,
+                   "] can't be resolved: ", error.message, '.');
+    }
+}  // namespace Bus
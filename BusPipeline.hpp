@@ -0,0 +1,108 @@
+#pragma once
+#include "BusModule.hpp"
+#include "BusResult.hpp"
+#include "BusSystem.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Bus {
+    // Stage of a Pipeline over items of type Item. A stage only has to
+    // transform one item; overriding process handles a whole batch with a
+    // single virtual call in a loop the compiler can vectorize.
+    template <typename Item>
+    class BatchFunction : public ModuleFunctionBase {
+    protected:
+        explicit BatchFunction(ModuleInstance& instance)
+            : ModuleFunctionBase(instance) {}
+
+    public:
+        using ItemType = Item;
+        virtual void apply(Item& item) = 0;
+        virtual void process(Item* items, size_t count) {
+            for(size_t i = 0; i < count; ++i)
+                apply(items[i]);
+        }
+    };
+
+    struct PipelineConfig final {
+        size_t batchSize = 256;
+        // Runs the stages on the scheduler, so that a stage works on one
+        // batch while the next stage works on the previous batch. A stage
+        // still sees its batches one at a time and in order.
+        bool parallel = false;
+    };
+
+    struct StageStats final {
+        GUID guid;
+        std::string name;
+        uint64_t batches;
+        uint64_t items;
+        uint64_t busyNs;
+    };
+
+    class PipelineCore : private Unmoveable {
+    private:
+        struct alignas(64) Counters final {
+            std::atomic_uint64_t batches{ 0 };
+            std::atomic_uint64_t items{ 0 };
+            std::atomic_uint64_t busyNs{ 0 };
+        };
+        std::vector<std::pair<GUID, std::string>> mIds;
+        std::unique_ptr<Counters[]> mCounters;
+        PipelineConfig mConfig;
+        Scheduler* mScheduler;
+
+        void runStage(const std::function<void(size_t, size_t, size_t)>& stage,
+                      size_t index, size_t begin, size_t end);
+        void addCounters(size_t index, uint64_t batches, uint64_t items,
+                         std::chrono::nanoseconds busy);
+
+    protected:
+        PipelineCore(const std::vector<FunctionId>& ids,
+                     const PipelineConfig& config, ModuleSystem& system);
+        // Calls stage(index, begin, end) for every stage and every batch of
+        // [0, count). The first exception thrown by a stage is rethrown
+        // once the batches already started are done.
+        void execute(size_t count,
+                     const std::function<void(size_t, size_t, size_t)>& stage);
+
+    public:
+        size_t stageCount() const {
+            return mIds.size();
+        }
+        const PipelineConfig& config() const {
+            return mConfig;
+        }
+        std::vector<StageStats> stats() const;
+        void resetStats();
+    };
+
+    // Chain of functions instantiated once and run over batches of items
+    // in place, see ModuleSystem::getPipeline.
+    template <typename T>
+    class Pipeline final : public PipelineCore {
+    private:
+        std::vector<std::shared_ptr<T>> mStages;
+
+    public:
+        using Item = typename T::ItemType;
+
+        Pipeline(std::vector<std::shared_ptr<T>> stages,
+                 const std::vector<FunctionId>& ids,
+                 const PipelineConfig& config, ModuleSystem& system)
+            : PipelineCore(ids, config, system),
+              mStages(std::move(stages)) {}
+        void run(Item* items, size_t count) {
+            execute(count, [&](size_t index, size_t begin, size_t end) {
+                mStages[index]->process(items + begin, end - begin);
+            });
+        }
+        void run(std::vector<Item>& items) {
+            run(items.data(), items.size());
+        }
+    };
+}  // namespace Bus
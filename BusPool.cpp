@@ -0,0 +1,194 @@
+#include "BusPool.hpp"
+#include "BusMetrics.hpp"
+#include "BusRegistry.hpp"
+#include "BusReporter.hpp"
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+namespace Bus {
+    static size_t alignUp(size_t size, size_t align) {
+        return (size + align - 1) / align * align;
+    }
+
+    FunctionPool::FunctionPool(const std::shared_ptr<ModuleLibrary>& library,
+                               ModuleInstance& instance,
+                               const FactoryEntry& entry,
+                               std::shared_ptr<ModuleMetrics> metrics,
+                               size_t chunkSlots)
+        : mLibrary(library), mInstance(instance), mEntry(entry),
+          mModuleMetrics(std::move(metrics)),
+          mMetrics(mModuleMetrics ? &mModuleMetrics->function(entry.name)
+                                  : nullptr),
+          mChunkSlots((std::max)(chunkSlots, size_t(1))),
+          mAlign((std::max)(entry.align, alignof(std::max_align_t))),
+          mObjectOffset(alignUp(controlSize, entry.align)),
+          mSlotSize(alignUp(mObjectOffset + entry.size, mAlign)), mRefs(1),
+          mBatchBytes(0), mBatches(0) {}
+
+    FunctionPool::~FunctionPool() {
+        for(auto chunk : mChunks)
+            ::operator delete(chunk, std::align_val_t(mAlign));
+    }
+
+    std::shared_ptr<FunctionPool>
+    FunctionPool::make(const std::shared_ptr<ModuleLibrary>& library,
+                       ModuleInstance& instance, const FactoryEntry& entry,
+                       std::shared_ptr<ModuleMetrics> metrics,
+                       size_t chunkSlots) {
+        return std::shared_ptr<FunctionPool>(
+            new FunctionPool(library, instance, entry, std::move(metrics),
+                             chunkSlots),
+            [](FunctionPool* pool) { pool->unref(); });
+    }
+
+    void FunctionPool::unref() {
+        if(mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    FunctionPool::Stripe&
+    FunctionPool::local(std::array<Stripe, stripeCount>& stripes) {
+        static std::atomic_uint32_t next{ 0 };
+        thread_local uint32_t index = next++ % stripeCount;
+        return stripes[index];
+    }
+
+    char* FunctionPool::allocateChunk(size_t slots) {
+        size_t size = slots * mSlotSize;
+        auto chunk = static_cast<char*>(
+            ::operator new(size, std::align_val_t(mAlign)));
+        std::lock_guard guard(mChunkMutex);
+        try {
+            mChunks.push_back(chunk);
+        } catch(...) {
+            ::operator delete(chunk, std::align_val_t(mAlign));
+            throw;
+        }
+        return chunk;
+    }
+
+    void* FunctionPool::acquire() {
+        Stripe& stripe = local(mStripes);
+        {
+            std::lock_guard guard(stripe.mutex);
+            ++stripe.created;
+            if(FreeSlot* slot = stripe.head) {
+                stripe.head = slot->next;
+                ++stripe.recycled;
+                return slot;
+            }
+        }
+        // Keep the first slot and hand the rest to this thread's list.
+        char* chunk = allocateChunk(mChunkSlots);
+        std::lock_guard guard(stripe.mutex);
+        for(size_t i = mChunkSlots - 1; i > 0; --i) {
+            auto slot = reinterpret_cast<FreeSlot*>(chunk + i * mSlotSize);
+            slot->next = stripe.head;
+            stripe.head = slot;
+        }
+        return chunk;
+    }
+
+    char* FunctionPool::allocateBatch(size_t count, Batch*& batch) {
+        size_t header = alignUp(sizeof(Batch), mAlign);
+        size_t size = header + count * mSlotSize;
+        batch = new(::operator new(size, std::align_val_t(mAlign)))
+            Batch{ { count }, size };
+        mBatchBytes += size;
+        ++mBatches;
+        Stripe& stripe = local(mStripes);
+        std::lock_guard guard(stripe.mutex);
+        stripe.created += count;
+        return reinterpret_cast<char*>(batch) + header;
+    }
+
+    void FunctionPool::recycle(void* slot, Batch* batch) {
+        if(batch) {
+            if(batch->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                mBatchBytes -= batch->size;
+                --mBatches;
+                batch->~Batch();
+                ::operator delete(batch, std::align_val_t(mAlign));
+            }
+            return;
+        }
+        Stripe& stripe = local(mStripes);
+        auto node = static_cast<FreeSlot*>(slot);
+        std::lock_guard guard(stripe.mutex);
+        node->next = stripe.head;
+        stripe.head = node;
+    }
+
+    void FunctionPool::release(void* slot, Batch* batch) {
+        recycle(slot, batch);
+        unref();
+    }
+
+    ModuleFunctionBase* FunctionPool::construct(void* slot, Batch* batch) {
+        using Clock = std::chrono::steady_clock;
+        mRefs.fetch_add(1, std::memory_order_relaxed);
+        auto beg = mMetrics ? Clock::now() : Clock::time_point{};
+        ModuleFunctionBase* object;
+        try {
+            object = mEntry.construct(static_cast<char*>(slot) + mObjectOffset,
+                                      mInstance);
+        } catch(...) {
+            release(slot, batch);
+            throw;
+        }
+        if(mMetrics)
+            mMetrics->recordCreate(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - beg)
+                    .count()));
+        return object;
+    }
+
+    void FunctionPool::destroy(ModuleFunctionBase* object) {
+        mEntry.destroy(object);
+        if(mMetrics)
+            mMetrics->recordRelease();
+    }
+
+    PoolStats FunctionPool::stats() {
+        PoolStats res{};
+        for(auto&& stripe : mStripes) {
+            std::lock_guard guard(stripe.mutex);
+            res.created += stripe.created;
+            res.recycled += stripe.recycled;
+        }
+        res.batches = mBatches;
+        res.bytes = mBatchBytes;
+        std::lock_guard guard(mChunkMutex);
+        res.chunks = mChunks.size();
+        res.bytes += res.chunks * mChunkSlots * mSlotSize;
+        return res;
+    }
+
+    std::shared_ptr<FunctionPool>
+    ModuleSystem::makePool(FunctionId id, Name interfaceName,
+                           uint64_t interfaceId, size_t chunkSlots) {
+        auto snapshot = mRegistry->snapshot();
+        auto module = snapshot->find(id.guid);
+        if(!module) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Pool"),
+                       "No module's GUID is ", id.guid, '.');
+            return nullptr;
+        }
+        auto instance = module->library->getInstance();
+        auto entry = instance ? findFactory(*module->library, interfaceName,
+                                            interfaceId, id.name)
+                              : nullptr;
+        if(!entry || !entry->construct) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Pool"),
+                       "Module ", id.guid, " [name=", module->name,
+                       "] doesn't export a factory of ", id.name,
+                       " that can be pooled.");
+            return nullptr;
+        }
+        return FunctionPool::make(
+            module->library, *instance, *entry,
+            mMetrics->enabled() ? module->metrics : nullptr, chunkSlots);
+    }
+}  // namespace Bus
@@ -0,0 +1,205 @@
+#pragma once
+#include "BusModule.hpp"
+#include "BusSystem.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace Bus {
+    class FunctionMetrics;
+    class ModuleMetrics;
+
+    struct PoolStats final {
+        uint64_t chunks;
+        uint64_t batches;
+        // Held by the chunks and the live batches.
+        uint64_t bytes;
+        uint64_t created;
+        uint64_t recycled;
+    };
+
+    // Recycles storage for the instances of one function. An instance and
+    // its shared_ptr control block share one slot, slots are carved from
+    // chunks and released slots go to a free list striped by thread. The
+    // chunks are only freed with the pool, which the instances keep alive.
+    // A batch gets a chunk of its own that is freed with its last instance.
+    // Only the instances keep the module loaded, the pool itself doesn't
+    // hold back a replaced version.
+    class FunctionPool final : private Unmoveable {
+    private:
+        static constexpr size_t stripeCount = 8;
+        static constexpr size_t controlSize = 80;
+        struct FreeSlot final {
+            FreeSlot* next;
+        };
+        struct alignas(64) Stripe final {
+            std::mutex mutex;
+            FreeSlot* head = nullptr;
+            uint64_t created = 0;
+            uint64_t recycled = 0;
+        };
+        struct Batch final {
+            std::atomic_size_t live;
+            size_t size;
+        };
+
+        template <typename T>
+        class SlotAllocator final {
+        public:
+            using value_type = T;
+            FunctionPool* pool;
+            void* slot;
+            Batch* batch;
+
+            SlotAllocator(FunctionPool* pool, void* slot, Batch* batch)
+                : pool(pool), slot(slot), batch(batch) {}
+            template <typename U>
+            SlotAllocator(const SlotAllocator<U>& rhs)
+                : pool(rhs.pool), slot(rhs.slot), batch(rhs.batch) {}
+            // Only the control block is allocated, into the head of the
+            // slot.
+            T* allocate(size_t) {
+                static_assert(sizeof(T) <= controlSize &&
+                                  alignof(T) <= alignof(std::max_align_t),
+                              "Control block doesn't fit in the slot");
+                return static_cast<T*>(slot);
+            }
+            void deallocate(T*, size_t) {
+                pool->release(slot, batch);
+            }
+            template <typename U>
+            bool operator==(const SlotAllocator<U>& rhs) const {
+                return slot == rhs.slot;
+            }
+            template <typename U>
+            bool operator!=(const SlotAllocator<U>& rhs) const {
+                return slot != rhs.slot;
+            }
+        };
+
+        // Drops the library once the object is gone.
+        struct Deleter final {
+            FunctionPool* pool;
+            std::shared_ptr<ModuleLibrary> library;
+            void operator()(ModuleFunctionBase* object) {
+                pool->destroy(object);
+                library.reset();
+            }
+        };
+
+        // The instance and the entry belong to the library, they are only
+        // used while a locked reference to it is held.
+        std::weak_ptr<ModuleLibrary> mLibrary;
+        ModuleInstance& mInstance;
+        const FactoryEntry& mEntry;
+        std::shared_ptr<ModuleMetrics> mModuleMetrics;
+        FunctionMetrics* mMetrics;
+        size_t mChunkSlots;
+        size_t mAlign;
+        size_t mObjectOffset;
+        size_t mSlotSize;
+        // One reference for the owning shared_ptr plus one per instance.
+        std::atomic_size_t mRefs;
+        std::array<Stripe, stripeCount> mStripes;
+        std::mutex mChunkMutex;
+        std::vector<void*> mChunks;
+        // Chunks are counted through mChunks, these are the live batches.
+        std::atomic_uint64_t mBatchBytes;
+        std::atomic_uint64_t mBatches;
+
+        FunctionPool(const std::shared_ptr<ModuleLibrary>& library,
+                     ModuleInstance& instance, const FactoryEntry& entry,
+                     std::shared_ptr<ModuleMetrics> metrics, size_t chunkSlots);
+        ~FunctionPool();
+        void unref();
+        static Stripe& local(std::array<Stripe, stripeCount>& stripes);
+        char* allocateChunk(size_t slots);
+        void* acquire();
+        char* allocateBatch(size_t count, Batch*& batch);
+        void recycle(void* slot, Batch* batch);
+        void release(void* slot, Batch* batch);
+        ModuleFunctionBase* construct(void* slot, Batch* batch);
+        void destroy(ModuleFunctionBase* object);
+        template <typename T>
+        std::shared_ptr<T> wrap(void* slot, Batch* batch,
+                                std::shared_ptr<ModuleLibrary> library) {
+            auto object = static_cast<T*>(construct(slot, batch));
+            return std::shared_ptr<T>(object,
+                                      Deleter{ this, std::move(library) },
+                                      SlotAllocator<T>(this, slot, batch));
+        }
+        // Null once the library is unloaded or replaced.
+        std::shared_ptr<ModuleLibrary> lock() const {
+            auto library = mLibrary.lock();
+            return library && !library->retired() ? library : nullptr;
+        }
+
+    public:
+        static std::shared_ptr<FunctionPool>
+        make(const std::shared_ptr<ModuleLibrary>& library,
+             ModuleInstance& instance, const FactoryEntry& entry,
+             std::shared_ptr<ModuleMetrics> metrics, size_t chunkSlots);
+        bool valid() const {
+            return lock() != nullptr;
+        }
+        template <typename T>
+        std::shared_ptr<T> create() {
+            auto library = lock();
+            if(!library)
+                return nullptr;
+            return wrap<T>(acquire(), nullptr, std::move(library));
+        }
+        // Builds count instances in one contiguous chunk.
+        template <typename T>
+        void create(size_t count, std::vector<std::shared_ptr<T>>& res) {
+            auto library = lock();
+            if(count == 0 || !library)
+                return;
+            res.reserve(res.size() + count);
+            Batch* batch = nullptr;
+            char* slots = allocateBatch(count, batch);
+            size_t i = 0;
+            try {
+                for(; i < count; ++i)
+                    res.emplace_back(
+                        wrap<T>(slots + i * mSlotSize, batch, library));
+            } catch(...) {
+                for(++i; i < count; ++i)
+                    recycle(slots + i * mSlotSize, batch);
+                throw;
+            }
+        }
+        PoolStats stats();
+    };
+
+    template <typename T>
+    class PooledHandle final {
+    private:
+        std::shared_ptr<FunctionPool> mPool;
+
+    public:
+        PooledHandle() = default;
+        explicit PooledHandle(std::shared_ptr<FunctionPool> pool)
+            : mPool(std::move(pool)) {}
+        bool valid() const {
+            return mPool && mPool->valid();
+        }
+        explicit operator bool() const {
+            return valid();
+        }
+        std::shared_ptr<T> create() const {
+            return mPool ? mPool->create<T>() : nullptr;
+        }
+        std::vector<std::shared_ptr<T>> create(size_t count) const {
+            std::vector<std::shared_ptr<T>> res;
+            if(mPool)
+                mPool->create<T>(count, res);
+            return res;
+        }
+        PoolStats stats() const {
+            return mPool ? mPool->stats() : PoolStats{};
+        }
+    };
+}  // namespace Bus
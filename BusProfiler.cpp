@@ -0,0 +1,273 @@
+#include "BusProfiler.hpp"
+#include "BusMetrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Bus {
+    namespace Detail {
+        std::atomic_bool profilerActive{ false };
+    }  // namespace Detail
+
+    struct ProfileEvent final {
+        const char* module;
+        const char* srcFile;
+        const char* functionName;
+        int line;
+        unsigned depth;
+        uint64_t beginNs;
+        uint64_t durationNs;
+        uint64_t exclusiveNs;
+    };
+
+    // Single producer (the owning thread), single consumer (collectProfile
+    // under the profiler lock).
+    struct ProfileBuffer final : private Unmoveable {
+        std::unique_ptr<ProfileEvent[]> events;
+        size_t mask;
+        uint64_t thread;
+        std::atomic_bool alive{ true };
+        alignas(64) std::atomic_size_t head{ 0 };
+        alignas(64) std::atomic_size_t tail{ 0 };
+        std::atomic_uint64_t dropped{ 0 };
+
+        ProfileBuffer(size_t capacity, uint64_t thread) : thread(thread) {
+            size_t size = 2;
+            while(size < capacity)
+                size <<= 1;
+            events = std::make_unique<ProfileEvent[]>(size);
+            mask = size - 1;
+        }
+    };
+
+    struct ScopeKey final {
+        const char* module;
+        const char* srcFile;
+        const char* functionName;
+        int line;
+        bool operator==(const ScopeKey& rhs) const {
+            return srcFile == rhs.srcFile && line == rhs.line &&
+                functionName == rhs.functionName && module == rhs.module;
+        }
+    };
+    struct ScopeKeyHash final {
+        size_t operator()(const ScopeKey& key) const {
+            return std::hash<const void*>{}(key.srcFile) * 31 +
+                static_cast<size_t>(key.line);
+        }
+    };
+    struct ScopeTotals final {
+        uint64_t calls = 0;
+        uint64_t inclusiveNs = 0;
+        uint64_t exclusiveNs = 0;
+    };
+    struct CollectedEvent final {
+        ProfileEvent event;
+        uint64_t thread;
+    };
+
+    class Profiler final : private Unmoveable {
+    public:
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point epoch = Clock::now();
+        std::mutex mutex;
+        size_t threadCapacity = 1 << 16;
+        std::vector<std::shared_ptr<ProfileBuffer>> buffers;
+        std::unordered_map<ScopeKey, ScopeTotals, ScopeKeyHash> totals;
+        // Spans kept for exportProfile, which clears them.
+        static constexpr size_t maxEvents = 1 << 20;
+        std::vector<CollectedEvent> events;
+        uint64_t dropped = 0;
+        // Collected spans point to copies of their strings, which outlive
+        // the modules that recorded them. Equal strings share one copy.
+        std::unordered_set<std::string> strings;
+        // Only valid while no module unloads, see Detail::profileUnload.
+        std::unordered_map<const char*, const char*> interned;
+
+        static Profiler& get() {
+            static Profiler profiler;
+            return profiler;
+        }
+        uint64_t now() const {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - epoch)
+                    .count());
+        }
+        const char* intern(const char* str) {
+            if(str == nullptr)
+                return "";
+            auto iter = interned.find(str);
+            if(iter != interned.end())
+                return iter->second;
+            const char* res = strings.emplace(str).first->c_str();
+            interned.emplace(str, res);
+            return res;
+        }
+        void collect() {
+            std::vector<std::shared_ptr<ProfileBuffer>> live;
+            for(auto&& buffer : buffers) {
+                // Rings of exited threads are released once drained.
+                if(buffer->alive)
+                    live.emplace_back(buffer);
+                size_t head = buffer->head.load(std::memory_order_acquire);
+                size_t tail = buffer->tail.load(std::memory_order_relaxed);
+                for(; tail != head; ++tail) {
+                    ProfileEvent event = buffer->events[tail & buffer->mask];
+                    event.module = intern(event.module);
+                    event.srcFile = intern(event.srcFile);
+                    event.functionName = intern(event.functionName);
+                    ScopeTotals& scope =
+                        totals[ScopeKey{ event.module, event.srcFile,
+                                         event.functionName, event.line }];
+                    ++scope.calls;
+                    scope.inclusiveNs += event.durationNs;
+                    scope.exclusiveNs += event.exclusiveNs;
+                    if(events.size() < maxEvents)
+                        events.push_back({ event, buffer->thread });
+                    else
+                        ++dropped;
+                }
+                buffer->tail.store(tail, std::memory_order_release);
+                dropped += buffer->dropped.exchange(0);
+            }
+            buffers.swap(live);
+        }
+    };
+
+    // Per-thread nesting state. Each level accumulates the time of its
+    // children, which yields the exclusive time when the level ends.
+    struct ThreadProfile final {
+        static constexpr unsigned maxDepth = 128;
+        std::shared_ptr<ProfileBuffer> buffer;
+        unsigned depth = 0;
+        uint64_t childNs[maxDepth + 1] = {};
+
+        ThreadProfile() {
+            Profiler& profiler = Profiler::get();
+            std::lock_guard guard(profiler.mutex);
+            buffer = std::make_shared<ProfileBuffer>(profiler.threadCapacity,
+                                                     threadHash());
+            profiler.buffers.emplace_back(buffer);
+        }
+        ~ThreadProfile() {
+            buffer->alive = false;
+        }
+    };
+    static ThreadProfile& threadProfile() {
+        thread_local ThreadProfile profile;
+        return profile;
+    }
+
+    uint64_t Detail::profileEnter() {
+        ThreadProfile& profile = threadProfile();
+        if(++profile.depth <= ThreadProfile::maxDepth)
+            profile.childNs[profile.depth] = 0;
+        return Profiler::get().now();
+    }
+    void Detail::profileLeave(const char* module, const char* srcFile,
+                              const char* functionName, int line,
+                              uint64_t beginNs) {
+        uint64_t duration = Profiler::get().now() - beginNs;
+        ThreadProfile& profile = threadProfile();
+        unsigned depth = profile.depth--;
+        uint64_t exclusive = duration;
+        if(depth <= ThreadProfile::maxDepth)
+            exclusive -= (std::min)(profile.childNs[depth], duration);
+        if(depth - 1 <= ThreadProfile::maxDepth)
+            profile.childNs[depth - 1] += duration;
+        ProfileBuffer& buffer = *profile.buffer;
+        size_t head = buffer.head.load(std::memory_order_relaxed);
+        if(head - buffer.tail.load(std::memory_order_acquire) > buffer.mask) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer.events[head & buffer.mask] = { module, srcFile, functionName,
+                                              line,   depth,   beginNs,
+                                              duration, exclusive };
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void enableProfiler(bool enable, size_t threadCapacity) {
+        Profiler& profiler = Profiler::get();
+        {
+            std::lock_guard guard(profiler.mutex);
+            profiler.threadCapacity = threadCapacity;
+        }
+        Detail::profilerActive.store(enable);
+    }
+    void Detail::profileUnload() {
+        Profiler& profiler = Profiler::get();
+        std::lock_guard guard(profiler.mutex);
+        profiler.collect();
+        // The image's addresses may be reused by the next module.
+        profiler.interned.clear();
+    }
+    void collectProfile() {
+        Profiler& profiler = Profiler::get();
+        std::lock_guard guard(profiler.mutex);
+        profiler.collect();
+    }
+    std::vector<ScopeStats> profileStats() {
+        Profiler& profiler = Profiler::get();
+        std::lock_guard guard(profiler.mutex);
+        profiler.collect();
+        // Scopes are keyed by interned strings, sort them by content.
+        using Key = std::tuple<std::string, int, std::string, std::string>;
+        std::map<Key, ScopeTotals> merged;
+        for(auto&& [key, totals] : profiler.totals) {
+            ScopeTotals& res = merged[Key{ key.srcFile, key.line,
+                                          key.functionName, key.module }];
+            res.calls += totals.calls;
+            res.inclusiveNs += totals.inclusiveNs;
+            res.exclusiveNs += totals.exclusiveNs;
+        }
+        std::vector<ScopeStats> res;
+        for(auto&& [key, totals] : merged)
+            res.push_back({ std::get<3>(key), std::get<2>(key),
+                            std::get<0>(key), std::get<1>(key), totals.calls,
+                            totals.inclusiveNs, totals.exclusiveNs });
+        return res;
+    }
+    void exportProfile(std::ostream& out) {
+        Profiler& profiler = Profiler::get();
+        std::lock_guard guard(profiler.mutex);
+        profiler.collect();
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for(auto&& [event, thread] : profiler.events) {
+            out << (first ? "{" : ",{") << "\"name\":";
+            writeJSONString(out, event.functionName);
+            out << ",\"cat\":";
+            writeJSONString(out, event.module);
+            out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread % 1000000007ULL
+                << ",\"ts\":";
+            writeMicroseconds(out, event.beginNs);
+            out << ",\"dur\":";
+            writeMicroseconds(out, event.durationNs);
+            out << ",\"args\":{\"file\":";
+            writeJSONString(out, event.srcFile);
+            out << ",\"line\":" << event.line << ",\"depth\":" << event.depth
+                << "}}";
+            first = false;
+        }
+        out << "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":"
+            << profiler.dropped << "}}";
+        profiler.events.clear();
+    }
+    void resetProfile() {
+        Profiler& profiler = Profiler::get();
+        std::lock_guard guard(profiler.mutex);
+        profiler.collect();
+        profiler.totals.clear();
+        profiler.events.clear();
+        profiler.dropped = 0;
+        profiler.interned.clear();
+        profiler.strings.clear();
+    }
+}  // namespace Bus
@@ -0,0 +1,64 @@
+#pragma once
+#include "BusCommon.hpp"
+#include <atomic>
+#include <iosfwd>
+
+namespace Bus {
+    struct ScopeStats final {
+        std::string module;
+        std::string function;
+        std::string srcFile;
+        int line;
+        uint64_t calls;
+        uint64_t inclusiveNs;
+        uint64_t exclusiveNs;
+    };
+
+    // Spans are only recorded by code built with BUS_ENABLE_PROFILER, and
+    // only while the profiler is enabled. Every thread writes to its own
+    // ring of threadCapacity spans, spans that don't fit are dropped.
+    void enableProfiler(bool enable, size_t threadCapacity = 1 << 16);
+    // Moves the recorded spans out of the thread rings. Call it
+    // periodically when the rings are small.
+    void collectProfile();
+    // Per-scope counts and times of every span collected so far.
+    std::vector<ScopeStats> profileStats();
+    // Writes the spans collected since the last export as Chrome trace
+    // JSON.
+    void exportProfile(std::ostream& out);
+    void resetProfile();
+
+    namespace Detail {
+        extern std::atomic_bool profilerActive;
+        uint64_t profileEnter();
+        void profileLeave(const char* module, const char* srcFile,
+                          const char* functionName, int line,
+                          uint64_t beginNs);
+        // Collects the spans before a module unloads, their strings point
+        // into its image.
+        void profileUnload();
+    }  // namespace Detail
+
+    class ProfileScope final : private Unmoveable {
+    private:
+        const char* mModule;
+        const char* mSrcFile;
+        const char* mFunctionName;
+        int mLine;
+        bool mActive;
+        uint64_t mBeginNs;
+
+    public:
+        ProfileScope(const char* module, const char* srcFile,
+                     const char* functionName, int line)
+            : mModule(module), mSrcFile(srcFile),
+              mFunctionName(functionName), mLine(line),
+              mActive(Detail::profilerActive.load(std::memory_order_relaxed)),
+              mBeginNs(mActive ? Detail::profileEnter() : 0) {}
+        ~ProfileScope() {
+            if(mActive)
+                Detail::profileLeave(mModule, mSrcFile, mFunctionName, mLine,
+                                     mBeginNs);
+        }
+    };
+}  // namespace Bus
@@ -0,0 +1,82 @@
+#pragma once
+#include "BusCommon.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace Bus {
+    // Current version of a value, read without locks. A reader marks itself
+    // in a per-thread counter of the current epoch and then reads or copies
+    // the value. A writer swaps in the new version, moves to the next epoch
+    // and waits for the readers of the previous one before dropping the old
+    // version. Writers must be serialized by the caller. Use a const T
+    // unless readers synchronize their own access to the value.
+    template <typename T>
+    class Published final : private Unmoveable {
+    private:
+        using Pointer = std::shared_ptr<T>;
+        static constexpr size_t stripes = 16;
+        struct alignas(64) Counter final {
+            std::atomic_size_t readers{ 0 };
+        };
+
+        std::atomic<const Pointer*> mCurrent;
+        std::atomic_uint64_t mEpoch{ 0 };
+        mutable Counter mCounters[2][stripes];
+
+        static size_t stripe() {
+            static std::atomic_size_t next{ 0 };
+            thread_local size_t res = next++ % stripes;
+            return res;
+        }
+
+        class Guard final : private Unmoveable {
+        private:
+            std::atomic_size_t* mCounter;
+
+        public:
+            explicit Guard(const Published& cell) {
+                size_t index = stripe();
+                while(true) {
+                    uint64_t epoch = cell.mEpoch.load();
+                    mCounter = &cell.mCounters[epoch & 1][index].readers;
+                    mCounter->fetch_add(1);
+                    // A writer may have waited for this epoch already.
+                    if(cell.mEpoch.load() == epoch)
+                        break;
+                    mCounter->fetch_sub(1);
+                }
+            }
+            ~Guard() {
+                mCounter->fetch_sub(1);
+            }
+        };
+
+    public:
+        explicit Published(Pointer value)
+            : mCurrent(new Pointer(std::move(value))) {}
+        ~Published() {
+            delete mCurrent.load();
+        }
+        Pointer load() const {
+            Guard guard(*this);
+            return *mCurrent.load();
+        }
+        // Runs func on the current value, which may be null, without
+        // copying the shared_ptr. The value may be replaced once func
+        // returns.
+        template <typename Func>
+        auto read(Func&& func) const {
+            Guard guard(*this);
+            return func(mCurrent.load()->get());
+        }
+        void store(Pointer value) {
+            std::unique_ptr<const Pointer> old(
+                mCurrent.exchange(new Pointer(std::move(value))));
+            uint64_t epoch = mEpoch.fetch_add(1);
+            for(auto&& counter : mCounters[epoch & 1])
+                while(counter.readers.load() != 0)
+                    std::this_thread::yield();
+        }
+    };
+}  // namespace Bus
@@ -0,0 +1,242 @@
+#include "BusRegistry.hpp"
+#include "BusMetrics.hpp"
+#include "BusModule.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace Bus {
+    static size_t hashCombine(size_t seed, size_t val) {
+        return seed ^ (val + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+    size_t NamePairHash::operator()(const NamePair& pair) const {
+        std::hash<Name> hasher;
+        return hashCombine(hasher(pair.first), hasher(pair.second));
+    }
+    size_t GUIDNameHash::operator()(const GUIDName& key) const {
+        return hashCombine(GUIDHash{}(key.guid), std::hash<Name>{}(key.name));
+    }
+
+    static void insert(IndexEntry& entry, GUID guid, Name name) {
+        if(entry.count++ == 0)
+            entry.guid = guid, entry.name = name;
+    }
+
+    const ModuleEntry* RegistrySnapshot::find(GUID guid) const {
+        auto iter = modules.find(guid);
+        return iter == modules.cend() ? nullptr : &iter->second;
+    }
+    const InterfaceIndex* RegistrySnapshot::find(Name interfaceName) const {
+        auto iter = interfaces.find(interfaceName);
+        return iter == interfaces.cend() ? nullptr : iter->second.get();
+    }
+
+    static void merge(IndexEntry& entry, const IndexEntry& rhs) {
+        if(entry.count == 0)
+            entry.guid = rhs.guid, entry.name = rhs.name;
+        entry.count += rhs.count;
+    }
+    // Functions are listed by module GUID, each module's in its own order.
+    static bool guidOrder(const FunctionId& lhs, const FunctionId& rhs) {
+        return lhs.guid < rhs.guid;
+    }
+    static std::vector<FunctionId> mergeFunctions(const IndexLevel& lhs,
+                                                  const IndexLevel& rhs) {
+        std::vector<FunctionId> res;
+        res.reserve(lhs.functions.size() + rhs.functions.size());
+        std::merge(lhs.functions.cbegin(), lhs.functions.cend(),
+                   rhs.functions.cbegin(), rhs.functions.cend(),
+                   std::back_inserter(res), guidOrder);
+        return res;
+    }
+    void IndexLevel::sort() {
+        std::stable_sort(functions.begin(), functions.end(), guidOrder);
+    }
+    void IndexLevel::merge(const IndexLevel& level) {
+        functions = mergeFunctions(*this, level);
+        for(auto&& entry : level.byName)
+            Bus::merge(byName[entry.first], entry.second);
+        for(auto&& entry : level.byModule)
+            Bus::merge(byModule[entry.first], entry.second);
+        byGUID.insert(level.byGUID.cbegin(), level.byGUID.cend());
+    }
+
+    std::vector<FunctionId> InterfaceIndex::functions() const {
+        return recent ? mergeFunctions(*base, *recent) : base->functions;
+    }
+    template <typename Map, typename Key>
+    static IndexEntry find(const Map& base, const Map* recent,
+                           const Key& key) {
+        IndexEntry res{ GUID(0, 0), Name{}, 0 };
+        auto iter = base.find(key);
+        if(iter != base.cend())
+            res = iter->second;
+        if(recent) {
+            iter = recent->find(key);
+            if(iter != recent->cend())
+                merge(res, iter->second);
+        }
+        return res;
+    }
+    IndexEntry InterfaceIndex::findName(Name name) const {
+        return find(base->byName, recent ? &recent->byName : nullptr, name);
+    }
+    IndexEntry InterfaceIndex::findModule(const NamePair& key) const {
+        return find(base->byModule, recent ? &recent->byModule : nullptr,
+                    key);
+    }
+    const Name* InterfaceIndex::findFunction(const GUIDName& key) const {
+        for(auto level : { base.get(), recent.get() })
+            if(level) {
+                auto iter = level->byGUID.find(key);
+                if(iter != level->byGUID.cend())
+                    return &iter->second;
+            }
+        return nullptr;
+    }
+
+    void ModuleRegistry::index(IndexLevel& level, Name interfaceName,
+                               GUID guid, const ModuleEntry& module) {
+        auto storage = module.library->nameStorage();
+        for(auto func : module.library->list(interfaceName)) {
+            Name name = mPool.intern(func, storage);
+            if(!level.byGUID.emplace(GUIDName{ guid, name }, name).second)
+                continue;
+            level.functions.emplace_back(guid, name);
+            insert(level.byName[name], guid, name);
+            insert(level.byModule[NamePair{ module.name, name }], guid, name);
+        }
+    }
+
+    ModuleRegistry::ModuleRegistry()
+        : mSnapshot(std::make_shared<const RegistrySnapshot>()) {}
+
+    Snapshot ModuleRegistry::snapshot() const {
+        return mSnapshot.load();
+    }
+
+    void ModuleRegistry::publish(Snapshot snapshot) {
+        mSnapshot.store(std::move(snapshot));
+    }
+
+    size_t ModuleRegistry::add(
+        const std::vector<std::shared_ptr<ModuleLibrary>>& libraries,
+        SystemMetrics& metrics) {
+        std::vector<std::pair<ModuleInfo, LoadStats>> infos;
+        infos.reserve(libraries.size());
+        for(auto&& library : libraries)
+            infos.emplace_back(library->info(), library->loadStats());
+        std::lock_guard guard(mMutex);
+        auto old = snapshot();
+        auto res = std::make_shared<RegistrySnapshot>(*old);
+        std::vector<std::pair<GUID, const ModuleEntry*>> added;
+        for(size_t i = 0; i < libraries.size(); ++i) {
+            auto&& [info, stats] = infos[i];
+            GUID guid = info.guid;
+            if(res->find(guid))
+                continue;
+            Name name = mPool.intern(info.name, libraries[i]->nameStorage());
+            auto iter =
+                res->modules
+                    .emplace(guid, ModuleEntry{ name, libraries[i],
+                                                metrics.addModule(
+                                                    guid, name, stats.loadNs,
+                                                    stats.initNs) })
+                    .first;
+            added.emplace_back(guid, &iter->second);
+        }
+        if(added.empty())
+            return 0;
+        for(auto&& inter : res->interfaces) {
+            auto& index = *inter.second;
+            auto recent = index.recent ? std::make_shared<IndexLevel>(
+                                             *index.recent) :
+                                         std::make_shared<IndexLevel>();
+            size_t size = recent->functions.size();
+            for(auto&& [guid, module] : added)
+                this->index(*recent, inter.first, guid, *module);
+            if(recent->functions.size() == size)
+                continue;
+            recent->sort();
+            InterfaceIndex updated{ index.base, std::move(recent) };
+            // Copying recent on every load and base on every merge cost
+            // about the same at this size.
+            size = updated.recent->functions.size();
+            if(size * size >= 16 * updated.base->functions.size()) {
+                auto base = std::make_shared<IndexLevel>(*updated.base);
+                base->merge(*updated.recent);
+                updated = InterfaceIndex{ std::move(base), nullptr };
+            }
+            inter.second =
+                std::make_shared<const InterfaceIndex>(std::move(updated));
+        }
+        publish(std::move(res));
+        return added.size();
+    }
+
+    std::shared_ptr<ModuleLibrary>
+    ModuleRegistry::replace(GUID guid, std::shared_ptr<ModuleLibrary> library,
+                            SystemMetrics& metrics) {
+        auto stats = library->loadStats();
+        ModuleInfo info = library->info();
+        std::lock_guard guard(mMutex);
+        auto old = snapshot();
+        auto module = old->find(guid);
+        if(!module)
+            return nullptr;
+        auto prev = module->library;
+        metrics.removeModule(*module->metrics);
+        auto res = std::make_shared<RegistrySnapshot>(*old);
+        Name name = mPool.intern(info.name, library->nameStorage());
+        res->modules[guid] =
+            ModuleEntry{ name, std::move(library),
+                         metrics.addModule(guid, name, stats.loadNs,
+                                           stats.initNs) };
+        // The new version may export different functions.
+        res->interfaces.clear();
+        mRetired.push_back(RetiredModule{ guid, module->name, prev, 0 });
+        publish(std::move(res));
+        return prev;
+    }
+
+    std::vector<RetiredModule> ModuleRegistry::retired() {
+        std::lock_guard guard(mMutex);
+        std::vector<RetiredModule> res;
+        for(auto&& module : mRetired) {
+            module.references = module.library.use_count();
+            res.push_back(module);
+        }
+        mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(),
+                                      [](const RetiredModule& module) {
+                                          return module.references == 0;
+                                      }),
+                       mRetired.end());
+        return res;
+    }
+
+    const InterfaceIndex& ModuleRegistry::get(Snapshot& snapshot,
+                                              Name interfaceName) {
+        if(auto res = snapshot->find(interfaceName))
+            return *res;
+        std::lock_guard guard(mMutex);
+        snapshot = this->snapshot();
+        if(auto res = snapshot->find(interfaceName))
+            return *res;
+        Name key = mPool.intern(interfaceName);
+        auto base = std::make_shared<IndexLevel>();
+        for(auto&& module : snapshot->modules)
+            this->index(*base, key, module.first, module.second);
+        base->sort();
+        auto index = std::make_shared<const InterfaceIndex>(
+            InterfaceIndex{ std::move(base), nullptr });
+        auto res = std::make_shared<RegistrySnapshot>(*snapshot);
+        res->interfaces.emplace(key, index);
+        snapshot = res;
+        publish(std::move(res));
+        return *index;
+    }
+
+    Name ModuleRegistry::intern(Name name) {
+        std::lock_guard guard(mMutex);
+        return mPool.intern(name);
+    }
+}  // namespace Bus
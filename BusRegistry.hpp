@@ -0,0 +1,112 @@
+#pragma once
+#include "BusNamePool.hpp"
+#include "BusPublished.hpp"
+#include "BusSystem.hpp"
+#include <mutex>
+#include <unordered_map>
+
+namespace Bus {
+    class ModuleMetrics;
+
+    struct NamePair final {
+        Name first;
+        Name second;
+        bool operator==(const NamePair& rhs) const {
+            return first == rhs.first && second == rhs.second;
+        }
+    };
+    struct NamePairHash final {
+        size_t operator()(const NamePair& pair) const;
+    };
+    struct GUIDName final {
+        GUID guid;
+        Name name;
+        bool operator==(const GUIDName& rhs) const {
+            return guid == rhs.guid && name == rhs.name;
+        }
+    };
+    struct GUIDNameHash final {
+        size_t operator()(const GUIDName& key) const;
+    };
+
+    struct IndexEntry final {
+        GUID guid;
+        Name name;
+        unsigned count;
+    };
+
+    struct IndexLevel final {
+        std::vector<FunctionId> functions;
+        std::unordered_map<Name, IndexEntry> byName;
+        std::unordered_map<NamePair, IndexEntry, NamePairHash> byModule;
+        std::unordered_map<GUIDName, Name, GUIDNameHash> byGUID;
+        void sort();
+        void merge(const IndexLevel& level);
+    };
+
+    // Functions of modules loaded after base was built go to the small
+    // recent level, so a load only copies that one. It is merged into base
+    // once it holds about 4 * sqrt(base) functions. Lookups return
+    // count == 0 for missing entries.
+    struct InterfaceIndex final {
+        std::shared_ptr<const IndexLevel> base;
+        std::shared_ptr<const IndexLevel> recent;
+        std::vector<FunctionId> functions() const;
+        IndexEntry findName(Name name) const;
+        IndexEntry findModule(const NamePair& key) const;
+        const Name* findFunction(const GUIDName& key) const;
+    };
+
+    struct ModuleEntry final {
+        Name name;
+        std::shared_ptr<ModuleLibrary> library;
+        std::shared_ptr<ModuleMetrics> metrics;
+    };
+
+    struct RegistrySnapshot final {
+        std::unordered_map<GUID, ModuleEntry, GUIDHash> modules;
+        // Built on first lookup.
+        std::unordered_map<Name, std::shared_ptr<const InterfaceIndex>>
+            interfaces;
+        const ModuleEntry* find(GUID guid) const;
+        const InterfaceIndex* find(Name interfaceName) const;
+    };
+
+    using Snapshot = std::shared_ptr<const RegistrySnapshot>;
+
+    struct RetiredModule final {
+        GUID guid;
+        Name name;
+        std::weak_ptr<ModuleLibrary> library;
+        long references;
+    };
+
+    // Readers work on an immutable snapshot obtained without locking;
+    // writers serialize on mMutex and publish a modified copy.
+    class ModuleRegistry final : private Unmoveable {
+    private:
+        std::mutex mMutex;
+        NamePool mPool;
+        Published<const RegistrySnapshot> mSnapshot;
+        std::vector<RetiredModule> mRetired;
+        void index(IndexLevel& level, Name interfaceName, GUID guid,
+                   const ModuleEntry& module);
+        void publish(Snapshot snapshot);
+
+    public:
+        ModuleRegistry();
+        Snapshot snapshot() const;
+        // Registers the libraries with one published snapshot and returns
+        // how many were new. Libraries whose GUID is taken are skipped.
+        size_t add(const std::vector<std::shared_ptr<ModuleLibrary>>& libraries,
+                   SystemMetrics& metrics);
+        // Returns the previous library, or nullptr if guid isn't registered.
+        std::shared_ptr<ModuleLibrary>
+        replace(GUID guid, std::shared_ptr<ModuleLibrary> library,
+                SystemMetrics& metrics);
+        // Lists replaced libraries, forgetting those already unloaded.
+        std::vector<RetiredModule> retired();
+        const InterfaceIndex& get(Snapshot& snapshot, Name interfaceName);
+        Name intern(Name name);
+    };
+}  // namespace Bus
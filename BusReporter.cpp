@@ -1,17 +1,232 @@
 #include "BusReporter.hpp"
+#include "BusRingBuffer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
 
 namespace Bus {
+    struct ReportRecord final {
+        ReportLevel level;
+        std::string message;
+        // Builds message on the drain thread when set.
+        ReportFormatter format;
+        SourceLocation loc;
+        ReportRecord()
+            : level(ReportLevel::Info), loc(nullptr, nullptr, nullptr, 0) {}
+        ReportRecord(ReportLevel level, const std::string& message,
+                     const SourceLocation& loc)
+            : level(level), message(message), loc(loc) {}
+        ReportRecord(ReportLevel level, ReportFormatter format,
+                     const SourceLocation& loc)
+            : level(level), format(std::move(format)), loc(loc) {}
+    };
+
+    // The dispatcher the current thread drains, if any.
+    static thread_local const AsyncDispatcher* drainedDispatcher = nullptr;
+
+    class AsyncDispatcher final : private Unmoveable {
+    private:
+        static constexpr size_t idle = ~size_t(0);
+        // Lower bound of the position a drain thread is dispatching.
+        struct alignas(64) Busy final {
+            std::atomic_size_t pos{ idle };
+        };
+
+        Reporter& mReporter;
+        OverflowPolicy mPolicy;
+        RingBuffer<ReportRecord> mQueue;
+        std::unique_ptr<Busy[]> mBusy;
+        std::vector<std::thread> mWorkers;
+        std::atomic_bool mRunning;
+        // Eventcount: sleepers announce themselves before the last check of
+        // the queue, producers bump mWakeups under the mutex.
+        std::atomic_uint32_t mSleepers;
+        uint64_t mWakeups;
+        std::mutex mWaitMutex;
+        std::condition_variable mWait;
+        std::atomic_uint32_t mFlushers;
+        std::mutex mFlushMutex;
+        std::condition_variable mFlushed;
+        std::atomic_uint64_t mDone, mDropped, mOverwritten;
+
+        void wake() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(mSleepers.load(std::memory_order_relaxed)) {
+                std::lock_guard guard(mWaitMutex);
+                ++mWakeups;
+                mWait.notify_one();
+            }
+        }
+        void progress() {
+            if(mFlushers.load()) {
+                std::lock_guard guard(mFlushMutex);
+                mFlushed.notify_all();
+            }
+        }
+        void sleep() {
+            std::unique_lock lock(mWaitMutex);
+            mSleepers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint64_t wakeups = mWakeups;
+            if(mQueue.size() == 0 && mRunning.load())
+                mWait.wait(lock, [&] { return mWakeups != wakeups; });
+            mSleepers.fetch_sub(1);
+        }
+        void run(Busy& busy) {
+            drainedDispatcher = this;
+            ReportRecord record;
+            while(true) {
+                // Published before the pop, so flush can't miss the record.
+                busy.pos.store(mQueue.popped());
+                if(mQueue.tryPop(record)) {
+                    if(record.format)
+                        record.message = record.format();
+                    mReporter.dispatch(record.level, record.message,
+                                       record.loc);
+                    mDone.fetch_add(1, std::memory_order_relaxed);
+                    busy.pos.store(idle);
+                    progress();
+                    continue;
+                }
+                busy.pos.store(idle);
+                progress();
+                if(!mRunning.load())
+                    return;
+                sleep();
+            }
+        }
+        // Every record below target was popped and no thread still
+        // dispatches one of them.
+        bool handled(size_t target) const {
+            if(mQueue.popped() < target)
+                return false;
+            for(size_t i = 0; i < mWorkers.size(); ++i)
+                if(mBusy[i].pos.load() < target)
+                    return false;
+            return true;
+        }
+
+    public:
+        AsyncDispatcher(Reporter& reporter, size_t capacity,
+                        OverflowPolicy policy, unsigned threads)
+            : mReporter(reporter), mPolicy(policy), mQueue(capacity),
+              mBusy(std::make_unique<Busy[]>((std::max)(threads, 1U))),
+              mRunning(true), mSleepers(0), mWakeups(0), mFlushers(0),
+              mDone(0), mDropped(0), mOverwritten(0) {
+            for(unsigned i = 0; i < (std::max)(threads, 1U); ++i)
+                mWorkers.emplace_back(&AsyncDispatcher::run, this,
+                                      std::ref(mBusy[i]));
+        }
+        ~AsyncDispatcher() {
+            mRunning.store(false);
+            {
+                std::lock_guard guard(mWaitMutex);
+                ++mWakeups;
+                mWait.notify_all();
+            }
+            for(auto&& worker : mWorkers)
+                worker.join();
+        }
+        // An action that reports would otherwise wait on its own queue.
+        bool draining() const {
+            return drainedDispatcher == this;
+        }
+        void push(ReportRecord record) {
+            while(!mQueue.tryPush(std::move(record))) {
+                if(mPolicy == OverflowPolicy::Drop) {
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                if(mPolicy == OverflowPolicy::DropOldest) {
+                    ReportRecord oldest;
+                    if(mQueue.tryPop(oldest)) {
+                        mOverwritten.fetch_add(1, std::memory_order_relaxed);
+                        mDone.fetch_add(1, std::memory_order_relaxed);
+                        progress();
+                    }
+                } else {
+                    wake();
+                    std::this_thread::yield();
+                }
+            }
+            wake();
+        }
+        void flush() {
+            size_t target = mQueue.pushed();
+            mFlushers.fetch_add(1);
+            wake();
+            {
+                std::unique_lock lock(mFlushMutex);
+                mFlushed.wait(lock, [&] { return handled(target); });
+            }
+            mFlushers.fetch_sub(1);
+        }
+        ReporterStats stats() const {
+            uint64_t overwritten = mOverwritten.load(std::memory_order_relaxed);
+            return { mDone.load(std::memory_order_relaxed) - overwritten,
+                     mDropped.load(std::memory_order_relaxed), overwritten };
+        }
+    };
+
+    Reporter::Reporter()
+        : mActions(std::make_shared<const Actions>()), mLevelMask(0) {}
+    Reporter::~Reporter() {
+        disableAsync();
+    }
     void Reporter::addAction(ReportLevel level,
                              const ReportFunction& function) {
-        mActions[level].emplace_back(function);
+        std::lock_guard guard(mMutex);
+        auto actions = std::make_shared<Actions>(*mActions.load());
+        (*actions)[static_cast<size_t>(level)].emplace_back(function);
+        mActions.store(std::move(actions));
+        mLevelMask.fetch_or(1U << static_cast<unsigned>(level),
+                            std::memory_order_relaxed);
+    }
+    void Reporter::dispatch(ReportLevel level, const std::string& message,
+                            const SourceLocation& loc) {
+        // A copy, so that an action may add another one.
+        auto actions = mActions.load();
+        for(const ReportFunction& func :
+            (*actions)[static_cast<size_t>(level)])
+            func(level, message, loc);
     }
     void Reporter::apply(ReportLevel level, const std::string& message,
                          const SourceLocation& loc) {
-        std::lock_guard guard(mMutex);
-        auto iter = mActions.find(level);
-        if(iter == mActions.cend())
+        if(!enabled(level))
             return;
-        for(const ReportFunction& func : iter->second)
-            func(level, message, loc);
+        if(mAsync && !mAsync->draining())
+            mAsync->push(ReportRecord(level, message, loc));
+        else
+            dispatch(level, message, loc);
+    }
+    bool Reporter::deferring() const {
+        return mAsync && !mAsync->draining();
+    }
+    void Reporter::applyDeferred(ReportLevel level, ReportFormatter format,
+                                 const SourceLocation& loc) {
+        mAsync->push(ReportRecord(level, std::move(format), loc));
+    }
+    void Reporter::enableAsync(size_t capacity, OverflowPolicy policy,
+                               unsigned threads) {
+        disableAsync();
+        mAsync =
+            std::make_unique<AsyncDispatcher>(*this, capacity, policy, threads);
+    }
+    void Reporter::disableAsync() {
+        if(mAsync) {
+            mAsync->flush();
+            mAsync.reset();
+        }
+    }
+    void Reporter::flush() {
+        if(mAsync)
+            mAsync->flush();
+    }
+    ReporterStats Reporter::stats() const {
+        if(mAsync)
+            return mAsync->stats();
+        return {};
     }
 }  // namespace Bus
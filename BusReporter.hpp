@@ -1,13 +1,34 @@
 #pragma once
 #include "BusCommon.hpp"
+#include "BusPublished.hpp"
+#include <array>
+#include <atomic>
 #include <exception>
 #include <functional>
-#include <map>
+#include <memory>
 #include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#ifdef BUS_ENABLE_PROFILER
+#include "BusProfiler.hpp"
+#endif
 
 namespace Bus {
     enum class ReportLevel { Warning, Debug, Error, Info };
+    constexpr int reportSeverity(ReportLevel level) {
+        switch(level) {
+            case ReportLevel::Debug:
+                return 0;
+            case ReportLevel::Info:
+                return 1;
+            case ReportLevel::Warning:
+                return 2;
+            default:
+                return 3;
+        }
+    }
     struct SourceLocation {
         const char* module;
         const char* srcFile;
@@ -23,20 +44,160 @@ namespace Bus {
     Bus::SourceLocation(MODULE, __FILE__, __FUNCTION__, __LINE__)
     using ReportFunction = std::function<void(ReportLevel, const std::string&,
                                               const SourceLocation& srcLoc)>;
+    // Builds the message of a report whose formatting was deferred.
+    using ReportFormatter = std::function<std::string()>;
+
+    enum class OverflowPolicy { Block, Drop, DropOldest };
+
+    struct ReporterStats final {
+        uint64_t processed;
+        uint64_t dropped;
+        uint64_t overwritten;
+    };
+
+    class AsyncDispatcher;
+
+    namespace Detail {
+        inline void appendReport(std::string& str, const std::string& val) {
+            str += val;
+        }
+        inline void appendReport(std::string& str, std::string_view val) {
+            str += val;
+        }
+        inline void appendReport(std::string& str, const char* val) {
+            str += val ? val : "(null)";
+        }
+        inline void appendReport(std::string& str, char val) {
+            str += val;
+        }
+        inline void appendReport(std::string& str, const fs::path& val) {
+            str += val.string();
+        }
+        inline void appendReport(std::string& str, GUID val) {
+            str += GUID2Str(val);
+        }
+        template <typename T>
+        std::enable_if_t<std::is_arithmetic_v<T>> appendReport(std::string& str,
+                                                                T val) {
+            str += std::to_string(val);
+        }
+        // An owned copy of a report argument that outlives the caller.
+        template <typename T>
+        auto captureReport(T&& val) {
+            using Type = std::decay_t<T>;
+            if constexpr(std::is_array_v<std::remove_reference_t<T>>)
+                return std::string(val);
+            else if constexpr(std::is_same_v<Type, const char*> ||
+                         std::is_same_v<Type, char*>)
+                return std::string(val ? val : "(null)");
+            else if constexpr(std::is_same_v<Type, std::string_view>)
+                return std::string(val);
+            else
+                return Type(std::forward<T>(val));
+        }
+    }  // namespace Detail
+
+    template <typename... Args>
+    std::string formatReport(const Args&... args) {
+        std::string res;
+        (Detail::appendReport(res, args), ...);
+        return res;
+    }
 
     class Reporter final : private Unmoveable {
     private:
-        std::map<ReportLevel, std::vector<ReportFunction>> mActions;
+        // Indexed by ReportLevel. Dispatch reads it without locking, so
+        // actions run concurrently when several threads report.
+        using Actions = std::array<std::vector<ReportFunction>, 4>;
+        Published<const Actions> mActions;
         std::mutex mMutex;
+        std::atomic_uint32_t mLevelMask;
+        std::unique_ptr<AsyncDispatcher> mAsync;
+        friend class AsyncDispatcher;
+        void dispatch(ReportLevel level, const std::string& message,
+                      const SourceLocation& loc);
+        bool deferring() const;
+        void applyDeferred(ReportLevel level, ReportFormatter format,
+                           const SourceLocation& loc);
 
     public:
+        Reporter();
+        ~Reporter();
         void addAction(ReportLevel level, const ReportFunction& function);
+        bool enabled(ReportLevel level) const {
+            return mLevelMask.load(std::memory_order_relaxed) &
+                (1U << static_cast<unsigned>(level));
+        }
         void apply(ReportLevel level, const std::string& message,
                    const SourceLocation& loc);
+        // When asynchronous, the arguments are copied and formatted by the
+        // drain thread that dispatches the report.
+        template <typename... Args>
+        void report(ReportLevel level, const SourceLocation& loc,
+                    Args&&... args) {
+            if(!enabled(level))
+                return;
+            if(!deferring()) {
+                apply(level, formatReport(args...), loc);
+                return;
+            }
+            applyDeferred(
+                level,
+                [values = std::make_tuple(Detail::captureReport(
+                     std::forward<Args>(args))...)] {
+                    return std::apply(
+                        [](const auto&... vals) {
+                            return formatReport(vals...);
+                        },
+                        values);
+                },
+                loc);
+        }
+        // Not thread-safe with respect to apply; configure before use.
+        // Actions run on the drain threads, concurrently if there are
+        // several. Reports issued by an action are dispatched right away
+        // instead of being queued behind the one that triggered them.
+        void enableAsync(size_t capacity, OverflowPolicy policy,
+                         unsigned threads = 1);
+        void disableAsync();
+        void flush();
+        ReporterStats stats() const;
     };
 
+// Reports below this severity are removed at compile time by BUS_REPORT.
+#ifndef BUS_REPORT_THRESHOLD
+#ifdef NDEBUG
+#define BUS_REPORT_THRESHOLD 1
+#else
+#define BUS_REPORT_THRESHOLD 0
+#endif
+#endif
+#define BUS_REPORT(REPORTER, LEVEL, LOC, ...)                             \
+    do {                                                                  \
+        if constexpr(Bus::reportSeverity(Bus::ReportLevel::LEVEL) >=      \
+                     BUS_REPORT_THRESHOLD) {                              \
+            Bus::Reporter& _bus_reporter_ = (REPORTER);                   \
+            if(_bus_reporter_.enabled(Bus::ReportLevel::LEVEL))           \
+                _bus_reporter_.report(Bus::ReportLevel::LEVEL, LOC,       \
+                                      __VA_ARGS__);                       \
+        }                                                                 \
+    } while(false)
+
+// With BUS_ENABLE_PROFILER every traced scope is also a profiled span, see
+// BusProfiler.hpp. Otherwise the macros expand exactly as without it.
+#ifdef BUS_ENABLE_PROFILER
+#define BUS_PROFILE_SPAN(LOC)                                             \
+    Bus::ProfileScope _bus_profile_((LOC).module, (LOC).srcFile,          \
+                                    (LOC).functionName, (LOC).line);
+#define BUS_PROFILE(MODULE) \
+    Bus::ProfileScope _bus_profile_(MODULE, __FILE__, __FUNCTION__, __LINE__)
+#else
+#define BUS_PROFILE_SPAN(LOC)
+#define BUS_PROFILE(MODULE) static_cast<void>(0)
+#endif
 #define BUS_TRACE_BEGIN(MODULE)                            \
     Bus::SourceLocation _bus_srcloc_ = BUS_SRCLOC(MODULE); \
+    BUS_PROFILE_SPAN(_bus_srcloc_)                         \
     try
 #define BUS_TRACE_BEG() BUS_TRACE_BEGIN(_bus_module_name_)
 #define BUS_MODULE_NAME(name) static const char* _bus_module_name_ = name
@@ -51,6 +212,7 @@ namespace Bus {
 #define BUS_TRACE_BEGIN_EX(MODULE)                             \
     try {                                                      \
         Bus::SourceLocation _bus_srcloc_ = BUS_SRCLOC(MODULE); \
+        BUS_PROFILE_SPAN(_bus_srcloc_)                         \
         try
 #define BUS_TRACE_BEG_EX() BUS_TRACE_BEGIN_EX(_bus_module_name_)
 #define BUS_TRACE_END_EX(detail)              \
@@ -0,0 +1,45 @@
+#include "BusResult.hpp"
+#include <atomic>
+#include <stdexcept>
+
+namespace Bus {
+    namespace Detail {
+        ErrorTrace& errorTrace() {
+            static thread_local ErrorTrace trace;
+            return trace;
+        }
+        // Unique across threads, so an Error moved to another thread never
+        // matches that thread's trace.
+        uint64_t nextErrorGeneration() {
+            static std::atomic_uint64_t generation{ 0 };
+            return ++generation;
+        }
+    }  // namespace Detail
+    const ErrorTrace& currentErrorTrace() {
+        return Detail::errorTrace();
+    }
+    void throwError(const Error& error) {
+        const ErrorTrace& trace = Detail::errorTrace();
+        std::exception_ptr ptr =
+            std::make_exception_ptr(std::runtime_error(error.message));
+        size_t size =
+            error.generation && error.generation == trace.generation ?
+            trace.size :
+            0;
+        for(size_t i = 0; i < size; ++i) {
+            const TraceFrame& frame = trace.frames[i];
+            try {
+                try {
+                    std::rethrow_exception(ptr);
+                } catch(...) {
+                    std::throw_with_nested(
+                        SourceLocation(frame.module, frame.srcFile,
+                                       frame.functionName, frame.line));
+                }
+            } catch(...) {
+                ptr = std::current_exception();
+            }
+        }
+        std::rethrow_exception(ptr);
+    }
+}  // namespace Bus
@@ -0,0 +1,147 @@
+#pragma once
+#include "BusReporter.hpp"
+#include <array>
+#include <optional>
+#include <variant>
+
+namespace Bus {
+    // Expected failures that are cheap to propagate: the message is static
+    // and the call chain goes to a thread-local buffer instead of a nested
+    // exception per frame.
+    struct Error final {
+        const char* message;
+        int code = 0;
+        // The failure whose frames ErrorTrace holds, 0 if none.
+        uint64_t generation = 0;
+    };
+
+    struct TraceFrame final {
+        const char* module;
+        const char* srcFile;
+        const char* functionName;
+        int line;
+    };
+
+    // Frames of the last failure raised on this thread, the origin first.
+    // Frames beyond the capacity are only counted.
+    struct ErrorTrace final {
+        static constexpr size_t capacity = 32;
+        std::array<TraceFrame, capacity> frames;
+        size_t size = 0;
+        size_t dropped = 0;
+        uint64_t generation = 0;
+    };
+
+    namespace Detail {
+        ErrorTrace& errorTrace();
+        uint64_t nextErrorGeneration();
+        // Frames are only added while the trace still belongs to error, a
+        // later failure on this thread may have replaced them.
+        inline void pushTrace(const SourceLocation& loc, const Error& error) {
+            ErrorTrace& trace = errorTrace();
+            if(trace.generation != error.generation)
+                return;
+            if(trace.size == ErrorTrace::capacity)
+                ++trace.dropped;
+            else
+                trace.frames[trace.size++] = { loc.module, loc.srcFile,
+                                               loc.functionName, loc.line };
+        }
+        inline Error raise(const SourceLocation& loc, Error error) {
+            ErrorTrace& trace = errorTrace();
+            trace.size = trace.dropped = 0;
+            trace.generation = error.generation = nextErrorGeneration();
+            pushTrace(loc, error);
+            return error;
+        }
+    }  // namespace Detail
+
+    const ErrorTrace& currentErrorTrace();
+    // Throws the error in the form BUS_TRACE_BEGIN/BUS_TRACE_END produce: a
+    // runtime_error nested in one SourceLocation per recorded frame. Errors
+    // whose trace has been replaced since are thrown without frames.
+    [[noreturn]] void throwError(const Error& error);
+
+    template <typename T>
+    class [[nodiscard]] Result final {
+    private:
+        std::variant<T, Error> mStorage;
+
+    public:
+        Result(T value) : mStorage(std::in_place_index<0>, std::move(value)) {}
+        Result(const Error& error) : mStorage(std::in_place_index<1>, error) {}
+        bool ok() const {
+            return mStorage.index() == 0;
+        }
+        explicit operator bool() const {
+            return ok();
+        }
+        const Error& error() const {
+            return std::get<1>(mStorage);
+        }
+        T& operator*() {
+            return std::get<0>(mStorage);
+        }
+        T* operator->() {
+            return &std::get<0>(mStorage);
+        }
+        // Converts a failure to the exception form at API boundaries.
+        T& value() {
+            if(!ok())
+                throwError(error());
+            return std::get<0>(mStorage);
+        }
+    };
+
+    template <>
+    class [[nodiscard]] Result<void> final {
+    private:
+        std::optional<Error> mError;
+
+    public:
+        Result() = default;
+        Result(const Error& error) : mError(error) {}
+        bool ok() const {
+            return !mError;
+        }
+        explicit operator bool() const {
+            return ok();
+        }
+        const Error& error() const {
+            return *mError;
+        }
+        void value() {
+            if(mError)
+                throwError(*mError);
+        }
+    };
+
+// Starts a new trace at this line and returns the error.
+#define BUS_RESULT_FAIL(MODULE, ...) \
+    return Bus::Detail::raise(BUS_SRCLOC(MODULE), Bus::Error{ __VA_ARGS__ })
+#define BUS_RESULT_FAIL_DEF(...) \
+    BUS_RESULT_FAIL(BUS_DEFAULT_MODULE_NAME, __VA_ARGS__)
+// Evaluates a Result into VAR, or records this line and returns its error.
+#define BUS_RESULT_TRY(MODULE, VAR, EXPR)                    \
+    auto&& _bus_result_##VAR = (EXPR);                       \
+    if(!_bus_result_##VAR) {                                 \
+        Bus::Detail::pushTrace(BUS_SRCLOC(MODULE),           \
+                               _bus_result_##VAR.error());   \
+        return _bus_result_##VAR.error();                    \
+    }                                                        \
+    auto&& VAR = *_bus_result_##VAR
+#define BUS_RESULT_TRY_DEF(VAR, EXPR) \
+    BUS_RESULT_TRY(BUS_DEFAULT_MODULE_NAME, VAR, EXPR)
+// Same for Result<void>.
+#define BUS_RESULT_CHECK(MODULE, EXPR)                       \
+    do {                                                     \
+        auto&& _bus_result_ = (EXPR);                        \
+        if(!_bus_result_) {                                  \
+            Bus::Detail::pushTrace(BUS_SRCLOC(MODULE),       \
+                                   _bus_result_.error());    \
+            return _bus_result_.error();                     \
+        }                                                    \
+    } while(false)
+#define BUS_RESULT_CHECK_DEF(EXPR) \
+    BUS_RESULT_CHECK(BUS_DEFAULT_MODULE_NAME, EXPR)
+}  // namespace Bus
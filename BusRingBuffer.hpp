@@ -0,0 +1,104 @@
+#pragma once
+#include "BusCommon.hpp"
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+namespace Bus {
+    // Bounded multi-producer/multi-consumer queue (Vyukov). Every cell carries
+    // a sequence number, so producers and consumers only contend on the
+    // head/tail counters and never take a lock.
+    template <typename T>
+    class RingBuffer final : private Unmoveable {
+    private:
+        struct Cell final {
+            std::atomic_size_t seq;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+            T* get() {
+                return std::launder(reinterpret_cast<T*>(&data));
+            }
+        };
+        std::unique_ptr<Cell[]> mCells;
+        size_t mMask;
+        alignas(64) std::atomic_size_t mHead;
+        alignas(64) std::atomic_size_t mTail;
+
+    public:
+        explicit RingBuffer(size_t capacity) : mHead(0), mTail(0) {
+            size_t size = 2;
+            while(size < capacity)
+                size <<= 1;
+            mCells = std::make_unique<Cell[]>(size);
+            mMask = size - 1;
+            for(size_t i = 0; i < size; ++i)
+                mCells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        ~RingBuffer() {
+            size_t head = mHead.load(std::memory_order_relaxed);
+            for(size_t pos = mTail.load(std::memory_order_relaxed);
+                pos != head; ++pos)
+                mCells[pos & mMask].get()->~T();
+        }
+        size_t capacity() const {
+            return mMask + 1;
+        }
+        // Positions handed out to producers and consumers so far.
+        size_t pushed() const {
+            return mHead.load();
+        }
+        size_t popped() const {
+            return mTail.load();
+        }
+        size_t size() const {
+            size_t head = mHead.load(std::memory_order_relaxed);
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            return head >= tail ? head - tail : 0;
+        }
+        template <typename U>
+        bool tryPush(U&& val) {
+            size_t pos = mHead.load(std::memory_order_relaxed);
+            while(true) {
+                Cell& cell = mCells[pos & mMask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                auto diff =
+                    static_cast<std::ptrdiff_t>(seq) -
+                    static_cast<std::ptrdiff_t>(pos);
+                if(diff == 0) {
+                    if(mHead.compare_exchange_weak(
+                           pos, pos + 1, std::memory_order_relaxed)) {
+                        new(&cell.data) T(std::forward<U>(val));
+                        cell.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if(diff < 0)
+                    return false;
+                else
+                    pos = mHead.load(std::memory_order_relaxed);
+            }
+        }
+        bool tryPop(T& val) {
+            size_t pos = mTail.load(std::memory_order_relaxed);
+            while(true) {
+                Cell& cell = mCells[pos & mMask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                auto diff =
+                    static_cast<std::ptrdiff_t>(seq) -
+                    static_cast<std::ptrdiff_t>(pos + 1);
+                if(diff == 0) {
+                    if(mTail.compare_exchange_weak(
+                           pos, pos + 1, std::memory_order_relaxed)) {
+                        T* ptr = cell.get();
+                        val = std::move(*ptr);
+                        ptr->~T();
+                        cell.seq.store(pos + mMask + 1,
+                                       std::memory_order_release);
+                        return true;
+                    }
+                } else if(diff < 0)
+                    return false;
+                else
+                    pos = mTail.load(std::memory_order_relaxed);
+            }
+        }
+    };
+}  // namespace Bus
@@ -0,0 +1,223 @@
+#include "BusScheduler.hpp"
+#include "BusReporter.hpp"
+#include <algorithm>
+
+namespace Bus {
+    static constexpr size_t notWorker = ~size_t(0);
+    static thread_local const Scheduler* currentScheduler = nullptr;
+    static thread_local size_t currentWorker = notWorker;
+
+    Scheduler::Scheduler(unsigned threads, Reporter& reporter,
+                         const ExceptionHandler& handler)
+        : mReporter(reporter), mHandler(handler) {
+        if(threads == 0)
+            threads = (std::max)(std::thread::hardware_concurrency(), 1U);
+        for(unsigned i = 0; i < threads; ++i)
+            mWorkers.emplace_back(std::make_unique<Worker>());
+        for(unsigned i = 0; i < threads; ++i)
+            mThreads.emplace_back(&Scheduler::run, this, i);
+    }
+    Scheduler::~Scheduler() {
+        mRunning.store(false);
+        {
+            std::lock_guard guard(mSleepMutex);
+            mSleep.notify_all();
+        }
+        for(auto&& thread : mThreads)
+            thread.join();
+    }
+    bool Scheduler::pop(size_t self, Task& task) {
+        if(mQueued.load(std::memory_order_relaxed) == 0)
+            return false;
+        size_t count = mWorkers.size();
+        if(self != notWorker) {
+            Worker& worker = *mWorkers[self];
+            std::lock_guard guard(worker.mutex);
+            if(!worker.tasks.empty()) {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+                mQueued.fetch_sub(1);
+                return true;
+            }
+        }
+        size_t start = self != notWorker ?
+            self + 1 :
+            mNext.fetch_add(1, std::memory_order_relaxed);
+        for(size_t i = 0; i < count; ++i) {
+            size_t victim = (start + i) % count;
+            if(victim == self)
+                continue;
+            Worker& worker = *mWorkers[victim];
+            std::lock_guard guard(worker.mutex);
+            if(!worker.tasks.empty()) {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+                mQueued.fetch_sub(1);
+                mStolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+    bool Scheduler::execute(Task& task) {
+        try {
+            task();
+            task = nullptr;
+            mExecuted.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        } catch(...) {
+            task = nullptr;
+            fail();
+            return false;
+        }
+    }
+    void Scheduler::fail() {
+        mFailed.fetch_add(1, std::memory_order_relaxed);
+        BUS_REPORT(mReporter, Error, BUS_SRCLOC("BusScheduler"),
+                   "Uncaught exception in a scheduled task.");
+        mHandler();
+    }
+    void Scheduler::run(size_t self) {
+        currentScheduler = this;
+        currentWorker = self;
+        Task task;
+        while(true) {
+            if(pop(self, task)) {
+                execute(task);
+                continue;
+            }
+            std::unique_lock lock(mSleepMutex);
+            // Pairs with submit: either it sees a sleeper or the sleeper
+            // sees its task.
+            mSleepers.fetch_add(1);
+            mSleep.wait(lock, [this] {
+                return mQueued.load() != 0 || !mRunning.load();
+            });
+            mSleepers.fetch_sub(1);
+            if(!mRunning.load() && mQueued.load() == 0)
+                return;
+        }
+    }
+    void Scheduler::submit(Task task) {
+        size_t self = currentScheduler == this ? currentWorker : notWorker;
+        if(self == notWorker)
+            self = mNext.fetch_add(1, std::memory_order_relaxed) %
+                mWorkers.size();
+        {
+            Worker& worker = *mWorkers[self];
+            std::lock_guard guard(worker.mutex);
+            worker.tasks.emplace_back(std::move(task));
+            mQueued.fetch_add(1);
+        }
+        if(mSleepers.load()) {
+            std::lock_guard guard(mSleepMutex);
+            mSleep.notify_one();
+        }
+    }
+    bool Scheduler::onWorker() const {
+        return currentScheduler == this;
+    }
+    bool Scheduler::runOne() {
+        Task task;
+        if(!pop(currentScheduler == this ? currentWorker : notWorker, task))
+            return false;
+        execute(task);
+        return true;
+    }
+    void Scheduler::parallelFor(
+        size_t begin, size_t end, size_t grain,
+        const std::function<void(size_t, size_t)>& body) {
+        if(begin >= end)
+            return;
+        size_t size = end - begin;
+        grain = (std::max)(grain, size_t(1));
+        // A few chunks per worker leaves room for stealing to balance.
+        size_t chunks =
+            (std::min)((size + grain - 1) / grain, mWorkers.size() * 4);
+        size_t step = (size + chunks - 1) / chunks;
+        TaskGroup group(*this);
+        for(size_t first = begin; first < end; first += step) {
+            size_t last = (std::min)(first + step, end);
+            group.run([&body, first, last] { body(first, last); });
+        }
+        group.wait();
+    }
+    SchedulerStats Scheduler::stats() const {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        return { mWorkers.size(), mExecuted.load(relaxed),
+                 mStolen.load(relaxed), mFailed.load(relaxed) };
+    }
+
+    void TaskGroup::run(Task task) {
+        {
+            std::lock_guard guard(mMutex);
+            ++mPending;
+        }
+        try {
+            mScheduler.submit([this, task = std::move(task)] {
+                struct Finish final {
+                    TaskGroup& group;
+                    ~Finish() {
+                        group.finish();
+                    }
+                } finish{ *this };
+                // Handled before finish, so a waiter sees the failure
+                // counted and reported.
+                try {
+                    task();
+                } catch(...) {
+                    mFailed.store(true, std::memory_order_relaxed);
+                    mScheduler.fail();
+                }
+            });
+        } catch(...) {
+            finish();
+            throw;
+        }
+    }
+    void TaskGroup::finish() {
+        Scheduler& scheduler = mScheduler;
+        Task continuation;
+        {
+            std::lock_guard guard(mMutex);
+            if(--mPending != 0)
+                return;
+            continuation = std::move(mContinuation);
+            mDone.notify_all();
+        }
+        // The group may be gone by now.
+        if(continuation)
+            scheduler.submit(std::move(continuation));
+    }
+    bool TaskGroup::suspend(Task continuation) {
+        std::lock_guard guard(mMutex);
+        if(mPending == 0)
+            return false;
+        mContinuation = std::move(continuation);
+        return true;
+    }
+    bool TaskGroup::wait() {
+        // A worker keeps looking for tasks, since the group's tasks may
+        // still be queued behind it. Other threads only help while there
+        // is something to run.
+        bool worker = mScheduler.onWorker();
+        auto done = [this] { return mPending == 0; };
+        while(!this->done()) {
+            if(mScheduler.runOne())
+                continue;
+            std::unique_lock lock(mMutex);
+            if(worker)
+                mDone.wait_for(lock, std::chrono::microseconds(100), done);
+            else
+                mDone.wait(lock, done);
+        }
+        return !mFailed.load(std::memory_order_relaxed);
+    }
+
+    Scheduler& ModuleSystem::getScheduler() {
+        std::call_once(mSchedulerFlag, [this] {
+            mScheduler = std::make_shared<Scheduler>(0, *mReporter, mHandler);
+        });
+        return *mScheduler;
+    }
+}  // namespace Bus
@@ -0,0 +1,156 @@
+#pragma once
+#include "BusSystem.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define BUS_HAS_COROUTINE 1
+#endif
+
+namespace Bus {
+    using Task = std::function<void()>;
+
+    struct SchedulerStats final {
+        size_t workers;
+        uint64_t executed;
+        uint64_t stolen;
+        uint64_t failed;
+    };
+
+    // Work-stealing pool shared by every module. A worker pushes and pops
+    // its own deque at the back and steals from the front of the others.
+    // Tasks submitted by other threads are spread over the workers.
+    class Scheduler final : private Unmoveable {
+    private:
+        struct alignas(64) Worker final {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+        Reporter& mReporter;
+        ExceptionHandler mHandler;
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+        std::vector<std::thread> mThreads;
+        std::atomic_bool mRunning{ true };
+        std::atomic_size_t mQueued{ 0 };
+        std::atomic_size_t mSleepers{ 0 };
+        std::atomic_size_t mNext{ 0 };
+        std::mutex mSleepMutex;
+        std::condition_variable mSleep;
+        std::atomic_uint64_t mExecuted{ 0 };
+        std::atomic_uint64_t mStolen{ 0 };
+        std::atomic_uint64_t mFailed{ 0 };
+
+        bool pop(size_t self, Task& task);
+        bool execute(Task& task);
+        // Counts, reports and handles the exception being caught.
+        void fail();
+        void run(size_t self);
+        friend class TaskGroup;
+
+    public:
+        // threads == 0 uses one worker per hardware thread.
+        Scheduler(unsigned threads, Reporter& reporter,
+                  const ExceptionHandler& handler);
+        ~Scheduler();
+        void submit(Task task);
+        // Runs one queued task on the calling thread, returns false if none
+        // was found. Waiting threads use it to help instead of blocking.
+        bool runOne();
+        // Whether the calling thread is one of this scheduler's workers.
+        bool onWorker() const;
+        // Splits [begin, end) into chunks of at least grain indices and
+        // runs body(first, last) on them, the caller included.
+        void parallelFor(size_t begin, size_t end, size_t grain,
+                         const std::function<void(size_t, size_t)>& body);
+        size_t workerCount() const {
+            return mWorkers.size();
+        }
+        SchedulerStats stats() const;
+
+#ifdef BUS_HAS_COROUTINE
+        class ScheduleAwaiter final {
+        private:
+            Scheduler& mScheduler;
+
+        public:
+            explicit ScheduleAwaiter(Scheduler& scheduler)
+                : mScheduler(scheduler) {}
+            bool await_ready() const noexcept {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle) {
+                mScheduler.submit([handle] { handle.resume(); });
+            }
+            void await_resume() const noexcept {}
+        };
+        // co_await scheduler.schedule() resumes the coroutine on a worker.
+        ScheduleAwaiter schedule() {
+            return ScheduleAwaiter(*this);
+        }
+#endif
+    };
+
+    // Tasks that are waited for together. wait() runs queued tasks while
+    // the group is busy, so waiting from a worker can't deadlock the pool.
+    // Other threads sleep once there is nothing left to help with.
+    class TaskGroup final : private Unmoveable {
+    private:
+        Scheduler& mScheduler;
+        // The last task signals under mMutex, so a waiter that saw the
+        // group done may destroy it right away.
+        mutable std::mutex mMutex;
+        std::condition_variable mDone;
+        size_t mPending = 0;
+        // Submitted by the last task, see WaitAwaiter.
+        Task mContinuation;
+        std::atomic_bool mFailed{ false };
+
+        void finish();
+        // Returns false if the group is already done.
+        bool suspend(Task continuation);
+
+    public:
+        explicit TaskGroup(Scheduler& scheduler) : mScheduler(scheduler) {}
+        ~TaskGroup() {
+            wait();
+        }
+        void run(Task task);
+        // Returns false if any task of the group threw.
+        bool wait();
+        bool done() const {
+            std::lock_guard guard(mMutex);
+            return mPending == 0;
+        }
+
+#ifdef BUS_HAS_COROUTINE
+        class WaitAwaiter final {
+        private:
+            TaskGroup& mGroup;
+
+        public:
+            explicit WaitAwaiter(TaskGroup& group) : mGroup(group) {}
+            bool await_ready() const {
+                return mGroup.done();
+            }
+            // The last task of the group resumes the coroutine on a
+            // worker. Only one coroutine may wait for a group at a time.
+            bool await_suspend(std::coroutine_handle<> handle) {
+                return mGroup.suspend([handle] { handle.resume(); });
+            }
+            bool await_resume() const noexcept {
+                return !mGroup.mFailed.load(std::memory_order_relaxed);
+            }
+        };
+        // co_await group finishes the group without blocking the caller.
+        WaitAwaiter operator co_await() {
+            return WaitAwaiter(*this);
+        }
+#endif
+    };
+}  // namespace Bus
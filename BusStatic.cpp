@@ -0,0 +1,126 @@
+#include "BusStatic.hpp"
+#include "BusMemory.hpp"
+#include "BusReporter.hpp"
+#include <algorithm>
+#include <mutex>
+
+namespace Bus {
+    static ModuleInfo staticInfo(const StaticModuleDesc& desc) {
+        ModuleInfo res;
+        res.name = desc.name;
+        res.guid = desc.guid;
+        res.busVersion = desc.busVersion;
+        res.version = desc.version;
+        res.description = desc.description;
+        res.copyright = desc.copyright;
+        return res;
+    }
+
+    static std::vector<Name> staticList(const StaticModuleDesc& desc,
+                                        Name interfaceName) {
+        std::vector<Name> res;
+        for(size_t i = 0; i < desc.functionCount; ++i)
+            if(desc.functions[i].interfaceName() == interfaceName)
+                res.emplace_back(desc.functions[i].name);
+        return res;
+    }
+
+    class StaticModule final : public ModuleInstance {
+    private:
+        const StaticModuleDesc& mDesc;
+
+        const FactoryEntry* find(Name name) const {
+            for(size_t i = 0; i < mDesc.functionCount; ++i)
+                if(mDesc.functions[i].name == name)
+                    return mDesc.functions + i;
+            return nullptr;
+        }
+
+    public:
+        StaticModule(const StaticModuleDesc& desc, ModuleSystem& system)
+            : ModuleInstance({}, system), mDesc(desc) {}
+        ModuleInfo info() const override {
+            return staticInfo(mDesc);
+        }
+        std::vector<Name> list(Name interfaceName) const override {
+            return staticList(mDesc, interfaceName);
+        }
+        std::vector<Name> interfaces() const override {
+            std::vector<Name> res;
+            for(size_t i = 0; i < mDesc.functionCount; ++i) {
+                Name name = mDesc.functions[i].interfaceName();
+                if(std::find(res.cbegin(), res.cend(), name) == res.cend())
+                    res.emplace_back(name);
+            }
+            return res;
+        }
+        std::shared_ptr<ModuleFunctionBase> instantiate(Name name) override {
+            auto func = find(name);
+            return func ? func->factory(*this) : nullptr;
+        }
+        FunctionFactory factory(Name name) override {
+            auto func = find(name);
+            if(!func)
+                return nullptr;
+            return [this, create = func->factory] {
+                return create(*this);
+            };
+        }
+    };
+
+    // Answers info and list from the table; the instance is only created
+    // when something is instantiated.
+    class StaticLibrary final : public ModuleLibrary {
+    private:
+        const StaticModuleDesc& mDesc;
+        ModuleSystem& mSystem;
+        std::once_flag mFlag;
+        std::shared_ptr<ModuleInstance> mInstance;
+        // The table's interfaceId is left 0, see BUS_STATIC_FUNCTION.
+        std::vector<uint64_t> mInterfaceIds;
+
+    public:
+        StaticLibrary(const StaticModuleDesc& desc, ModuleSystem& system)
+            : mDesc(desc), mSystem(system) {
+            mInterfaceIds.reserve(desc.functionCount);
+            for(size_t i = 0; i < desc.functionCount; ++i)
+                mInterfaceIds.push_back(
+                    Bus::interfaceId(desc.functions[i].interfaceName()));
+        }
+        std::shared_ptr<ModuleInstance> getInstance() override {
+            std::call_once(mFlag, [this] {
+                MemoryScope memory(mSystem.createModuleMemory());
+                mInstance = std::make_shared<StaticModule>(mDesc, mSystem);
+                memory.label(staticInfo(mDesc));
+            });
+            return mInstance;
+        }
+        ModuleInfo info() override {
+            return staticInfo(mDesc);
+        }
+        std::vector<Name> list(Name interfaceName) override {
+            return staticList(mDesc, interfaceName);
+        }
+        const FactoryEntry* factory(uint64_t interfaceId,
+                                    Name name) override {
+            for(size_t i = 0; i < mDesc.functionCount; ++i)
+                if(mInterfaceIds[i] == interfaceId &&
+                   mDesc.functions[i].name == name)
+                    return mDesc.functions + i;
+            return nullptr;
+        }
+    };
+
+    size_t
+    ModuleSystem::loadStaticModules(const StaticModuleDesc* const* begin,
+                                    const StaticModuleDesc* const* end) {
+        // Registered together, which publishes one snapshot. Linkers may
+        // pad the section with null entries.
+        std::vector<std::shared_ptr<ModuleLibrary>> batch;
+        for(auto iter = begin; iter != end; ++iter)
+            if(*iter)
+                batch.emplace_back(
+                    std::make_shared<StaticLibrary>(**iter, *this));
+        return load(batch);
+    }
+}  // namespace Bus
@@ -0,0 +1,104 @@
+#pragma once
+#include "BusModule.hpp"
+#include "BusSystem.hpp"
+
+namespace Bus {
+    // Everything here is constant-initialized, so linking a static module
+    // costs no work before main.
+    struct StaticModuleDesc final {
+        const char* name;
+        GUID guid;
+        const char* busVersion;
+        const char* version;
+        const char* description;
+        const char* copyright;
+        // interfaceId is 0, getInterface may not be constexpr. It is
+        // computed once the module is registered.
+        const FactoryEntry* functions;
+        size_t functionCount;
+    };
+}  // namespace Bus
+
+// Module descriptors are collected through a dedicated linker section, so
+// the table of statically linked modules is built by the linker.
+#if defined(_MSC_VER)
+#pragma section("bus_mod$a", read)
+#pragma section("bus_mod$m", read)
+#pragma section("bus_mod$z", read)
+namespace Bus::Detail {
+    __declspec(allocate("bus_mod$a")) __declspec(selectany) extern const
+        StaticModuleDesc* const staticModulesBegin = nullptr;
+    __declspec(allocate("bus_mod$z")) __declspec(selectany) extern const
+        StaticModuleDesc* const staticModulesEnd = nullptr;
+}  // namespace Bus::Detail
+#ifdef _WIN64
+#define BUS_STATIC_INCLUDE(NAME) __pragma(comment(linker, "/include:" #NAME))
+#else
+#define BUS_STATIC_INCLUDE(NAME) __pragma(comment(linker, "/include:_" #NAME))
+#endif
+#define BUS_STATIC_ENTRY(ID)                                 \
+    BUS_STATIC_INCLUDE(busStaticModuleEntry_##ID)            \
+    extern "C" __declspec(allocate("bus_mod$m")) const Bus:: \
+        StaticModuleDesc* const busStaticModuleEntry_##ID
+#elif defined(__APPLE__)
+extern "C" {
+extern const Bus::StaticModuleDesc* const busStaticModulesBegin __asm(
+    "section$start$__DATA$__bus_modules");
+extern const Bus::StaticModuleDesc* const busStaticModulesEnd __asm(
+    "section$end$__DATA$__bus_modules");
+}
+#define BUS_STATIC_ENTRY(ID)                               \
+    __attribute__((used, section("__DATA,__bus_modules"))) \
+    static const Bus::StaticModuleDesc* const busStaticModuleEntry_##ID
+#else
+extern "C" {
+extern const Bus::StaticModuleDesc* const __start_bus_modules[]
+    __attribute__((weak, visibility("hidden")));
+extern const Bus::StaticModuleDesc* const __stop_bus_modules[]
+    __attribute__((weak, visibility("hidden")));
+}
+#define BUS_STATIC_ENTRY(ID)                      \
+    __attribute__((used, section("bus_modules"))) \
+    static const Bus::StaticModuleDesc* const busStaticModuleEntry_##ID
+#endif
+
+#define BUS_STATIC_FUNCTION(INTERFACE, NAME, CLASS) \
+    Bus::Detail::makeFactoryEntry<CLASS>(0, &INTERFACE::getInterface, NAME)
+
+// BUS_STATIC_MODULE(ID, name, guid, version, description, copyright,
+//                   BUS_STATIC_FUNCTION(...)...)
+#define BUS_STATIC_MODULE(ID, NAME, GUID_, VERSION, DESCRIPTION, COPYRIGHT,   \
+                          ...)                                                \
+    static constexpr Bus::FactoryEntry busStaticFunctions_##ID[] = {          \
+        __VA_ARGS__                                                           \
+    };                                                                        \
+    static constexpr Bus::StaticModuleDesc busStaticModule_##ID = {           \
+        NAME,                                                                 \
+        GUID_,                                                                \
+        BUS_VERSION,                                                          \
+        VERSION,                                                              \
+        DESCRIPTION,                                                          \
+        COPYRIGHT,                                                            \
+        busStaticFunctions_##ID,                                              \
+        sizeof(busStaticFunctions_##ID) / sizeof(Bus::FactoryEntry)           \
+    };                                                                        \
+    BUS_STATIC_ENTRY(ID) = &busStaticModule_##ID
+
+namespace Bus {
+    namespace {
+        // Internal linkage: the section bounds must be those of the binary
+        // that includes this header, not of the one holding the runtime.
+        inline size_t loadStaticModules(ModuleSystem& system) {
+#if defined(_MSC_VER)
+            return system.loadStaticModules(&Detail::staticModulesBegin + 1,
+                                            &Detail::staticModulesEnd);
+#elif defined(__APPLE__)
+            return system.loadStaticModules(&busStaticModulesBegin,
+                                            &busStaticModulesEnd);
+#else
+            return system.loadStaticModules(__start_bus_modules,
+                                            __stop_bus_modules);
+#endif
+        }
+    }  // namespace
+}  // namespace Bus
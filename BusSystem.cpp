@@ -1,14 +1,109 @@
 #include "BusSystem.hpp"
+#include "BusCatalog.hpp"
+#include "BusManifest.hpp"
+#include "BusMemory.hpp"
+#include "BusMessage.hpp"
+#include "BusMetrics.hpp"
 #include "BusModule.hpp"
+#include "BusRegistry.hpp"
 #include "BusReporter.hpp"
+#include "BusResult.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef _WIN32
 #include "Windows.h"
 #ifdef BUS_MSVC_DELAYLOAD
 #define DELAYIMP_INSECURE_WRITABLE_HOOKS
 #pragma comment(lib, "delayimp.lib")
 #include <delayimp.h>
 #endif
+#else
+#include <dlfcn.h>
+#endif
 
 namespace Bus {
+    using Clock = std::chrono::steady_clock;
+    static int64_t elapsedUs(Clock::time_point beg) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   Clock::now() - beg)
+            .count();
+    }
+    static uint64_t elapsedNs(Clock::time_point beg) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                 beg)
+                .count());
+    }
+
+    // Index of the table returned by a module's busGetFactories export.
+    class FactoryIndex final {
+    private:
+        std::unordered_multimap<Name, const FactoryEntry*> mEntries;
+
+    public:
+        using GetCall = void (*)(const FactoryEntry*& entries, size_t& count);
+        // Returns false and ignores the table if it has another layout.
+        bool build(GetCall call) {
+            const FactoryEntry* entries = nullptr;
+            size_t count = 0;
+            call(entries, count);
+            return build(entries, count);
+        }
+        bool build(const FactoryEntry* entries, size_t count) {
+            for(size_t i = 0; i < count; ++i)
+                if(entries[i].version != factoryEntryVersion)
+                    return false;
+            mEntries.reserve(count);
+            for(size_t i = 0; i < count; ++i)
+                mEntries.emplace(entries[i].name, entries + i);
+            return true;
+        }
+        const FactoryEntry* find(uint64_t interfaceId, Name name) const {
+            auto range = mEntries.equal_range(name);
+            for(auto iter = range.first; iter != range.second; ++iter)
+                if(iter->second->interfaceId == interfaceId)
+                    return iter->second;
+            return nullptr;
+        }
+    };
+
+    // Directories in a module's ModuleInfo::thirdPartySearchPath, known
+    // before its library is opened from its descriptor or from the manifest
+    // next to it.
+    static std::vector<fs::path>
+    thirdPartyDirs(const fs::path& path, const ModuleDescriptor* descriptor,
+                   Reporter& reporter) {
+        std::optional<ModuleManifest> manifest;
+        if(!descriptor) {
+            std::error_code ec;
+            auto file = ModuleManifest::pathOf(path);
+            if(!fs::exists(file, ec))
+                return {};
+            try {
+                manifest.emplace(ModuleManifest::read(file));
+            } catch(...) {
+                BUS_REPORT(reporter, Warning, BUS_SRCLOC("BusSystem"),
+                           "Ignoring unreadable manifest ", file, '.');
+                return {};
+            }
+            descriptor = &*manifest;
+        }
+        std::vector<fs::path> res;
+        for(auto dir : descriptor->info().thirdPartySearchPath)
+            res.emplace_back(path.parent_path() / dir.data());
+        return res;
+    }
+
+#ifdef _WIN32
     static std::string winerr2String(const std::string& func, DWORD code) {
         char buf[1024];
         std::string res = "Failed to call function " + func +
@@ -80,6 +175,7 @@ namespace Bus {
     static void freeMod(HMODULE module, Reporter& reporter) {
         if(module == NULL)
             return;
+        Detail::profileUnload();
         if(FreeLibrary(module) != TRUE)
             reporter.apply(ReportLevel::Error, "Failed to free module.",
                            BUS_SRCLOC("BusSystem::Win32Module::ModuleHolder"));
@@ -96,18 +192,32 @@ namespace Bus {
         }
     };
 
+    // LoadLibraryExW searches the directories added by AddDllDirectory for
+    // the dependencies of the module.
+    static void openThirdParty(const std::vector<fs::path>& dirs,
+                               Reporter& reporter) {
+        for(auto&& dir : dirs)
+            addModuleSearchPath(dir, reporter);
+    }
+
     class Win32Module : public ModuleLibrary {
     private:
         Reporter& mReporter;
         HMODULE mModule;
         std::shared_ptr<ModuleInstance> mInstance;
+        LoadStats mStats;
+        FactoryIndex mFactories;
 
     public:
         explicit Win32Module(fs::path path, ModuleSystem& system,
-                             const ExceptionHandler& handler)
+                             const ExceptionHandler& handler,
+                             const ModuleDescriptor* descriptor = nullptr)
             : mReporter(system.getReporter()) {
             BUS_TRACE_BEGIN("BusSystem.Win32Module") {
                 path = fs::absolute(path);
+                openThirdParty(thirdPartyDirs(path, descriptor, mReporter),
+                               mReporter);
+                auto beg = Clock::now();
                 ModuleHolder tmp(
                     LoadLibraryExW(path.c_str(), NULL,
                                    LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR |
@@ -117,6 +227,7 @@ namespace Bus {
                     BUS_TRACE_THROW(std::runtime_error(
                         "Failed to load module " + path.string() + '\n' +
                         winerr2String("LoadLibraryExW", GetLastError())));
+                mStats.loadNs = elapsedNs(beg);
                 FARPROC address = GetProcAddress(tmp.module, "busInitModule");
                 if(!address)
                     BUS_TRACE_THROW(std::runtime_error(
@@ -125,6 +236,8 @@ namespace Bus {
                 using InitCall =
                     void (*)(const fs::path& path, ModuleSystem& system,
                              std::shared_ptr<ModuleInstance>& instance);
+                beg = Clock::now();
+                MemoryScope memory(system.createModuleMemory());
                 try {
                     reinterpret_cast<InitCall>(address)(path, system,
                                                         mInstance);
@@ -134,10 +247,19 @@ namespace Bus {
                 if(!mInstance)
                     BUS_TRACE_THROW(std::runtime_error(
                         "Failed to init module " + path.string()));
+                mStats.initNs = elapsedNs(beg);
+                memory.label(mInstance->info());
                 auto tsp = mInstance->info().thirdPartySearchPath;
                 auto base = path.parent_path();
                 for(auto p : tsp)
                     addModuleSearchPath(base / p.data(), mReporter);
+                FARPROC get = GetProcAddress(tmp.module, "busGetFactories");
+                if(get && !mFactories.build(
+                              reinterpret_cast<FactoryIndex::GetCall>(get)))
+                    BUS_REPORT(mReporter, Warning,
+                               BUS_SRCLOC("BusSystem.Win32Module"),
+                               "Factory table of module ", path,
+                               " has another version, ignoring it.");
                 mModule = tmp.module;
                 tmp.module = NULL;
             }
@@ -146,165 +268,1416 @@ namespace Bus {
         std::shared_ptr<ModuleInstance> getInstance() override {
             return mInstance;
         }
+        LoadStats loadStats() const override {
+            return mStats;
+        }
+        const FactoryEntry* factory(uint64_t interfaceId,
+                                    Name name) override {
+            return mFactories.find(interfaceId, name);
+        }
         ~Win32Module() {
             mInstance.reset();
             freeMod(mModule, mReporter);
         }
     };
 
+    using NativeModule = Win32Module;
+    using NativeHandle = HMODULE;
+    static const char* nativeExtension = ".dll";
+
+    static NativeHandle openNative(const fs::path& path, LoadPolicy) {
+        return LoadLibraryExW(path.c_str(), NULL,
+                              LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR |
+                                  LOAD_LIBRARY_SEARCH_DEFAULT_DIRS);
+    }
+    static void* nativeSymbol(NativeHandle handle, const char* name) {
+        return reinterpret_cast<void*>(GetProcAddress(handle, name));
+    }
+    static bool nativeLoaded(const fs::path& path) {
+        return GetModuleHandleW(fs::absolute(path).c_str()) != NULL;
+    }
+    static std::string nativeError() {
+        return winerr2String("LoadLibraryExW", GetLastError());
+    }
+#else
+    static std::string dlerr2String(const std::string& func) {
+        const char* reason = dlerror();
+        return "Failed to call function " + func +
+            "\nReason:" + (reason ? reason : "Unknown");
+    }
+
+    static std::mutex searchPathMutex;
+    static std::vector<fs::path> searchPaths;
+
+    void addModuleSearchPath(const fs::path& path, Reporter& reporter) {
+        std::error_code ec;
+        if(!fs::is_directory(path, ec)) {
+            reporter.apply(ReportLevel::Error,
+                           "Failed to add module search path " +
+                               path.string() + "\nReason:not a directory",
+                           BUS_SRCLOC("BusSystem"));
+            return;
+        }
+        auto abs = fs::absolute(path);
+        std::lock_guard guard(searchPathMutex);
+        for(auto&& p : searchPaths)
+            if(p == abs)
+                return;
+        searchPaths.emplace_back(abs);
+    }
+
+    static fs::path resolveModulePath(const fs::path& path) {
+        std::error_code ec;
+        if(path.is_absolute() || fs::exists(path, ec))
+            return fs::absolute(path);
+        std::lock_guard guard(searchPathMutex);
+        for(auto&& p : searchPaths)
+            if(fs::exists(p / path, ec))
+                return p / path;
+        return fs::absolute(path);
+    }
+
+    static int dlflags(LoadPolicy policy) {
+        return (policy == LoadPolicy::Lazy ? RTLD_LAZY : RTLD_NOW) |
+            RTLD_LOCAL;
+    }
+
+    static void freeMod(void* module, Reporter& reporter) {
+        if(module == nullptr)
+            return;
+        Detail::profileUnload();
+        if(dlclose(module) != 0)
+            reporter.apply(ReportLevel::Error,
+                           "Failed to free module.\n" +
+                               dlerr2String("dlclose"),
+                           BUS_SRCLOC("BusSystem::PosixModule::ModuleHolder"));
+    }
+
+    struct ModuleHolder final : private Unmoveable {
+        Reporter& reporter;
+        void* module;
+
+        ModuleHolder(void* module, Reporter& reporter)
+            : reporter(reporter), module(module) {}
+        ~ModuleHolder() {
+            freeMod(module, reporter);
+        }
+    };
+
+    // dlopen only searches the executable's paths for the dependencies of a
+    // module, but it reuses libraries that are already loaded under the
+    // same soname. So every library in the module's third party directories
+    // is opened first and stays loaded for the life of the process.
+    static std::mutex thirdPartyMutex;
+    static std::map<fs::path, void*> thirdPartyLibraries;
+
+    static void openThirdParty(const std::vector<fs::path>& dirs,
+                               Reporter& reporter) {
+        if(dirs.empty())
+            return;
+        std::lock_guard guard(thirdPartyMutex);
+        std::vector<fs::path> pending;
+        std::error_code ec;
+        for(auto&& dir : dirs)
+            for(auto&& entry : fs::directory_iterator(dir, ec)) {
+                auto name = entry.path().filename().string();
+                if(entry.is_regular_file(ec) &&
+                   (entry.path().extension() == ".so" ||
+                    name.find(".so.") != name.npos) &&
+                   !thirdPartyLibraries.count(fs::absolute(entry.path())))
+                    pending.emplace_back(fs::absolute(entry.path()));
+            }
+        std::sort(pending.begin(), pending.end());
+        // Libraries may depend on each other, so the ones that failed are
+        // retried until a round opens nothing new.
+        while(!pending.empty()) {
+            std::vector<fs::path> failed;
+            std::vector<std::string> errors;
+            for(auto&& file : pending) {
+                void* handle = dlopen(file.c_str(), RTLD_NOW | RTLD_GLOBAL);
+                if(handle)
+                    thirdPartyLibraries.emplace(file, handle);
+                else {
+                    failed.emplace_back(file);
+                    errors.emplace_back(dlerr2String("dlopen"));
+                }
+            }
+            if(failed.size() == pending.size()) {
+                for(size_t i = 0; i < failed.size(); ++i)
+                    BUS_REPORT(reporter, Warning, BUS_SRCLOC("BusSystem"),
+                               "Failed to open third party library ",
+                               failed[i], '\n', errors[i]);
+                break;
+            }
+            pending.swap(failed);
+        }
+    }
+
+    class PosixModule : public ModuleLibrary {
+    private:
+        Reporter& mReporter;
+        void* mModule;
+        std::shared_ptr<ModuleInstance> mInstance;
+        LoadStats mStats;
+        FactoryIndex mFactories;
+
+    public:
+        explicit PosixModule(fs::path path, ModuleSystem& system,
+                             const ExceptionHandler& handler,
+                             const ModuleDescriptor* descriptor = nullptr)
+            : mReporter(system.getReporter()) {
+            BUS_TRACE_BEGIN("BusSystem.PosixModule") {
+                path = resolveModulePath(path);
+                openThirdParty(thirdPartyDirs(path, descriptor, mReporter),
+                               mReporter);
+                auto beg = Clock::now();
+                ModuleHolder tmp(
+                    dlopen(path.c_str(), dlflags(system.getLoadPolicy())),
+                    mReporter);
+                if(tmp.module == nullptr)
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Failed to load module " + path.string() + '\n' +
+                        dlerr2String("dlopen")));
+                mStats.loadNs = elapsedNs(beg);
+                dlerror();
+                void* address = dlsym(tmp.module, "busInitModule");
+                if(!address)
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Failed to init module " + path.string() + '\n' +
+                        dlerr2String("dlsym")));
+                using InitCall =
+                    void (*)(const fs::path& path, ModuleSystem& system,
+                             std::shared_ptr<ModuleInstance>& instance);
+                beg = Clock::now();
+                MemoryScope memory(system.createModuleMemory());
+                try {
+                    reinterpret_cast<InitCall>(address)(path, system,
+                                                        mInstance);
+                } catch(...) {
+                    handler();
+                }
+                if(!mInstance)
+                    BUS_TRACE_THROW(std::runtime_error(
+                        "Failed to init module " + path.string()));
+                mStats.initNs = elapsedNs(beg);
+                memory.label(mInstance->info());
+                auto tsp = mInstance->info().thirdPartySearchPath;
+                auto base = path.parent_path();
+                for(auto p : tsp)
+                    addModuleSearchPath(base / p.data(), mReporter);
+                void* get = dlsym(tmp.module, "busGetFactories");
+                if(get && !mFactories.build(
+                              reinterpret_cast<FactoryIndex::GetCall>(get)))
+                    BUS_REPORT(mReporter, Warning,
+                               BUS_SRCLOC("BusSystem.PosixModule"),
+                               "Factory table of module ", path,
+                               " has another version, ignoring it.");
+                mModule = tmp.module;
+                tmp.module = nullptr;
+                BUS_REPORT(mReporter, Info, BUS_SRCLOC("BusSystem.PosixModule"),
+                           "Loaded module ", path,
+                           " [dlopen=", mStats.loadNs / 1000,
+                           "us,init=", mStats.initNs / 1000, "us]");
+            }
+            BUS_TRACE_END();
+        }
+        std::shared_ptr<ModuleInstance> getInstance() override {
+            return mInstance;
+        }
+        LoadStats loadStats() const override {
+            return mStats;
+        }
+        const FactoryEntry* factory(uint64_t interfaceId,
+                                    Name name) override {
+            return mFactories.find(interfaceId, name);
+        }
+        ~PosixModule() {
+            mInstance.reset();
+            freeMod(mModule, mReporter);
+        }
+    };
+
+    using NativeModule = PosixModule;
+    using NativeHandle = void*;
+    static const char* nativeExtension = ".so";
+
+    static NativeHandle openNative(const fs::path& path, LoadPolicy policy) {
+        return dlopen(path.c_str(), dlflags(policy));
+    }
+    static void* nativeSymbol(NativeHandle handle, const char* name) {
+        return dlsym(handle, name);
+    }
+    static bool nativeLoaded(const fs::path& path) {
+        void* handle = dlopen(resolveModulePath(path).c_str(),
+                              RTLD_LAZY | RTLD_NOLOAD);
+        if(handle)
+            dlclose(handle);
+        return handle != nullptr;
+    }
+    static std::string nativeError() {
+        return dlerr2String("dlopen");
+    }
+#endif
+
+    static bool scanModules(const fs::path& dir, std::vector<fs::path>& files,
+                            Reporter& reporter, const SourceLocation& loc) {
+        std::error_code ec;
+        for(auto&& entry : fs::directory_iterator(dir, ec))
+            if(entry.is_regular_file(ec) &&
+               entry.path().extension() == nativeExtension)
+                files.emplace_back(fs::absolute(entry.path()));
+        if(ec) {
+            reporter.apply(ReportLevel::Error,
+                           "Failed to scan module directory " + dir.string() +
+                               "\nReason:" + ec.message(),
+                           loc);
+            return false;
+        }
+        std::sort(files.begin(), files.end());
+        return true;
+    }
+
+    class ModulePreloader final : private Unmoveable {
+    private:
+        Reporter& mReporter;
+        std::mutex mMutex;
+        std::map<fs::path, NativeHandle> mHandles;
+        std::vector<std::future<void>> mTasks;
+
+        void run(std::vector<fs::path> files) {
+            auto beg = Clock::now();
+            std::atomic_size_t next{ 0 }, failed{ 0 };
+            auto worker = [&] {
+                for(size_t i = next++; i < files.size(); i = next++) {
+                    // Preloaded libraries are always fully relocated so that
+                    // the later loadModuleFile only bumps the refcount.
+                    NativeHandle handle = openNative(files[i], LoadPolicy::Now);
+                    if(handle == NULL) {
+                        ++failed;
+                        mReporter.apply(ReportLevel::Warning,
+                                        "Failed to preload module " +
+                                            files[i].string() + '\n' +
+                                            nativeError(),
+                                        BUS_SRCLOC("BusSystem.Preloader"));
+                        continue;
+                    }
+                    std::lock_guard guard(mMutex);
+                    if(!mHandles.emplace(files[i], handle).second)
+                        freeMod(handle, mReporter);
+                }
+            };
+            size_t count = (std::min)(
+                files.size(),
+                static_cast<size_t>(
+                    (std::max)(1U, std::thread::hardware_concurrency())));
+            std::vector<std::thread> workers;
+            for(size_t i = 1; i < count; ++i)
+                workers.emplace_back(worker);
+            worker();
+            for(auto&& thread : workers)
+                thread.join();
+            BUS_REPORT(mReporter, Info, BUS_SRCLOC("BusSystem.Preloader"),
+                       "Preloaded ", files.size() - failed, '/', files.size(),
+                       " modules in ", elapsedUs(beg), "us [threads=", count,
+                       "]");
+        }
+
+    public:
+        explicit ModulePreloader(Reporter& reporter) : mReporter(reporter) {}
+        void preload(const fs::path& dir) {
+            std::vector<fs::path> files;
+            if(!scanModules(dir, files, mReporter,
+                            BUS_SRCLOC("BusSystem.Preloader")) ||
+               files.empty())
+                return;
+            std::lock_guard guard(mMutex);
+            mTasks.emplace_back(std::async(std::launch::async,
+                                           &ModulePreloader::run, this,
+                                           std::move(files)));
+        }
+        void wait() {
+            std::vector<std::future<void>> tasks;
+            {
+                std::lock_guard guard(mMutex);
+                tasks.swap(mTasks);
+            }
+            for(auto&& task : tasks)
+                task.wait();
+        }
+        ~ModulePreloader() {
+            wait();
+            for(auto&& handle : mHandles)
+                freeMod(handle.second, mReporter);
+        }
+    };
+
+    void ModuleSystem::setLoadPolicy(LoadPolicy policy) {
+        mPolicy = policy;
+    }
+    LoadPolicy ModuleSystem::getLoadPolicy() const {
+        return mPolicy;
+    }
+    void ModuleSystem::preloadModules(const fs::path& dir) {
+        mPreloader->preload(dir);
+    }
+    void ModuleSystem::waitPreload() {
+        mPreloader->wait();
+    }
     bool ModuleSystem::loadModuleFile(const fs::path& path) {
-        return load(std::make_shared<Win32Module>(path, *this, mHandler));
+        return load(std::make_shared<NativeModule>(path, *this, mHandler));
+    }
+
+    ModuleInfo ModuleLibrary::info() {
+        return getInstance()->info();
+    }
+    std::vector<Name> ModuleLibrary::list(Name interfaceName) {
+        return getInstance()->list(interfaceName);
+    }
+
+    // Runs task(i) for every node on a pool of threads, starting a node once
+    // all of its dependencies succeeded. Nodes downstream of a failed one are
+    // handed to skip(node, failed) instead. Nodes on a cycle never run.
+    template <typename Task, typename Skip>
+    static void runGraph(const std::vector<std::vector<size_t>>& dependents,
+                         std::vector<size_t> pending, size_t threads,
+                         Task&& task, Skip&& skip) {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<size_t> ready;
+        std::vector<char> skipped(pending.size());
+        size_t active = 0;
+        for(size_t i = 0; i < pending.size(); ++i)
+            if(pending[i] == 0)
+                ready.emplace_back(i);
+        std::function<void(size_t, size_t)> skipAll = [&](size_t node,
+                                                          size_t failed) {
+            for(auto dep : dependents[node])
+                if(!skipped[dep]) {
+                    skipped[dep] = true;
+                    skip(dep, failed);
+                    skipAll(dep, failed);
+                }
+        };
+        auto worker = [&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                cond.wait(lock, [&] { return !ready.empty() || active == 0; });
+                if(ready.empty())
+                    break;
+                size_t node = ready.front();
+                ready.pop_front();
+                ++active;
+                lock.unlock();
+                bool res = task(node);
+                lock.lock();
+                --active;
+                if(res) {
+                    for(auto dep : dependents[node])
+                        if(--pending[dep] == 0)
+                            ready.emplace_back(dep);
+                } else
+                    skipAll(node, node);
+                cond.notify_all();
+            }
+        };
+        size_t count = (std::min)(threads, pending.size());
+        std::vector<std::thread> workers;
+        for(size_t i = 1; i < count; ++i)
+            workers.emplace_back(worker);
+        worker();
+        for(auto&& thread : workers)
+            thread.join();
+    }
+
+    // Marks the nodes that lie on a cycle, i.e. in a strongly connected
+    // component with more than one node or with an edge to itself (Tarjan).
+    static std::vector<char>
+    cycleMembers(const std::vector<std::vector<size_t>>& edges) {
+        constexpr size_t unvisited = SIZE_MAX;
+        size_t count = edges.size(), next = 0;
+        std::vector<size_t> index(count, unvisited), low(count), stack;
+        std::vector<char> onStack(count), res(count);
+        // Frames of the depth-first search: node and next edge to follow.
+        std::vector<std::pair<size_t, size_t>> frames;
+        for(size_t root = 0; root < count; ++root) {
+            if(index[root] != unvisited)
+                continue;
+            frames.emplace_back(root, 0);
+            while(!frames.empty()) {
+                auto& [node, edge] = frames.back();
+                if(edge == 0) {
+                    index[node] = low[node] = next++;
+                    stack.push_back(node);
+                    onStack[node] = true;
+                }
+                if(edge < edges[node].size()) {
+                    size_t succ = edges[node][edge++];
+                    if(index[succ] == unvisited)
+                        frames.emplace_back(succ, 0);
+                    else if(onStack[succ])
+                        low[node] = (std::min)(low[node], index[succ]);
+                    continue;
+                }
+                size_t done = node;
+                frames.pop_back();
+                if(!frames.empty())
+                    low[frames.back().first] =
+                        (std::min)(low[frames.back().first], low[done]);
+                if(low[done] != index[done])
+                    continue;
+                size_t member, size = 0;
+                size_t top = stack.size();
+                do {
+                    member = stack[--top];
+                    ++size;
+                } while(member != done);
+                bool loop = std::find(edges[done].cbegin(), edges[done].cend(),
+                                      done) != edges[done].cend();
+                for(size_t i = top; i < stack.size(); ++i) {
+                    onStack[stack[i]] = false;
+                    res[stack[i]] = size > 1 || loop;
+                }
+                stack.resize(top);
+            }
+        }
+        return res;
+    }
+
+    size_t ModuleSystem::loadModuleDirectory(const fs::path& dir,
+                                             size_t threads) {
+        Reporter& reporter = *mReporter;
+        std::vector<fs::path> files;
+        if(!scanModules(dir, files, reporter, BUS_SRCLOC("BusSystem.Loader")))
+            return 0;
+        if(threads == 0)
+            threads = (std::max)(1U, std::thread::hardware_concurrency());
+        auto beg = Clock::now();
+
+        // Dependencies are known up front from manifests, or from the
+        // busGetDependencies export. Modules with neither are initialized
+        // first, unordered, so that declared modules can depend on them.
+        std::vector<fs::path> opaque, paths;
+        std::vector<ModuleManifest> declared;
+        std::unordered_map<GUID, size_t, GUIDHash> byGUID;
+        // Probed libraries stay open so that loading them doesn't map them
+        // again.
+        std::deque<ModuleHolder> probed;
+        std::error_code ec;
+        auto describe = [&](const fs::path& file) -> bool {
+            auto manifest = ModuleManifest::pathOf(file);
+            if(fs::exists(manifest, ec)) {
+                declared.emplace_back(ModuleManifest::read(manifest));
+                return true;
+            }
+            auto& holder = probed.emplace_back(
+                openNative(file, getLoadPolicy()), reporter);
+            using GetCall = void (*)(const fs::path& path, GUID& guid,
+                                     std::vector<GUID>& dependencies);
+            void* get = holder.module ?
+                nativeSymbol(holder.module, "busGetDependencies") :
+                nullptr;
+            if(!get)
+                return false;
+            ModuleInfo info;
+            reinterpret_cast<GetCall>(get)(file, info.guid,
+                                           info.dependencies);
+            declared.emplace_back(info, std::map<Name, std::vector<Name>>{});
+            return true;
+        };
+        for(auto&& file : files) {
+            try {
+                if(!describe(file)) {
+                    BUS_REPORT(reporter, Warning,
+                               BUS_SRCLOC("BusSystem.Loader"),
+                               "No manifest for module ", file,
+                               ", initializing it without ordering.");
+                    opaque.emplace_back(file);
+                    continue;
+                }
+                GUID guid = declared.back().info().guid;
+                auto iter = byGUID.find(guid);
+                if(iter != byGUID.cend()) {
+                    declared.pop_back();
+                    BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                               "Modules ", paths[iter->second], " and ", file,
+                               " share GUID ", guid, ", skipping the latter.");
+                    continue;
+                }
+                byGUID.emplace(guid, declared.size() - 1);
+                paths.emplace_back(file);
+            } catch(...) {
+                mHandler();
+            }
+        }
+
+        // Modules that nothing in the directory waits for are registered in
+        // one batch, which publishes one snapshot instead of one per module.
+        std::atomic_size_t loaded{ 0 };
+        std::mutex batchMutex;
+        std::vector<std::shared_ptr<ModuleLibrary>> batch;
+        std::unordered_set<GUID, GUIDHash> batched;
+        auto loadFile = [&](const fs::path& path,
+                            const ModuleManifest* manifest, bool defer) {
+            try {
+                auto library = std::make_shared<NativeModule>(
+                    path, *this, mHandler, manifest);
+                auto info = library->info();
+                GUID guid = info.guid;
+                if(manifest && guid != manifest->info().guid) {
+                    BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                               "Module ", path, " has GUID ", guid,
+                               " but its manifest declares ",
+                               manifest->info().guid, '.');
+                    return false;
+                }
+                if(!manifest && !info.dependencies.empty())
+                    BUS_REPORT(reporter, Warning,
+                               BUS_SRCLOC("BusSystem.Loader"), "Module ",
+                               path, " has dependencies but was initialized "
+                               "without ordering, add a manifest or export "
+                               "busGetDependencies.");
+                bool res;
+                {
+                    std::lock_guard guard(batchMutex);
+                    res = !batched.count(guid);
+                    if(res && defer) {
+                        res = !mRegistry->snapshot()->find(guid);
+                        if(res) {
+                            batched.insert(guid);
+                            batch.emplace_back(std::move(library));
+                        }
+                    } else if(res)
+                        res = load(std::move(library));
+                }
+                if(!res) {
+                    BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                               "Module ", path, " has GUID ", guid,
+                               " which is already registered.");
+                    return false;
+                }
+                ++loaded;
+                return true;
+            } catch(...) {
+                mHandler();
+                return false;
+            }
+        };
+        auto flush = [&] {
+            try {
+                loaded -= batch.size() - load(batch);
+            } catch(...) {
+                loaded -= batch.size();
+                mHandler();
+            }
+            batch.clear();
+        };
+        runGraph(
+            std::vector<std::vector<size_t>>(opaque.size()),
+            std::vector<size_t>(opaque.size()), threads,
+            [&](size_t i) { return loadFile(opaque[i], nullptr, true); },
+            [](size_t, size_t) {});
+        flush();
+
+        auto snapshot = mRegistry->snapshot();
+        std::vector<std::vector<size_t>> dependents(declared.size());
+        std::vector<size_t> pending(declared.size());
+        std::vector<char> missing(declared.size());
+        for(size_t i = 0; i < declared.size(); ++i)
+            for(auto dep : declared[i].info().dependencies) {
+                auto iter = byGUID.find(dep);
+                if(iter != byGUID.cend()) {
+                    dependents[iter->second].emplace_back(i);
+                    ++pending[i];
+                } else if(!snapshot->find(dep)) {
+                    BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                               "Module ", paths[i], " depends on ", dep,
+                               " which is not available.");
+                    missing[i] = true;
+                }
+            }
+
+        // Modules on a cycle never run, nor does anything that depends on
+        // one.
+        auto cyclic = cycleMembers(dependents);
+        std::vector<size_t> in = pending, queue;
+        std::vector<char> ordered(declared.size());
+        for(size_t i = 0; i < declared.size(); ++i)
+            if(in[i] == 0)
+                queue.emplace_back(i);
+        while(!queue.empty()) {
+            size_t node = queue.back();
+            queue.pop_back();
+            ordered[node] = true;
+            for(auto dep : dependents[node])
+                if(--in[dep] == 0)
+                    queue.emplace_back(dep);
+        }
+        for(size_t i = 0; i < declared.size(); ++i)
+            if(cyclic[i])
+                BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                           "Module ", paths[i],
+                           " is part of a dependency cycle.");
+            else if(!ordered[i])
+                BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                           "Module ", paths[i],
+                           " depends on a dependency cycle.");
+
+        runGraph(
+            dependents, std::move(pending), threads,
+            [&](size_t i) {
+                return !missing[i] &&
+                    loadFile(paths[i], &declared[i], dependents[i].empty());
+            },
+            [&](size_t node, size_t failed) {
+                BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Loader"),
+                           "Skipped module ", paths[node], " because ",
+                           paths[failed], " failed to load.");
+            });
+        flush();
+        BUS_REPORT(reporter, Info, BUS_SRCLOC("BusSystem.Loader"), "Loaded ",
+                   loaded.load(), '/', files.size(), " modules from ", dir,
+                   " in ", elapsedUs(beg), "us [threads=", threads, "]");
+        return loaded;
+    }
+
+    class LazyModule final : public ModuleLibrary {
+    private:
+        std::shared_ptr<const ModuleDescriptor> mDescriptor;
+        fs::path mPath;
+        ModuleSystem& mSystem;
+        ExceptionHandler mHandler;
+        std::mutex mMutex;
+        std::shared_ptr<ModuleLibrary> mLibrary;
+        std::atomic_bool mLoaded;
+
+        bool matches(ModuleLibrary& library) {
+            GUID guid = library.info().guid;
+            if(guid == mDescriptor->info().guid)
+                return true;
+            BUS_REPORT(mSystem.getReporter(), Error,
+                       BUS_SRCLOC("BusSystem.LazyModule"), "Module ", mPath,
+                       " has GUID ", guid, " but its description declares ",
+                       mDescriptor->info().guid, '.');
+            return false;
+        }
+
+        void loadLibrary() {
+            try {
+                auto library = std::make_shared<NativeModule>(
+                    mPath, mSystem, mHandler, mDescriptor.get());
+                if(!matches(*library))
+                    return;
+                mLibrary = library;
+                mLoaded.store(true);
+                mSystem.recordLoad(mDescriptor->info().guid, *this,
+                                   mLibrary->loadStats());
+            } catch(...) {
+                BUS_REPORT(mSystem.getReporter(), Error,
+                           BUS_SRCLOC("BusSystem.LazyModule"),
+                           "Failed to load module ", mPath, '.');
+                mHandler();
+            }
+        }
+
+    public:
+        // library may carry an already loaded copy of the module.
+        LazyModule(std::shared_ptr<const ModuleDescriptor> descriptor,
+                   const fs::path& path, ModuleSystem& system,
+                   const ExceptionHandler& handler,
+                   std::shared_ptr<ModuleLibrary> library = nullptr)
+            : mDescriptor(std::move(descriptor)), mPath(path),
+              mSystem(system), mHandler(handler), mLoaded(false) {
+            if(library && matches(*library)) {
+                mLibrary = std::move(library);
+                mLoaded.store(true);
+            }
+        }
+        // A failed load is retried on the next use.
+        std::shared_ptr<ModuleInstance> getInstance() override {
+            if(!mLoaded.load()) {
+                std::lock_guard guard(mMutex);
+                if(!mLoaded.load())
+                    loadLibrary();
+            }
+            return mLoaded.load() ? mLibrary->getInstance() : nullptr;
+        }
+        LoadStats loadStats() const override {
+            return mLoaded.load() ? mLibrary->loadStats() : LoadStats{};
+        }
+        ModuleInfo info() override {
+            ModuleInfo res = mDescriptor->info();
+            res.modulePath = mPath;
+            return res;
+        }
+        std::vector<Name> list(Name interfaceName) override {
+            return mDescriptor->list(interfaceName);
+        }
+        std::shared_ptr<const void> nameStorage() const override {
+            return mDescriptor->nameStorage();
+        }
+        const FactoryEntry* factory(uint64_t interfaceId,
+                                    Name name) override {
+            return getInstance() ? mLibrary->factory(interfaceId, name)
+                                 : nullptr;
+        }
+    };
+
+    bool ModuleSystem::loadModuleLazily(const fs::path& path) {
+        auto manifest = ModuleManifest::pathOf(path);
+        std::error_code ec;
+        if(!fs::exists(manifest, ec)) {
+            BUS_REPORT(*mReporter, Warning, BUS_SRCLOC("BusSystem"),
+                       "No manifest for module ", path,
+                       ", loading it eagerly.");
+            return loadModuleFile(path);
+        }
+        auto desc =
+            std::make_shared<ModuleManifest>(ModuleManifest::read(manifest));
+        if(!desc->describes(path)) {
+            BUS_REPORT(*mReporter, Warning, BUS_SRCLOC("BusSystem"),
+                       "Manifest of module ", path,
+                       " is out of date, loading it eagerly.");
+            return loadModuleFile(path);
+        }
+        return load(
+            std::make_shared<LazyModule>(std::move(desc), path, *this,
+                                         mHandler));
+    }
+
+    bool ModuleSystem::generateManifest(const fs::path& path,
+                                        const std::vector<Name>& interfaces) {
+        try {
+            std::error_code ec;
+            auto stamp = FileStamp::of(path, ec);
+            NativeModule library(path, *this, mHandler);
+            auto instance = library.getInstance();
+            auto names = instance->interfaces();
+            names.insert(names.end(), interfaces.cbegin(), interfaces.cend());
+            std::map<Name, std::vector<Name>> functions;
+            for(auto name : names) {
+                auto funcs = instance->list(name);
+                if(!funcs.empty())
+                    functions.emplace(name, std::move(funcs));
+            }
+            if(functions.empty()) {
+                BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem"),
+                           "Module ", path,
+                           " lists no functions, pass its interfaces to "
+                           "describe it.");
+                return false;
+            }
+            ModuleManifest manifest(instance->info(), functions);
+            if(!ec)
+                manifest.setLibrary(stamp);
+            manifest.write(ModuleManifest::pathOf(path));
+            return true;
+        } catch(...) {
+            mHandler();
+            return false;
+        }
+    }
+
+    size_t ModuleSystem::loadCatalog(const fs::path& catalog,
+                                     const fs::path& dir) {
+        Reporter& reporter = *mReporter;
+        std::vector<fs::path> files;
+        if(!scanModules(dir, files, reporter, BUS_SRCLOC("BusSystem.Catalog")))
+            return 0;
+
+        std::error_code ec;
+        auto beg = Clock::now();
+        auto cached = std::make_shared<const ModuleCatalog>(catalog);
+        std::map<std::string, std::shared_ptr<ModuleLibrary>> loaded;
+        // Descriptions of the files the old catalog doesn't cover, null for
+        // opaque modules. Used if the new catalog can't be written.
+        std::map<std::string, std::shared_ptr<const ModuleManifest>> fresh;
+        std::vector<std::pair<std::string, FileStamp>> scanned;
+        CatalogWriter writer;
+        size_t reused = 0;
+        for(auto&& file : files) {
+            // u8string returns std::u8string since C++20.
+            auto u8 = file.u8string();
+            std::string path(u8.cbegin(), u8.cend());
+            auto stamp = FileStamp::of(file, ec);
+            if(ec) {
+                BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Catalog"),
+                           "Failed to stat module ", file,
+                           "\nReason:", ec.message());
+                ec.clear();
+                continue;
+            }
+            scanned.emplace_back(path, stamp);
+            auto old = cached->find(path);
+            if(old && old->fileSize == stamp.size &&
+               old->writeTime == stamp.writeTime) {
+                CatalogDescriptor desc(cached, *old);
+                writer.add(path, stamp.size, stamp.writeTime, desc.info(),
+                           old->opaque ? nullptr : &desc,
+                           cached->interfaces(*old));
+                ++reused;
+                continue;
+            }
+            try {
+                auto manifest = ModuleManifest::pathOf(file);
+                if(fs::exists(manifest, ec)) {
+                    auto desc = std::make_shared<const ModuleManifest>(
+                        ModuleManifest::read(manifest));
+                    if(desc->describes(file)) {
+                        writer.add(path, stamp.size, stamp.writeTime,
+                                   desc->info(), desc.get(),
+                                   desc->interfaces());
+                        fresh.emplace(path, std::move(desc));
+                        continue;
+                    }
+                    BUS_REPORT(reporter, Warning,
+                               BUS_SRCLOC("BusSystem.Catalog"),
+                               "Manifest of module ", file,
+                               " is out of date, loading it instead.");
+                }
+                auto library =
+                    std::make_shared<NativeModule>(file, *this, mHandler);
+                auto instance = library->getInstance();
+                auto names = instance->interfaces();
+                std::map<Name, std::vector<Name>> functions;
+                for(auto name : names)
+                    functions.emplace(name, instance->list(name));
+                auto desc = std::make_shared<const ModuleManifest>(
+                    instance->info(), functions);
+                writer.add(path, stamp.size, stamp.writeTime, desc->info(),
+                           names.empty() ? nullptr : desc.get(), names);
+                fresh.emplace(path, names.empty() ? nullptr : desc);
+                loaded.emplace(path, std::move(library));
+            } catch(...) {
+                mHandler();
+            }
+        }
+
+        bool written = true;
+        if(reused != files.size() || reused != cached->size()) {
+            // Drop the mapping first so the rename can replace the file.
+            cached.reset();
+            try {
+                writer.write(catalog);
+            } catch(...) {
+                written = false;
+                mHandler();
+            }
+            cached = std::make_shared<const ModuleCatalog>(catalog);
+            if(!written || !cached->valid())
+                BUS_REPORT(reporter, Error, BUS_SRCLOC("BusSystem.Catalog"),
+                           "Failed to rebuild module catalog ", catalog);
+        }
+
+        // Modules that are already initialized or load lazily are registered
+        // together. The batch is flushed before a module initializes, since
+        // its initialization may look up the earlier ones.
+        size_t count = 0;
+        std::vector<std::shared_ptr<ModuleLibrary>> batch;
+        auto flush = [&] {
+            count += load(batch);
+            batch.clear();
+        };
+        auto add = [&](const std::string& u8,
+                       std::shared_ptr<const ModuleDescriptor> desc) {
+            auto path = fs::u8path(u8);
+            std::shared_ptr<ModuleLibrary> library;
+            auto iter = loaded.find(u8);
+            if(iter != loaded.cend())
+                library = iter->second;
+            try {
+                if(desc)
+                    batch.emplace_back(std::make_shared<LazyModule>(
+                        std::move(desc), path, *this, mHandler, library));
+                else if(library)
+                    batch.emplace_back(library);
+                else {
+                    flush();
+                    count += loadModuleFile(path);
+                }
+            } catch(...) {
+                mHandler();
+            }
+        };
+        auto describe = [&](const CatalogModule& module)
+            -> std::shared_ptr<const ModuleDescriptor> {
+            if(module.opaque)
+                return nullptr;
+            return std::make_shared<CatalogDescriptor>(cached, module);
+        };
+        if(written)
+            for(size_t i = 0; i < cached->size(); ++i) {
+                auto&& module = cached->module(i);
+                add(std::string(cached->string(module.path)),
+                    describe(module));
+            }
+        else
+            // The old catalog is still in place and only describes the
+            // files that didn't change.
+            for(auto&& [path, stamp] : scanned) {
+                auto iter = fresh.find(path);
+                auto module = cached->find(path);
+                if(iter != fresh.cend())
+                    add(path, iter->second);
+                else if(module && module->fileSize == stamp.size &&
+                        module->writeTime == stamp.writeTime)
+                    add(path, describe(*module));
+            }
+        try {
+            flush();
+        } catch(...) {
+            mHandler();
+        }
+        BUS_REPORT(reporter, Info, BUS_SRCLOC("BusSystem.Catalog"),
+                   "Registered ", count, '/', files.size(),
+                   " modules from catalog ", catalog, " in ", elapsedUs(beg),
+                   "us [reused=", reused, "]");
+        return count;
     }
 
     class BuiltinWrapper final : public ModuleLibrary {
     private:
         std::shared_ptr<ModuleInstance> mInstance;
+        LoadStats mStats;
+        FactoryIndex mFactories;
 
     public:
-        explicit BuiltinWrapper(std::shared_ptr<ModuleInstance> instance)
-            : mInstance(instance) {}
+        BuiltinWrapper(std::shared_ptr<ModuleInstance> instance,
+                       LoadStats stats, const FactoryEntry* factories,
+                       size_t count)
+            : mInstance(instance), mStats(stats) {
+            mFactories.build(factories, count);
+        }
         std::shared_ptr<ModuleInstance> getInstance() override {
             return mInstance;
         }
+        LoadStats loadStats() const override {
+            return mStats;
+        }
+        const FactoryEntry* factory(uint64_t interfaceId,
+                                    Name name) override {
+            return mFactories.find(interfaceId, name);
+        }
     };
 
     bool ModuleSystem::wrapBuiltin(
         const std::function<std::shared_ptr<ModuleInstance>(ModuleSystem&)>&
-            gen) {
-        return load(std::make_shared<BuiltinWrapper>(gen(*this)));
+            gen,
+        const FactoryEntry* factories, size_t count) {
+        LoadStats stats;
+        auto beg = Clock::now();
+        MemoryScope memory(createModuleMemory());
+        auto instance = gen(*this);
+        stats.initNs = elapsedNs(beg);
+        memory.label(instance->info());
+        return load(std::make_shared<BuiltinWrapper>(instance, stats,
+                                                     factories, count));
     }
 
     ModuleSystem::ModuleSystem(std::shared_ptr<Reporter> reporter,
                                const ExceptionHandler& handler)
-        : mReporter(reporter), mHandler(handler) {
+        : mReporter(reporter), mHandler(handler), mPolicy(LoadPolicy::Lazy),
+          mPreloader(std::make_shared<ModulePreloader>(*mReporter)),
+          mMetrics(std::make_shared<SystemMetrics>()),
+          mRegistry(std::make_shared<ModuleRegistry>()),
+          mMemory(std::make_shared<MemoryRegistry>()),
+          mBus(std::make_shared<MessageBus>(mReporter)) {
 #ifdef BUS_MSVC_DELAYLOAD
         pReporter = mReporter.get();
 #endif
     }
     bool ModuleSystem::load(std::shared_ptr<ModuleLibrary> library) {
-        GUID guid = library->getInstance()->info().guid;
-        auto iter = mInstances.find(guid);
-        if(iter != mInstances.cend())
+        return mRegistry->add({ std::move(library) }, *mMetrics) != 0;
+    }
+    size_t ModuleSystem::load(
+        const std::vector<std::shared_ptr<ModuleLibrary>>& batch) {
+        return mRegistry->add(batch, *mMetrics);
+    }
+    void ModuleSystem::recordLoad(GUID guid, const ModuleLibrary& library,
+                                  const LoadStats& stats) {
+        auto snapshot = mRegistry->snapshot();
+        auto module = snapshot->find(guid);
+        if(module && module->library.get() == &library)
+            mMetrics->recordLoad(*module->metrics, stats.loadNs,
+                                 stats.initNs);
+    }
+    // Objects keep the library that created them loaded, so a reloaded
+    // module is only unloaded after everything it created is released.
+    // Objects from a factory table entry hold it in their deleter, see
+    // constructPinned. The ones a module builds itself have their deleter
+    // in the module's code, so they are wrapped in one that releases the
+    // library after the module's deleter has returned.
+    static std::shared_ptr<ModuleFunctionBase>
+    pin(std::shared_ptr<ModuleFunctionBase> res,
+        std::shared_ptr<ModuleLibrary> library) {
+        if(!res || !library)
+            return res;
+        ModuleFunctionBase* ptr = res.get();
+        return std::shared_ptr<ModuleFunctionBase>(
+            ptr, [res = std::move(res), library = std::move(library)](
+                     ModuleFunctionBase*) mutable {
+                res.reset();
+                library.reset();
+            });
+    }
+
+    // Builds an object from a factory table entry in one allocation that
+    // also holds its control block. The deleter runs here rather than in
+    // the module and drops the library after the object is destroyed, so
+    // this costs no more than the module's own make_shared.
+    namespace Detail {
+        // Room for the control block of shared_ptr<T>(ptr, d, a).
+        constexpr size_t pinnedControlSize = 96;
+        template <typename T>
+        class PinnedAllocator final {
+        public:
+            using value_type = T;
+            void* storage;
+            size_t align;
+
+            PinnedAllocator(void* storage, size_t align)
+                : storage(storage), align(align) {}
+            template <typename U>
+            PinnedAllocator(const PinnedAllocator<U>& rhs)
+                : storage(rhs.storage), align(rhs.align) {}
+            T* allocate(size_t) {
+                static_assert(sizeof(T) <= pinnedControlSize &&
+                                  alignof(T) <= alignof(std::max_align_t),
+                              "Control block doesn't fit in the storage");
+                return static_cast<T*>(storage);
+            }
+            void deallocate(T*, size_t) {
+                ::operator delete(storage, std::align_val_t(align));
+            }
+            template <typename U>
+            bool operator==(const PinnedAllocator<U>& rhs) const {
+                return storage == rhs.storage;
+            }
+            template <typename U>
+            bool operator!=(const PinnedAllocator<U>& rhs) const {
+                return storage != rhs.storage;
+            }
+        };
+        struct PinnedDeleter final {
+            void (*destroy)(ModuleFunctionBase* object);
+            std::shared_ptr<ModuleLibrary> library;
+            void operator()(ModuleFunctionBase* object) {
+                destroy(object);
+                library.reset();
+            }
+        };
+    }  // namespace Detail
+
+    static std::shared_ptr<ModuleFunctionBase>
+    constructPinned(const FactoryEntry& entry, ModuleInstance& instance,
+                    std::shared_ptr<ModuleLibrary> library) {
+        size_t align = (std::max)(entry.align, alignof(std::max_align_t));
+        size_t offset = (Detail::pinnedControlSize + entry.align - 1) /
+            entry.align * entry.align;
+        void* storage = ::operator new(offset + entry.size,
+                                       std::align_val_t(align));
+        ModuleFunctionBase* object;
+        try {
+            object = entry.construct(static_cast<char*>(storage) + offset,
+                                     instance);
+        } catch(...) {
+            ::operator delete(storage, std::align_val_t(align));
+            throw;
+        }
+        return std::shared_ptr<ModuleFunctionBase>(
+            object, Detail::PinnedDeleter{ entry.destroy, std::move(library) },
+            Detail::PinnedAllocator<ModuleFunctionBase>(storage, align));
+    }
+    std::shared_ptr<ModuleFunctionBase>
+    Detail::createFromEntry(const FactoryEntry& entry,
+                            ModuleInstance& instance,
+                            const std::shared_ptr<ModuleLibrary>& library) {
+        if(entry.construct)
+            return constructPinned(entry, instance, library);
+        return pin(entry.factory(instance), library);
+    }
+
+    bool ModuleSystem::replace(GUID guid,
+                               std::shared_ptr<ModuleLibrary> library) {
+        ModuleInfo info = library->info();
+        if(info.guid != guid) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Reload"),
+                       "Module ", info.name, " has GUID ", info.guid,
+                       " and can't replace module ", guid, '.');
+            return false;
+        }
+        auto old = mRegistry->replace(guid, std::move(library), *mMetrics);
+        if(!old) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Reload"),
+                       "No module's GUID is ", guid, '.');
             return false;
-        mInstances.emplace(guid, library);
+        }
+        old->retire();
+        BUS_REPORT(*mReporter, Info, BUS_SRCLOC("BusSystem.Reload"),
+                   "Reloaded module ", guid, " [name=", info.name,
+                   "], the old version has ", old.use_count() - 1,
+                   " references left.");
         return true;
     }
-    std::shared_ptr<ModuleFunctionBase>
-    ModuleSystem::instantiateImpl(FunctionId id) {
-        auto iter = mInstances.find(id.guid);
-        if(iter != mInstances.cend())
-            return iter->second->getInstance()->instantiate(id.name);
+    bool ModuleSystem::reloadModule(GUID guid, const fs::path& path) {
+        // The loader hands back the image that is already mapped, so the
+        // new version has to come from another path.
+        if(nativeLoaded(path)) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem.Reload"),
+                       "Module ", path.string(),
+                       " is already loaded, reloading it would reuse the old "
+                       "image. Copy the new version to another path.");
+            return false;
+        }
+        std::shared_ptr<ModuleLibrary> library;
+        try {
+            library = std::make_shared<NativeModule>(path, *this, mHandler);
+        } catch(...) {
+            mHandler();
+            return false;
+        }
+        return replace(guid, std::move(library));
+    }
+    bool ModuleSystem::reloadBuiltin(
+        const std::function<std::shared_ptr<ModuleInstance>(ModuleSystem&)>&
+            gen,
+        const FactoryEntry* factories, size_t count) {
+        LoadStats stats;
+        auto beg = Clock::now();
+        MemoryScope memory(createModuleMemory());
+        auto instance = gen(*this);
+        stats.initNs = elapsedNs(beg);
+        memory.label(instance->info());
+        GUID guid = instance->info().guid;
+        return replace(guid, std::make_shared<BuiltinWrapper>(
+                                 instance, stats, factories, count));
+    }
+    size_t ModuleSystem::drainRetired() {
+        size_t count = 0;
+        for(auto&& module : mRegistry->retired()) {
+            if(module.references == 0) {
+                BUS_REPORT(*mReporter, Info, BUS_SRCLOC("BusSystem.Reload"),
+                           "Unloaded old version of module ", module.guid,
+                           " [name=", module.name, "].");
+                continue;
+            }
+            ++count;
+            BUS_REPORT(*mReporter, Info, BUS_SRCLOC("BusSystem.Reload"),
+                       "Old version of module ", module.guid, " [name=",
+                       module.name, "] is draining, ", module.references,
+                       " references left.");
+        }
+        return count;
+    }
+
+    const FactoryEntry* ModuleSystem::findFactory(ModuleLibrary& library,
+                                                  Name interfaceName,
+                                                  uint64_t interfaceId,
+                                                  Name name) {
+        auto entry = library.factory(interfaceId, name);
+        // Ids are hashes, a collision must not become a bad static cast.
+        if(entry && entry->interfaceName &&
+           entry->interfaceName() == interfaceName)
+            return entry;
         return nullptr;
     }
+    std::shared_ptr<ModuleFunctionBase>
+    ModuleSystem::instantiateImpl(FunctionId id, Name interfaceName,
+                                  uint64_t interfaceId, bool& exact) {
+        auto snapshot = mRegistry->snapshot();
+        auto module = snapshot->find(id.guid);
+        if(!module)
+            return nullptr;
+        auto instance = module->library->getInstance();
+        if(!instance)
+            return nullptr;
+        auto entry =
+            findFactory(*module->library, interfaceName, interfaceId, id.name);
+        exact = entry != nullptr;
+        bool pinned = entry && entry->construct;
+        auto create = [&]() -> std::shared_ptr<ModuleFunctionBase> {
+            if(pinned)
+                return constructPinned(*entry, *instance, module->library);
+            return entry ? entry->factory(*instance)
+                         : instance->instantiate(id.name);
+        };
+        // With metrics on, the tracking wrapper holds the library instead.
+        auto library = pinned ? nullptr : module->library;
+        if(!mMetrics->enabled())
+            return pin(create(), std::move(library));
+        return mMetrics->track(module->metrics, id.name, create,
+                               std::move(library));
+    }
+    std::shared_ptr<ModuleLibrary>
+    ModuleSystem::resolve(FunctionId id, Name interfaceName,
+                          uint64_t interfaceId, const FactoryEntry*& direct,
+                          ModuleInstance*& target, FunctionFactory& factory,
+                          bool& exact) {
+        auto snapshot = mRegistry->snapshot();
+        auto module = snapshot->find(id.guid);
+        if(!module) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem"),
+                       "No module's GUID is ", id.guid, '.');
+            return nullptr;
+        }
+        auto instance = module->library->getInstance();
+        if(!instance) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem"), "Module ",
+                       id.guid, " [name=", module->name,
+                       "] failed to load.");
+            return nullptr;
+        }
+        auto name = mRegistry->intern(id.name);
+        auto entry =
+            findFactory(*module->library, interfaceName, interfaceId, name);
+        exact = entry != nullptr;
+        // Without a table entry, check what the module lists instead of
+        // creating a probe object. get may publish a newer snapshot, the
+        // old one keeps module alive.
+        Snapshot current = snapshot;
+        if(!entry && !mRegistry->get(current, interfaceName)
+                          .findFunction(GUIDName{ id.guid, name })) {
+            reportBadHandle(id, interfaceName);
+            return nullptr;
+        }
+        // The handle keeps the library loaded, each object pins it as well.
+        auto library = module->library;
+        if(entry) {
+            if(!mMetrics->enabled()) {
+                direct = entry;
+                target = instance.get();
+                return library;
+            }
+            factory = [metrics = mMetrics, module = module->metrics, name,
+                       entry, instance = instance.get(), library] {
+                // Objects built by construct pin the library themselves.
+                return metrics->track(
+                    module, name,
+                    [&] {
+                        return entry->construct ?
+                            constructPinned(*entry, *instance, library) :
+                            entry->factory(*instance);
+                    },
+                    entry->construct ? nullptr : library);
+            };
+            return library;
+        }
+        factory = instance->factory(name);
+        if(!factory) {
+            BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem"), "Module ",
+                       id.guid, " [name=", module->name,
+                       "] doesn't have function called ", id.name, '.');
+            return nullptr;
+        }
+        if(mMetrics->enabled())
+            factory = [metrics = mMetrics, module = module->metrics, name,
+                       create = std::move(factory), library] {
+                return metrics->track(module, name, create, library);
+            };
+        else
+            factory = [create = std::move(factory), library] {
+                return pin(create(), library);
+            };
+        return library;
+    }
+    void ModuleSystem::reportBadHandle(FunctionId id, Name interfaceName) {
+        BUS_REPORT(*mReporter, Error, BUS_SRCLOC("BusSystem"), "Function ",
+                   id.guid, '.', id.name, " isn't listed for interface ",
+                   interfaceName, '.');
+    }
+    void ModuleSystem::enableStats(bool enable) {
+        mMetrics->enable(enable);
+    }
+    void ModuleSystem::enableTrace(size_t capacity) {
+        mMetrics->enableTrace(capacity);
+    }
+    std::vector<ModuleStats> ModuleSystem::stats() {
+        return mMetrics->stats();
+    }
+    void ModuleSystem::exportStats(std::ostream& out) {
+        mMetrics->exportStats(out);
+    }
+    void ModuleSystem::exportTrace(std::ostream& out) {
+        mMetrics->exportTrace(out);
+    }
     std::vector<ModuleInfo> ModuleSystem::listModules() {
+        auto snapshot = mRegistry->snapshot();
         std::vector<ModuleInfo> res;
-        for(auto inst : mInstances)
-            res.emplace_back(inst.second->getInstance()->info());
+        res.reserve(snapshot->modules.size());
+        for(const auto& module : snapshot->modules)
+            res.emplace_back(module.second.library->info());
+        std::sort(res.begin(), res.end(),
+                  [](const ModuleInfo& lhs, const ModuleInfo& rhs) {
+                      return lhs.guid < rhs.guid;
+                  });
         return res;
     }
     std::vector<FunctionId> ModuleSystem::listFunctions(Name interfaceName) {
-        std::vector<FunctionId> funcs;
-        for(auto inst : mInstances) {
-            auto res = inst.second->getInstance()->list(interfaceName);
-            for(auto name : res)
-                funcs.emplace_back(inst.first, name);
-        }
-        return funcs;
+        auto snapshot = mRegistry->snapshot();
+        return mRegistry->get(snapshot, interfaceName).functions();
     }
     Reporter& ModuleSystem::getReporter() {
         return *mReporter;
     }
-    std::pair<GUID, std::string> ModuleSystem::parse(const std::string& name,
-                                                     Name interfaceName) {
+    static Result<std::pair<GUID, Name>> select(const IndexEntry& entry,
+                                                Name name, Name interfaceName,
+                                                Reporter* reporter) {
+        if(entry.count == 1)
+            return std::make_pair(entry.guid, entry.name);
+        if(entry.count == 0) {
+            if(reporter)
+                BUS_REPORT(*reporter, Error, BUS_SRCLOC("BusSystem"),
+                           "No function called ", name, " [interface=",
+                           interfaceName, "].");
+            BUS_RESULT_FAIL("BusSystem", "No function called");
+        }
+        if(reporter)
+            BUS_REPORT(*reporter, Error, BUS_SRCLOC("BusSystem"),
+                       "One or more multiply defined function.Please use "
+                       "GUID instead of name.");
+        BUS_RESULT_FAIL("BusSystem",
+                        "One or more multiply defined function.Please use "
+                        "GUID instead of name");
+    }
+    Result<std::pair<GUID, Name>>
+    ModuleSystem::lookup(Name name, Name interfaceName, Reporter* reporter) {
+        auto snapshot = mRegistry->snapshot();
+        const InterfaceIndex& index = mRegistry->get(snapshot, interfaceName);
         size_t pos = name.find_last_of('.');
-        if(pos == name.npos) {
-            GUID id;
-            unsigned count = 0;
-            for(auto inst : mInstances) {
-                auto res = inst.second->getInstance()->list(interfaceName);
-                for(auto&& func : res)
-                    if(func == name) {
-                        ++count, id = inst.first;
-                        if(count > 1)
-                            break;
-                    }
-                if(count > 1)
-                    break;
-            }
-            if(count == 1)
-                return std::make_pair(id, name);
-            if(count == 0)
-                mReporter->apply(ReportLevel::Error,
-                                 "No function called " + name + " [interface=" +
-                                     interfaceName.data() + "]",
-                                 BUS_SRCLOC("BusSystem"));
-            else
-                mReporter->apply(ReportLevel::Error,
-                                 "One or more multiply defined function.Please "
-                                 "use GUID instead of name.",
-                                 BUS_SRCLOC("BusSystem"));
-            return {};
-        } else {
-            auto pre = name.substr(0, pos);
-            auto nxt = name.substr(pos + 1);
-            GUID id(0, 0);
-            try {
-                id = str2GUID(pre);
-            } catch(...) {
-            }
-            if(id.first == 0 && id.second == 0) {
-                unsigned count = 0;
-                for(auto inst : mInstances) {
-                    auto res = inst.second->getInstance();
-                    if(res->info().name == pre) {
-                        for(auto func : res->list(interfaceName))
-                            if(nxt == func) {
-                                ++count;
-                                id = inst.first;
-                            }
-                    }
-                    if(count > 1)
-                        break;
-                }
-                if(count == 1)
-                    return std::make_pair(id, nxt);
-                if(count == 0)
-                    mReporter->apply(ReportLevel::Error,
-                                     "No function called " + name +
-                                         " [interface=" + interfaceName.data() +
-                                         "].",
-                                     BUS_SRCLOC("BusSystem"));
-                else
-                    mReporter->apply(
-                        ReportLevel::Error,
-                        "One or more multiply defined function.Please "
-                        "use GUID instead of name.",
-                        BUS_SRCLOC("BusSystem"));
-                return {};
-            } else {
-                auto iter = mInstances.find(id);
-                if(iter == mInstances.end()) {
-                    mReporter->apply(ReportLevel::Error,
-                                     "No module's GUID is " + pre + ".",
-                                     BUS_SRCLOC("BusSystem"));
-                    return {};
-                }
-                for(auto func :
-                    iter->second->getInstance()->list(interfaceName))
-                    if(func == nxt)
-                        return std::make_pair(id, nxt);
-                mReporter->apply(
-                    ReportLevel::Error,
-                    "Module " + pre + " [name=" +
-                        iter->second->getInstance()->info().name.data() +
-                        "] doesn't have function called " + nxt +
-                        " [interface=" + interfaceName.data() + "].",
-                    BUS_SRCLOC("BusSystem"));
-                return {};
-            }
+        if(pos == name.npos)
+            return select(index.findName(name), name, interfaceName,
+                          reporter);
+        auto pre = name.substr(0, pos);
+        auto nxt = name.substr(pos + 1);
+        GUID id(0, 0);
+        if(!tryParseGUID(pre, id) || (id.first == 0 && id.second == 0))
+            return select(index.findModule(NamePair{ pre, nxt }), name,
+                          interfaceName, reporter);
+        auto module = snapshot->find(id);
+        if(!module) {
+            if(reporter)
+                BUS_REPORT(*reporter, Error, BUS_SRCLOC("BusSystem"),
+                           "No module's GUID is ", pre, '.');
+            BUS_RESULT_FAIL("BusSystem", "No module has the GUID");
         }
+        if(auto func = index.findFunction(GUIDName{ id, nxt }))
+            return std::make_pair(id, *func);
+        if(reporter)
+            BUS_REPORT(*reporter, Error, BUS_SRCLOC("BusSystem"), "Module ",
+                       pre, " [name=", module->name,
+                       "] doesn't have function called ", nxt,
+                       " [interface=", interfaceName, "].");
+        BUS_RESULT_FAIL("BusSystem", "The module doesn't have the function");
+    }
+    Result<std::pair<GUID, Name>> ModuleSystem::tryParse(Name name,
+                                                         Name interfaceName) {
+        return lookup(name, interfaceName, nullptr);
+    }
+    std::pair<GUID, Name> ModuleSystem::parse(Name name, Name interfaceName) {
+        auto res = lookup(name, interfaceName, mReporter.get());
+        return res ? *res : std::pair<GUID, Name>{};
     }
     ModuleSystem::~ModuleSystem() {
+        mPreloader->wait();
 #ifdef BUS_MSVC_DELAYLOAD
         pReporter = nullptr;
 #endif
@@ -1,13 +1,47 @@
 #pragma once
 #include "BusCommon.hpp"
+#include <atomic>
 #include <functional>
+#include <iosfwd>
 #include <map>
+#include <memory>
+#include <mutex>
 
 namespace Bus {
+    struct LoadStats final {
+        uint64_t loadNs = 0;
+        uint64_t initNs = 0;
+    };
+
     class ModuleLibrary : private Unmoveable {
+    private:
+        std::atomic_bool mRetired{ false };
+
     public:
         virtual ~ModuleLibrary() = default;
         virtual std::shared_ptr<ModuleInstance> getInstance() = 0;
+        virtual LoadStats loadStats() const {
+            return {};
+        }
+        virtual ModuleInfo info();
+        virtual std::vector<Name> list(Name interfaceName);
+        // See ModuleDescriptor::nameStorage.
+        virtual std::shared_ptr<const void> nameStorage() const {
+            return nullptr;
+        }
+        // Direct factory for name as the interface with the given id, if the
+        // module exports one.
+        virtual const FactoryEntry* factory(uint64_t /*interfaceId*/,
+                                            Name /*name*/) {
+            return nullptr;
+        }
+        // Set once a newer version of the module has been registered.
+        void retire() {
+            mRetired = true;
+        }
+        bool retired() const {
+            return mRetired;
+        }
     };
 
     struct FunctionId final {
@@ -16,44 +50,279 @@ namespace Bus {
         FunctionId(GUID guid, Name name) : guid(guid), name(name) {}
     };
 
+    namespace Detail {
+        // Builds an object from a table entry. The object keeps library
+        // loaded until it is destroyed.
+        std::shared_ptr<ModuleFunctionBase>
+        createFromEntry(const FactoryEntry& entry, ModuleInstance& instance,
+                        const std::shared_ptr<ModuleLibrary>& library);
+    }  // namespace Detail
+
+    // Keeps its module loaded, since the factory may be module code. A
+    // handle to a replaced version stops creating objects.
+    template <typename T>
+    class FunctionHandle final {
+    private:
+        // Declared first so that it is released after the factory.
+        std::shared_ptr<ModuleLibrary> mLibrary;
+        // A table entry for T, called directly. The entry and the instance
+        // belong to mLibrary.
+        const FactoryEntry* mEntry = nullptr;
+        ModuleInstance* mInstance = nullptr;
+        // Used without an entry, or to record metrics.
+        FunctionFactory mFactory;
+        // The factory comes from a table entry for T, no cast is needed.
+        bool mExact = false;
+
+    public:
+        FunctionHandle() = default;
+        FunctionHandle(std::shared_ptr<ModuleLibrary> library,
+                       const FactoryEntry& entry, ModuleInstance& instance)
+            : mLibrary(std::move(library)), mEntry(&entry),
+              mInstance(&instance), mExact(true) {}
+        FunctionHandle(std::shared_ptr<ModuleLibrary> library,
+                       FunctionFactory factory, bool exact)
+            : mLibrary(std::move(library)), mFactory(std::move(factory)),
+              mExact(exact) {}
+        bool valid() const {
+            return (mEntry || mFactory) && mLibrary && !mLibrary->retired();
+        }
+        explicit operator bool() const {
+            return valid();
+        }
+        std::shared_ptr<T> create() const {
+            if(!valid())
+                return nullptr;
+            if(mEntry)
+                return std::static_pointer_cast<T>(
+                    Detail::createFromEntry(*mEntry, *mInstance, mLibrary));
+            if(mExact)
+                return std::static_pointer_cast<T>(mFactory());
+            return std::dynamic_pointer_cast<T>(mFactory());
+        }
+    };
+
     void addModuleSearchPath(const fs::path& path, Reporter& reporter);
 
     using ExceptionHandler = std::function<void()>;
 
+    enum class LoadPolicy { Lazy, Now };
+
+    class ModulePreloader;
+    class ModuleRegistry;
+    class SystemMetrics;
+    struct ModuleStats;
+    struct StaticModuleDesc;
+    class FunctionPool;
+    class MemoryRegistry;
+    class ModuleMemory;
+    struct MemoryConfig;
+    struct MemoryStats;
+    struct IsolationConfig;
+    struct Error;
+    class MessageBus;
+    class Scheduler;
+    template <typename T>
+    class Result;
+    template <typename T>
+    class PooledHandle;
+    struct PipelineConfig;
+    template <typename T>
+    class Pipeline;
+
     class ModuleSystem final : private Unmoveable {
     private:
+        friend class LazyModule;
         std::shared_ptr<Reporter> mReporter;
         ExceptionHandler mHandler;
-        std::map<GUID, std::shared_ptr<ModuleLibrary>> mInstances;
-        std::shared_ptr<ModuleFunctionBase> instantiateImpl(FunctionId id);
+        std::atomic<LoadPolicy> mPolicy;
+        std::shared_ptr<ModulePreloader> mPreloader;
+        std::shared_ptr<SystemMetrics> mMetrics;
+        std::shared_ptr<ModuleRegistry> mRegistry;
+        std::shared_ptr<MemoryRegistry> mMemory;
+        std::shared_ptr<MessageBus> mBus;
+        // Last, so that running tasks finish before modules unload.
+        std::once_flag mSchedulerFlag;
+        std::shared_ptr<Scheduler> mScheduler;
+        std::shared_ptr<ModuleFunctionBase>
+        instantiateImpl(FunctionId id, Name interfaceName,
+                        uint64_t interfaceId, bool& exact);
+        // The table entry for the function, if its interface name matches
+        // and not just the id.
+        static const FactoryEntry* findFactory(ModuleLibrary& library,
+                                               Name interfaceName,
+                                               uint64_t interfaceId,
+                                               Name name);
         bool load(std::shared_ptr<ModuleLibrary> library);
+        size_t load(const std::vector<std::shared_ptr<ModuleLibrary>>& batch);
+        // Called by LazyModule once it has loaded its library.
+        void recordLoad(GUID guid, const ModuleLibrary& library,
+                        const LoadStats& stats);
+        bool replace(GUID guid, std::shared_ptr<ModuleLibrary> library);
+        // Sets direct and target if the handle can call the table entry
+        // itself, and factory otherwise.
+        std::shared_ptr<ModuleLibrary>
+        resolve(FunctionId id, Name interfaceName, uint64_t interfaceId,
+                const FactoryEntry*& direct, ModuleInstance*& target,
+                FunctionFactory& factory, bool& exact);
+        // Shared by parse and tryParse. Misses are reported with the name
+        // and the module if reporter isn't null.
+        Result<std::pair<GUID, Name>> lookup(Name name, Name interfaceName,
+                                             Reporter* reporter);
+        void reportBadHandle(FunctionId id, Name interfaceName);
+        void reportBadStage(FunctionId id, Name interfaceName);
+        void reportBadStage(Name name, Name interfaceName, const Error& error);
+        std::shared_ptr<FunctionPool>
+        makePool(FunctionId id, Name interfaceName, uint64_t interfaceId,
+                 size_t chunkSlots);
 
     public:
         explicit ModuleSystem(std::shared_ptr<Reporter> reporter,
                               const ExceptionHandler& handler);
         ~ModuleSystem();
         Reporter& getReporter();
+        // Topics shared by every module, see BusMessage.hpp.
+        MessageBus& getMessageBus();
+        // Thread pool shared by every module, started on first use. See
+        // BusScheduler.hpp.
+        Scheduler& getScheduler();
+        void setLoadPolicy(LoadPolicy policy);
+        LoadPolicy getLoadPolicy() const;
+        void preloadModules(const fs::path& dir);
+        void waitPreload();
         bool loadModuleFile(const fs::path& path);
+        bool loadModuleLazily(const fs::path& path);
+        // Runs the module in a separate host process, see BusIsolated.hpp.
+        bool loadModuleIsolated(const fs::path& path);
+        bool loadModuleIsolated(const fs::path& path,
+                                const IsolationConfig& config);
+        // Loads every module in dir, initializing independent ones in
+        // parallel in the order given by ModuleInfo::dependencies.
+        size_t loadModuleDirectory(const fs::path& dir, size_t threads = 0);
+        bool generateManifest(const fs::path& path,
+                              const std::vector<Name>& interfaces = {});
+        // Registers every module in dir without loading it, using a binary
+        // catalog that is refreshed for modules changed since the last run.
+        size_t loadCatalog(const fs::path& catalog, const fs::path& dir);
+        // Use Bus::loadStaticModules from BusStatic.hpp instead.
+        size_t loadStaticModules(const StaticModuleDesc* const* begin,
+                                 const StaticModuleDesc* const* end);
+        // factories is an optional table as returned by busGetFactories,
+        // see BusModule.hpp. It must outlive the module.
         bool wrapBuiltin(
             const std::function<std::shared_ptr<ModuleInstance>(ModuleSystem&)>&
-                gen);
+                gen,
+            const FactoryEntry* factories = nullptr, size_t count = 0);
+        // Switches the module registered as guid to a new version. Objects
+        // created from the old version keep it loaded until released.
+        bool reloadModule(GUID guid, const fs::path& path);
+        bool reloadBuiltin(
+            const std::function<std::shared_ptr<ModuleInstance>(ModuleSystem&)>&
+                gen,
+            const FactoryEntry* factories = nullptr, size_t count = 0);
+        // Reports replaced versions that are still draining and returns
+        // their count.
+        size_t drainRetired();
         template <typename T>
         std::shared_ptr<T> instantiate(FunctionId id) {
-            return std::dynamic_pointer_cast<T>(instantiateImpl(id));
+            bool exact = false;
+            auto res = instantiateImpl(id, T::getInterface(),
+                                       interfaceId(T::getInterface()), exact);
+            if(exact)
+                return std::static_pointer_cast<T>(std::move(res));
+            return std::dynamic_pointer_cast<T>(std::move(res));
         }
+        // Applies to modules initialized afterwards, see BusMemory.hpp.
+        void setMemoryConfig(const MemoryConfig& config);
+        // Used by loaders to give a module its memory resource.
+        std::shared_ptr<ModuleMemory> createModuleMemory();
+        bool setMemoryLimit(GUID guid, size_t softLimit);
+        std::vector<MemoryStats> memoryStats();
+        void enableStats(bool enable);
+        void enableTrace(size_t capacity);
+        std::vector<ModuleStats> stats();
+        void exportStats(std::ostream& out);
+        // Drains the events recorded since the last export.
+        void exportTrace(std::ostream& out);
         std::vector<ModuleInfo> listModules();
         std::vector<FunctionId> listFunctions(Name interfaceName);
         template <typename T>
         std::vector<FunctionId> list() {
             return listFunctions(T::getInterface());
         }
-        std::pair<GUID, std::string> parse(const std::string& name,
-                                           Name interfaceName);
+        std::pair<GUID, Name> parse(Name name, Name interfaceName);
+        // Like parse, but misses are returned instead of reported. See
+        // BusResult.hpp.
+        Result<std::pair<GUID, Name>> tryParse(Name name, Name interfaceName);
         template <typename T>
-        std::shared_ptr<T> instantiateByName(const std::string& name) {
+        std::shared_ptr<T> instantiateByName(Name name) {
             auto id = parse(name, T::getInterface());
             FunctionId fid(id.first, id.second);
             return instantiate<T>(fid);
         }
+        template <typename T>
+        FunctionHandle<T> getHandle(FunctionId id) {
+            const FactoryEntry* entry = nullptr;
+            ModuleInstance* instance = nullptr;
+            FunctionFactory factory;
+            bool exact = false;
+            auto library =
+                resolve(id, T::getInterface(), interfaceId(T::getInterface()),
+                        entry, instance, factory, exact);
+            if(!library)
+                return {};
+            if(entry)
+                return FunctionHandle<T>(std::move(library), *entry,
+                                         *instance);
+            return FunctionHandle<T>(std::move(library), std::move(factory),
+                                     exact);
+        }
+        template <typename T>
+        FunctionHandle<T> getHandleByName(Name name) {
+            auto id = parse(name, T::getInterface());
+            return getHandle<T>(FunctionId(id.first, id.second));
+        }
+        // Recycling allocator for one function, see BusPool.hpp. Needs the
+        // module to export a factory table.
+        template <typename T>
+        PooledHandle<T> getPool(FunctionId id, size_t chunkSlots = 64) {
+            return PooledHandle<T>(makePool(id, T::getInterface(),
+                                            interfaceId(T::getInterface()),
+                                            chunkSlots));
+        }
+        // Instantiates every stage once and chains them in order, see
+        // BusPipeline.hpp.
+        template <typename T>
+        std::shared_ptr<Pipeline<T>>
+        getPipeline(const std::vector<FunctionId>& ids,
+                    const PipelineConfig& config) {
+            std::vector<std::shared_ptr<T>> stages;
+            for(auto&& id : ids) {
+                auto stage = instantiate<T>(id);
+                if(!stage) {
+                    reportBadStage(id, T::getInterface());
+                    return nullptr;
+                }
+                stages.emplace_back(std::move(stage));
+            }
+            return std::make_shared<Pipeline<T>>(std::move(stages), ids,
+                                                 config, *this);
+        }
+        template <typename T>
+        std::shared_ptr<Pipeline<T>>
+        getPipelineByName(const std::vector<Name>& names,
+                          const PipelineConfig& config) {
+            std::vector<FunctionId> ids;
+            for(auto&& name : names) {
+                // Reported once here, not again as a stage with no id.
+                auto id = tryParse(name, T::getInterface());
+                if(!id) {
+                    reportBadStage(name, T::getInterface(), id.error());
+                    return nullptr;
+                }
+                ids.emplace_back(id->first, id->second);
+            }
+            return getPipeline<T>(ids, config);
+        }
     };
 }  // namespace Bus
@@ -0,0 +1,149 @@
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+#include "BusSynthetic.hpp"
+
+using namespace BusBench;
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t modules = options.get("modules", 64);
+    size_t interfaces = options.get("interfaces", 4);
+    size_t functions = options.get("functions", 16);
+    size_t ops = options.get("ops", 100000);
+    size_t maxThreads = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+    std::vector<size_t> threadCounts{ 1 };
+    if(maxThreads > 1)
+        threadCounts.push_back(maxThreads);
+
+    Report report("core");
+    report.config("modules", modules);
+    report.config("interfaces", interfaces);
+    report.config("functions", functions);
+
+    auto reporter = std::make_shared<Reporter>();
+    std::atomic_uint64_t reports{ 0 };
+    reporter->addAction(ReportLevel::Info,
+                        [&](ReportLevel, const std::string&,
+                            const SourceLocation&) { ++reports; });
+    ModuleSystem system(reporter, [] { std::terminate(); });
+
+    auto beg = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < modules; ++i)
+        system.wrapBuiltin([&](ModuleSystem& sys) {
+            return std::make_shared<SyntheticInstance>(
+                "", sys, i, interfaces, functions);
+        });
+    report.add("wrapBuiltin", 1, modules,
+               std::chrono::duration<double, std::nano>(
+                   std::chrono::steady_clock::now() - beg)
+                       .count() /
+                   static_cast<double>(modules));
+
+#ifdef BUS_SYNTHETIC_MODULE
+    {
+        fs::path source = BUS_SYNTHETIC_MODULE;
+        auto dir = fs::temp_directory_path() /
+            ("BusBench" + std::to_string(std::chrono::steady_clock::now()
+                                             .time_since_epoch()
+                                             .count()));
+        fs::create_directories(dir);
+        std::vector<std::string> files;
+        for(size_t i = 0; i < modules; ++i) {
+            files.push_back(syntheticFile(dir, i, interfaces, functions,
+                                          source.extension()));
+            fs::copy_file(source, files.back());
+        }
+        {
+            ModuleSystem native(reporter, [] { std::terminate(); });
+            native.setLoadPolicy(LoadPolicy::Now);
+            beg = std::chrono::steady_clock::now();
+            for(auto&& file : files)
+                if(!native.loadModuleFile(file))
+                    return 1;
+            report.add("loadModuleFile", 1, modules,
+                       std::chrono::duration<double, std::nano>(
+                           std::chrono::steady_clock::now() - beg)
+                               .count() /
+                           static_cast<double>(modules));
+        }
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+#endif
+
+    std::vector<std::string> interfaceNames;
+    for(size_t i = 0; i < interfaces; ++i)
+        interfaceNames.push_back("Bench.Interface" + std::to_string(i));
+    std::vector<std::string> qualified, plain;
+    for(size_t i = 0; i < modules; ++i)
+        for(size_t j = 0; j < functions; ++j)
+            qualified.push_back("Synthetic" + std::to_string(i) + ".F" +
+                                std::to_string(j));
+    for(size_t j = 0; j < functions; ++j)
+        plain.push_back("F" + std::to_string(j));
+    std::vector<FunctionHandle<BenchFunction>> handles;
+    for(auto&& name : qualified)
+        handles.push_back(system.getHandleByName<BenchFunction>(name));
+    auto pick = [](size_t thread, uint64_t i, size_t size) {
+        return static_cast<size_t>((i * 2654435761ULL + thread * 40503ULL) %
+                                   size);
+    };
+
+    for(size_t threads : threadCounts) {
+        uint64_t listOps = (std::max)(ops / (modules * functions), size_t(1));
+        report.add("listFunctions", threads, listOps,
+                   measure(threads, listOps, [&](size_t t, uint64_t i) {
+                       auto res = system.listFunctions(
+                           interfaceNames[pick(t, i, interfaces)]);
+                       if(res.size() != modules * functions)
+                           std::terminate();
+                   }));
+        report.add("parse", threads, ops,
+                   measure(threads, ops, [&](size_t t, uint64_t i) {
+                       auto& name = qualified[pick(t, i, qualified.size())];
+                       auto res =
+                           system.parse(name, BenchFunction::getInterface());
+                       if(res.second.empty())
+                           std::terminate();
+                   }));
+        report.add("instantiateByName", threads, ops,
+                   measure(threads, ops, [&](size_t t, uint64_t i) {
+                       if(!system.instantiateByName<BenchFunction>(
+                              qualified[pick(t, i, qualified.size())]))
+                           std::terminate();
+                   }));
+        report.add("instantiate", threads, ops,
+                   measure(threads, ops, [&](size_t t, uint64_t i) {
+                       size_t index = pick(t, i, qualified.size());
+                       FunctionId id(syntheticGUID(index / functions),
+                                     plain[index % functions]);
+                       if(!system.instantiate<BenchFunction>(id))
+                           std::terminate();
+                   }));
+        system.enableStats(true);
+        system.enableTrace(1024);
+        report.add("instantiate+stats", threads, ops,
+                   measure(threads, ops, [&](size_t t, uint64_t i) {
+                       size_t index = pick(t, i, qualified.size());
+                       FunctionId id(syntheticGUID(index / functions),
+                                     plain[index % functions]);
+                       if(!system.instantiate<BenchFunction>(id))
+                           std::terminate();
+                   }));
+        system.enableTrace(0);
+        system.enableStats(false);
+        report.add("FunctionHandle::create", threads, ops,
+                   measure(threads, ops, [&](size_t t, uint64_t i) {
+                       if(!handles[pick(t, i, handles.size())].create())
+                           std::terminate();
+                   }));
+        report.add("Reporter::apply", threads, ops,
+                   measure(threads, ops, [&](size_t, uint64_t) {
+                       reporter->apply(ReportLevel::Info, "benchmark",
+                                       BUS_SRCLOC("BusBench"));
+                   }));
+    }
+    report.write(std::cout);
+    return 0;
+}
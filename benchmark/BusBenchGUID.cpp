@@ -0,0 +1,108 @@
+#include "BusBenchmark.hpp"
+#include <iomanip>
+#include <regex>
+#include <sstream>
+#include <unordered_map>
+
+using namespace BusBench;
+using namespace Bus;
+
+// str2GUID and GUID2Str as they were before the allocation-free versions,
+// kept as the baseline.
+namespace Baseline {
+    GUID str2GUID(const std::string& guid) {
+        std::regex pat("\\{[A-F0-9]{8}(-[A-F0-9]{4}){3}-[A-F0-9]{12}\\}",
+                       std::regex::ECMAScript | std::regex::nosubs);
+        if(std::regex_match(guid, pat)) {
+            char ch[32];
+            int cnt = 0;
+            auto cast = [](char c) { return c - (c <= '9' ? '0' : 'A' - 10); };
+            for(char c : guid)
+                if(isalnum(c))
+                    ch[cnt++] = cast(c);
+            GUID res(0, 0);
+            for(int i = 0; i < 16; ++i)
+                res.first = res.first * 16ULL + ch[i];
+            for(int i = 16; i < 32; ++i)
+                res.second = res.second * 16ULL + ch[i];
+            return res;
+        } else
+            throw std::logic_error("Bad GUID" + guid);
+    }
+    std::string GUID2Str(GUID guid) {
+        std::stringstream ss;
+        ss << std::setw(16) << std::setbase(16) << std::setfill('0')
+           << std::noshowbase << std::uppercase << guid.first;
+        ss << std::setw(16) << std::setbase(16) << std::setfill('0')
+           << std::noshowbase << std::uppercase << guid.second;
+        std::string str = ss.str();
+        return '{' + str.substr(0, 8) + '-' + str.substr(8, 4) + '-' +
+            str.substr(12, 4) + '-' + str.substr(16, 4) + '-' +
+            str.substr(20, 12) + '}';
+    }
+}  // namespace Baseline
+
+// GUID parsing, formatting and hashing, against the baseline.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 1000000);
+    size_t count = options.get("guids", 1024);
+
+    Report report("guid");
+    report.config("guids", count);
+
+    std::vector<GUID> guids;
+    std::vector<std::string> strings;
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    auto next = [&] {
+        state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+        return state;
+    };
+    for(size_t i = 0; i < count; ++i) {
+        guids.emplace_back(next(), next());
+        strings.push_back(GUID2Str(guids.back()));
+    }
+    for(size_t i = 0; i < count; ++i)
+        if(Baseline::GUID2Str(guids[i]) != strings[i] ||
+           Baseline::str2GUID(strings[i]) != guids[i])
+            return 1;
+    std::unordered_map<GUID, size_t, GUIDHash> map;
+    for(size_t i = 0; i < count; ++i)
+        map.emplace(guids[i], i);
+
+    uint64_t sink = 0;
+    report.add("tryParseGUID", 1, ops, measure(1, ops, [&](size_t, uint64_t i) {
+                   GUID res(0, 0);
+                   sink += tryParseGUID(strings[i % count], res);
+                   sink += res.first;
+               }));
+    report.add("str2GUID", 1, ops, measure(1, ops, [&](size_t, uint64_t i) {
+                   sink += str2GUID(strings[i % count]).first;
+               }));
+    report.add("str2GUID/baseline", 1, ops,
+               measure(1, ops, [&](size_t, uint64_t i) {
+                   sink += Baseline::str2GUID(strings[i % count]).first;
+               }));
+    report.add("GUID2Str(buf)", 1, ops,
+               measure(1, ops, [&](size_t, uint64_t i) {
+                   char buf[guidStrSize];
+                   GUID2Str(guids[i % count], buf);
+                   sink += static_cast<unsigned char>(buf[1]);
+               }));
+    report.add("GUID2Str", 1, ops, measure(1, ops, [&](size_t, uint64_t i) {
+                   sink += GUID2Str(guids[i % count]).size();
+               }));
+    report.add("GUID2Str/baseline", 1, ops,
+               measure(1, ops, [&](size_t, uint64_t i) {
+                   sink += Baseline::GUID2Str(guids[i % count]).size();
+               }));
+    report.add("GUIDHash", 1, ops, measure(1, ops, [&](size_t, uint64_t i) {
+                   sink += GUIDHash{}(guids[i % count]);
+               }));
+    report.add("unordered_map::find", 1, ops,
+               measure(1, ops, [&](size_t, uint64_t i) {
+                   sink += map.find(guids[i % count])->second;
+               }));
+    report.write(std::cout);
+    return sink == 0;
+}
@@ -0,0 +1,55 @@
+#include "BusBenchmark.hpp"
+#include "BusIsolated.hpp"
+#include "BusReporter.hpp"
+#include "BusSystem.hpp"
+
+using namespace BusBench;
+using namespace Bus;
+
+// A call into the module in process against the same call through an
+// isolated host, by payload size, and how long a host takes to start.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 100000);
+    size_t threads = (std::max)(options.get("threads", 1), size_t(1));
+    size_t starts = options.get("starts", 8);
+
+    Report report("isolated");
+    auto reporter = std::make_shared<Reporter>();
+    ModuleSystem local(reporter, [] {});
+    ModuleSystem isolated(reporter, [] {});
+    if(!local.loadModuleFile(BUS_ISOLATED_MODULE) ||
+       !isolated.loadModuleIsolated(BUS_ISOLATED_MODULE))
+        return 1;
+
+    uint64_t sink = 0;
+    for(size_t size : { size_t(16), size_t(1024), size_t(16384) }) {
+        auto suffix = "/bytes=" + std::to_string(size);
+        for(auto* system : { &local, &isolated }) {
+            std::vector<std::shared_ptr<IsolatedFunction>> funcs;
+            std::vector<std::vector<char>> in, out;
+            for(size_t t = 0; t < threads; ++t) {
+                funcs.push_back(
+                    system->instantiateByName<IsolatedFunction>("Echo"));
+                in.emplace_back(size, 'x');
+                out.emplace_back(size);
+            }
+            double ns = measure(threads, ops, [&](size_t t, uint64_t) {
+                funcs[t]->invoke(in[t].data(), size, out[t].data(), size);
+            });
+            report.add((system == &local ? "in process" : "isolated") +
+                           suffix,
+                       threads, ops, ns);
+            for(auto&& buffer : out)
+                sink += static_cast<uint64_t>(buffer[size - 1]);
+        }
+    }
+
+    report.add("loadModuleIsolated", 1, starts,
+               measure(1, starts, [&](size_t, uint64_t) {
+                   ModuleSystem system(reporter, [] {});
+                   sink += system.loadModuleIsolated(BUS_ISOLATED_MODULE);
+               }));
+    report.write(std::cout);
+    return sink == 0;
+}
@@ -0,0 +1,68 @@
+#include "BusBenchmark.hpp"
+#include "BusMemory.hpp"
+#include "BusReporter.hpp"
+#include "BusSystem.hpp"
+
+using namespace BusBench;
+using namespace Bus;
+
+// Allocation through a module's memory resource against the global
+// allocator, and the cost of creating a module's memory.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 200000);
+    size_t size = options.get("size", 64);
+    size_t live = (std::max)(options.get("live", 64), size_t(1));
+    size_t maxThreads = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+
+    Report report("memory");
+    report.config("size", size);
+    report.config("live", live);
+
+    ModuleSystem system(std::make_shared<Reporter>(), [] {});
+    // Each thread keeps live blocks and replaces the oldest one per op.
+    auto churn = [&](std::pmr::memory_resource& resource, size_t threads) {
+        std::vector<std::vector<void*>> blocks(threads);
+        for(auto&& thread : blocks)
+            for(size_t i = 0; i < live; ++i)
+                thread.push_back(resource.allocate(size));
+        double res = measure(threads, ops, [&](size_t t, uint64_t i) {
+            void*& block = blocks[t][i % live];
+            resource.deallocate(block, size);
+            block = resource.allocate(size);
+        });
+        for(auto&& thread : blocks)
+            for(void* block : thread)
+                resource.deallocate(block, size);
+        return res;
+    };
+    std::vector<size_t> threadCounts;
+    for(size_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    for(size_t threads : threadCounts) {
+        report.add("new_delete_resource", threads, ops,
+                   churn(*std::pmr::new_delete_resource(), threads));
+        for(auto kind : { MemoryKind::Pool, MemoryKind::Monotonic }) {
+            MemoryConfig config;
+            config.kind = kind;
+            system.setMemoryConfig(config);
+            auto memory = system.createModuleMemory();
+            report.add(kind == MemoryKind::Pool ? "ModuleMemory/pool" :
+                                                  "ModuleMemory/monotonic",
+                       threads, ops, churn(*memory, threads));
+        }
+    }
+
+    size_t modules = (std::min)(ops, size_t(4096));
+    system.setMemoryConfig(MemoryConfig{});
+    std::vector<std::shared_ptr<ModuleMemory>> memories;
+    memories.reserve(modules);
+    report.add("createModuleMemory", 1, modules,
+               measure(1, modules, [&](size_t, uint64_t) {
+                   memories.push_back(system.createModuleMemory());
+               }));
+    report.write(std::cout);
+    return memories.size() != modules;
+}
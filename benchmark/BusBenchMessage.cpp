@@ -0,0 +1,124 @@
+#include "BusBenchmark.hpp"
+#include "BusMessage.hpp"
+#include <algorithm>
+
+using namespace BusBench;
+using namespace Bus;
+
+// Publishing to a topic with a growing number of subscribers (1:N), one
+// message at a time and in batches, and from several publishers to one
+// subscriber (N:1). Each subscriber drains on its own thread. The round
+// trip sends a timestamp to an echo thread and back.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 200000);
+    size_t batchSize = (std::max)(options.get("batch", 32), size_t(1));
+    size_t capacity = options.get("capacity", 1024);
+    size_t maxSubscribers = options.get("subscribers", 4);
+    size_t threads = (std::max)(options.get("threads", 1), size_t(1));
+    size_t publishers = (std::max)(options.get("publishers", 4), size_t(1));
+    size_t rounds = (std::max)(options.get("rounds", 20000), size_t(1));
+
+    Report report("message");
+    report.config("batch", batchSize);
+    report.config("capacity", capacity);
+
+    MessageBus bus(std::make_shared<Reporter>());
+    std::atomic_uint64_t sink{ 0 };
+    auto run = [&](const std::string& name, size_t subscribers,
+                   OverflowPolicy policy, bool batched, size_t threads) {
+        auto topic = name + '/' + std::to_string(subscribers) + '/' +
+            std::to_string(threads);
+        std::atomic_bool stop{ false };
+        std::vector<std::thread> consumers;
+        for(size_t i = 0; i < subscribers; ++i) {
+            auto subscription =
+                bus.subscribe<uint64_t>(topic, capacity, policy);
+            consumers.emplace_back(
+                [&, subscription = std::move(subscription)]() mutable {
+                    uint64_t sum = 0;
+                    auto add = [&](const uint64_t& value) { sum += value; };
+                    while(!stop)
+                        if(!subscription.poll(add, 256))
+                            subscription.wait(std::chrono::milliseconds(1));
+                    // What was published before stop still counts.
+                    while(subscription.poll(add, 256))
+                        continue;
+                    sink += sum;
+                });
+        }
+        auto publisher = bus.publisher<uint64_t>(topic);
+        auto message = std::make_shared<const uint64_t>(1);
+        std::vector<std::shared_ptr<const uint64_t>> batch(batchSize,
+                                                            message);
+        uint64_t count = batched ? (ops + batchSize - 1) / batchSize : ops;
+        double ns = measure(threads, count, [&](size_t, uint64_t) {
+            if(batched)
+                publisher.publish(batch);
+            else
+                publisher.publish(message);
+        });
+        stop = true;
+        for(auto&& consumer : consumers)
+            consumer.join();
+        // Per message, not per call.
+        report.add(name + "/subscribers=" + std::to_string(subscribers),
+                   threads, count * (batched ? batchSize : 1),
+                   batched ? ns / static_cast<double>(batchSize) : ns);
+    };
+    for(size_t subscribers = 0; subscribers <= maxSubscribers;
+        subscribers = subscribers ? subscribers * 2 : 1) {
+        run("publish/drop", subscribers, OverflowPolicy::Drop, false,
+            threads);
+        run("publish/block", subscribers, OverflowPolicy::Block, false,
+            threads);
+        run("publishBatch/block", subscribers, OverflowPolicy::Block, true,
+            threads);
+    }
+    run("publish/block", 1, OverflowPolicy::Block, false, publishers);
+    run("publishBatch/block", 1, OverflowPolicy::Block, true, publishers);
+
+    {
+        using Clock = std::chrono::steady_clock;
+        auto ping = bus.subscribe<int64_t>("ping", capacity);
+        auto pong = bus.subscribe<int64_t>("pong", capacity);
+        std::atomic_bool stop{ false };
+        std::thread echo([&] {
+            auto publisher = bus.publisher<int64_t>("pong");
+            auto forward = [&](const int64_t& sent) {
+                publisher.publish(int64_t(sent));
+            };
+            while(!stop)
+                if(!ping.poll(forward, 256))
+                    ping.wait(std::chrono::milliseconds(1));
+        });
+        auto publisher = bus.publisher<int64_t>("ping");
+        std::vector<double> samples;
+        samples.reserve(rounds);
+        int64_t sent = 0;
+        auto receive = [&](const int64_t& value) { sent = value; };
+        for(size_t i = 0; i < rounds; ++i) {
+            publisher.publish(
+                int64_t(Clock::now().time_since_epoch().count()));
+            while(!pong.poll(receive, 1))
+                pong.wait(std::chrono::milliseconds(1));
+            samples.push_back(std::chrono::duration<double, std::nano>(
+                                  Clock::now().time_since_epoch() -
+                                  Clock::duration(sent))
+                                  .count());
+        }
+        stop = true;
+        echo.join();
+        double total = 0.0;
+        for(double sample : samples)
+            total += sample;
+        std::sort(samples.begin(), samples.end());
+        report.add("roundTrip/mean", 1, rounds,
+                   total / static_cast<double>(rounds));
+        report.add("roundTrip/p50", 1, rounds, samples[rounds / 2]);
+        report.add("roundTrip/p99", 1, rounds, samples[rounds * 99 / 100]);
+        sink += rounds;
+    }
+    report.write(std::cout);
+    return sink == 0 && maxSubscribers != 0;
+}
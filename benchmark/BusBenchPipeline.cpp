@@ -0,0 +1,83 @@
+#include "BusBenchmark.hpp"
+#include "BusPipeline.hpp"
+#include "BusReporter.hpp"
+#include "BusStatic.hpp"
+
+using namespace BusBench;
+using namespace Bus;
+
+namespace BusBench {
+    class FloatStage : public BatchFunction<float> {
+    protected:
+        explicit FloatStage(ModuleInstance& instance)
+            : BatchFunction<float>(instance) {}
+
+    public:
+        static Name getInterface() {
+            return "Bench.FloatStage";
+        }
+    };
+
+    class Scale final : public FloatStage {
+    public:
+        explicit Scale(ModuleInstance& instance) : FloatStage(instance) {}
+        void apply(float& item) override {
+            item = item * 1.0001f + 0.5f;
+        }
+        void process(float* items, size_t count) override {
+            for(size_t i = 0; i < count; ++i)
+                items[i] = items[i] * 1.0001f + 0.5f;
+        }
+    };
+}  // namespace BusBench
+
+BUS_STATIC_MODULE(BusBenchPipeline, "BusBenchPipeline", GUID(0x919E, 2),
+                  "1.0.0", "", "",
+                  BUS_STATIC_FUNCTION(FloatStage, "Scale", Scale));
+
+// A chain of stages over a buffer: one virtual call per item and stage,
+// the pipeline batch by batch, and the pipeline on the scheduler.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = (std::max)(options.get("ops", 200), size_t(1));
+    size_t items = options.get("items", 1 << 16);
+    size_t stageCount = (std::max)(options.get("stages", 4), size_t(1));
+
+    Report report("pipeline");
+    report.config("items", items);
+    report.config("stages", stageCount);
+
+    ModuleSystem system(std::make_shared<Reporter>(), [] {});
+    loadStaticModules(system);
+    std::vector<Name> names(stageCount, "Scale");
+    std::vector<float> data(items, 1.0f);
+    double perItem = static_cast<double>(items ? items : 1);
+
+    std::vector<std::shared_ptr<FloatStage>> stages;
+    for(size_t i = 0; i < stageCount; ++i)
+        stages.push_back(system.instantiateByName<FloatStage>("Scale"));
+    report.add("apply per item", 1, ops * items,
+               measure(1, ops, [&](size_t, uint64_t) {
+                   for(auto&& stage : stages)
+                       for(auto&& item : data)
+                           stage->apply(item);
+               }) / perItem);
+
+    for(size_t batchSize : { size_t(64), size_t(1024), size_t(16384) })
+        for(bool parallel : { false, true }) {
+            PipelineConfig config;
+            config.batchSize = batchSize;
+            config.parallel = parallel;
+            auto pipeline = system.getPipelineByName<FloatStage>(names, config);
+            if(!pipeline)
+                return 1;
+            report.add(std::string(parallel ? "parallel" : "sequential") +
+                           "/batch=" + std::to_string(batchSize),
+                       1, ops * items,
+                       measure(1, ops, [&](size_t, uint64_t) {
+                           pipeline->run(data);
+                       }) / perItem);
+        }
+    report.write(std::cout);
+    return data.front() == 1.0f;
+}
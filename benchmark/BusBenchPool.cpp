@@ -0,0 +1,128 @@
+#include "BusBenchmark.hpp"
+#include "BusPool.hpp"
+#include "BusReporter.hpp"
+#include "BusSynthetic.hpp"
+#include <cstdlib>
+#include <iterator>
+#include <new>
+
+using namespace BusBench;
+
+// Every heap allocation of the process, including the ones Bus makes.
+static std::atomic_uint64_t allocations{ 0 };
+
+static void* allocate(std::size_t size, std::size_t align) {
+    ++allocations;
+    size = (std::max)(size, std::size_t(1));
+#ifdef _MSC_VER
+    void* res = _aligned_malloc(size, align);
+#else
+    void* res = std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+    if(!res)
+        throw std::bad_alloc();
+    return res;
+}
+static void deallocate(void* ptr) noexcept {
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size, alignof(std::max_align_t));
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    return allocate(size, static_cast<std::size_t>(align));
+}
+void operator delete(void* ptr) noexcept {
+    deallocate(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+    deallocate(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    deallocate(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    deallocate(ptr);
+}
+
+namespace {
+    class TableFunction final : public BenchFunction {
+    public:
+        explicit TableFunction(ModuleInstance& instance)
+            : BenchFunction(instance) {}
+        uint64_t value() override {
+            return 7;
+        }
+    };
+
+    const FactoryEntry table[] = {
+        BUS_FACTORY(BenchFunction, "F0", TableFunction),
+    };
+}  // namespace
+
+// Creating and dropping one function's instances through instantiate,
+// a FunctionHandle, a pool and pooled batches, with the heap allocations
+// each object costs.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 1000000);
+    size_t batch = (std::max)(options.get("batch", 1000), size_t(1));
+    size_t maxThreads = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+
+    Report report("pool");
+    report.config("batch", batch);
+
+    ModuleSystem system(std::make_shared<Reporter>(),
+                        [] { std::terminate(); });
+    if(!system.wrapBuiltin(
+           [](ModuleSystem& sys) {
+               return std::make_shared<SyntheticInstance>("", sys, 0, 1, 1);
+           },
+           table, std::size(table)))
+        return 1;
+    FunctionId id(syntheticGUID(0), "F0");
+    auto handle = system.getHandle<BenchFunction>(id);
+    auto pool = system.getPool<BenchFunction>(id);
+    if(!handle || !pool)
+        return 1;
+
+    // Times body over ops objects made count at a time and reports the
+    // time and the allocations per object.
+    auto run = [&](const char* name, size_t threads, size_t count,
+                   auto&& body) {
+        uint64_t rounds = (std::max)(ops / count, size_t(1));
+        uint64_t objects = rounds * count;
+        uint64_t before = allocations.load();
+        double ns = measure(threads, rounds, [&](size_t, uint64_t) {
+            if(!body())
+                std::terminate();
+        });
+        double allocs = static_cast<double>(allocations.load() - before) /
+            static_cast<double>(objects * threads);
+        report.add(name, threads, objects,
+                   ns / static_cast<double>(count), allocs);
+    };
+    std::vector<size_t> threadCounts;
+    for(size_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    for(size_t threads : threadCounts) {
+        run("instantiate", threads, 1, [&] {
+            return system.instantiate<BenchFunction>(id) != nullptr;
+        });
+        run("FunctionHandle::create", threads, 1,
+            [&] { return handle.create() != nullptr; });
+        run("PooledHandle::create", threads, 1,
+            [&] { return pool.create() != nullptr; });
+        run("PooledHandle::create/batch", threads, batch,
+            [&] { return pool.create(batch).size() == batch; });
+    }
+    report.write(std::cout);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#define BUS_ENABLE_PROFILER
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+#include <sstream>
+
+using namespace BusBench;
+using namespace Bus;
+
+static uint64_t traced(uint64_t value) {
+    BUS_TRACE_BEGIN("BusBenchProfiler") {
+        return value * 3 + 1;
+    }
+    BUS_TRACE_END();
+}
+
+// A traced scope with the profiler off and on, and collecting and
+// exporting the recorded spans.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 1000000);
+    size_t threads = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+
+    Report report("profiler");
+    std::atomic_uint64_t sink{ 0 };
+    auto scope = [&](size_t, uint64_t i) {
+        sink.fetch_add(traced(i), std::memory_order_relaxed);
+    };
+    enableProfiler(false);
+    report.add("scope/disabled", threads, ops, measure(threads, ops, scope));
+
+    // Rings large enough that no span is dropped.
+    size_t perThread = ops / threads + 1;
+    enableProfiler(true, perThread);
+    report.add("scope/enabled", threads, ops, measure(threads, ops, scope));
+    enableProfiler(false);
+    double perSpan = static_cast<double>(ops ? ops : 1);
+    double collectNs =
+        measure(1, 1, [](size_t, uint64_t) { collectProfile(); });
+    report.add("collectProfile", 1, ops, collectNs / perSpan);
+    std::stringstream out;
+    double exportNs =
+        measure(1, 1, [&](size_t, uint64_t) { exportProfile(out); });
+    report.add("exportProfile", 1, ops, exportNs / perSpan);
+    sink += out.str().size();
+    report.write(std::cout);
+    return sink == 0;
+}
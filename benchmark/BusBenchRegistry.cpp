@@ -0,0 +1,135 @@
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+#include "BusSynthetic.hpp"
+#include <algorithm>
+
+using namespace BusBench;
+
+static double since(std::chrono::steady_clock::time_point beg, size_t ops) {
+    return std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now() - beg)
+               .count() /
+        static_cast<double>(ops ? ops : 1);
+}
+
+// Registry scaling: loading modules while lookups build indexes, and
+// lookups across thread counts with and without a concurrent writer.
+// Loading a directory of slowly initializing modules shows what the
+// loader's threads gain over loading them one by one.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t modules = options.get("modules", 512);
+    size_t functions = options.get("functions", 16);
+    size_t ops = options.get("ops", 100000);
+    size_t writes = options.get("writes", 64);
+    size_t slow = options.get("slow", 32);
+    size_t initUs = options.get("init-us", 10000);
+    size_t maxThreads = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+
+    Report report("registry");
+    report.config("modules", modules);
+    report.config("functions", functions);
+    report.config("slow", slow);
+    report.config("initUs", initUs);
+
+    auto reporter = std::make_shared<Reporter>();
+#ifdef BUS_SYNTHETIC_MODULE
+    {
+        fs::path source = BUS_SYNTHETIC_MODULE;
+        auto dir = fs::temp_directory_path() /
+            ("BusBenchRegistry" +
+             std::to_string(std::chrono::steady_clock::now()
+                                .time_since_epoch()
+                                .count()));
+        fs::create_directories(dir);
+        for(size_t i = 0; i < modules; ++i)
+            fs::copy_file(source, syntheticFile(dir, i, 1, functions,
+                                                source.extension()));
+        {
+            ModuleSystem native(reporter, [] { std::terminate(); });
+            native.listFunctions(BenchFunction::getInterface());
+            auto beg = std::chrono::steady_clock::now();
+            if(native.loadModuleDirectory(dir, 1) != modules)
+                return 1;
+            report.add("loadModuleDirectory", 1, modules, since(beg, modules));
+        }
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+
+        // Four levels: module i depends on module i - slow / 4.
+        fs::create_directories(dir);
+        size_t width = (std::max)(slow / 4, size_t(1));
+        for(size_t i = 0; i < slow; ++i) {
+            std::vector<size_t> deps;
+            if(i >= width)
+                deps.push_back(i - width);
+            fs::copy_file(source, syntheticFile(dir, i, 1, functions,
+                                                source.extension(), deps,
+                                                initUs));
+        }
+        std::vector<size_t> loaders{ 1, 2, maxThreads };
+        std::sort(loaders.begin(), loaders.end());
+        loaders.erase(std::unique(loaders.begin(), loaders.end()),
+                      loaders.end());
+        for(size_t threads : loaders) {
+            ModuleSystem native(reporter, [] { std::terminate(); });
+            auto beg = std::chrono::steady_clock::now();
+            if(native.loadModuleDirectory(dir, threads) != slow)
+                return 1;
+            report.add("loadModuleDirectory/slowInit", threads, slow,
+                       since(beg, slow));
+        }
+        fs::remove_all(dir, ec);
+    }
+#endif
+
+    ModuleSystem system(reporter, [] { std::terminate(); });
+    auto add = [&](uint64_t index) {
+        return system.wrapBuiltin([&](ModuleSystem& sys) {
+            return std::make_shared<SyntheticInstance>("", sys, index, 1,
+                                                       functions);
+        });
+    };
+    // A lookup after every load is the worst case for the indexes.
+    auto beg = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < modules; ++i) {
+        if(!add(i))
+            return 1;
+        system.listFunctions(BenchFunction::getInterface());
+    }
+    report.add("wrapBuiltin+listFunctions", 1, modules, since(beg, modules));
+
+    std::vector<std::string> plain;
+    for(size_t j = 0; j < functions; ++j)
+        plain.push_back("F" + std::to_string(j));
+    auto body = [&](size_t t, uint64_t i) {
+        size_t index = static_cast<size_t>(
+            (i * 2654435761ULL + t * 40503ULL) % (modules * functions));
+        FunctionId id(syntheticGUID(index / functions),
+                      plain[index % functions]);
+        if(!system.instantiate<BenchFunction>(id))
+            std::terminate();
+    };
+    std::vector<size_t> threadCounts;
+    for(size_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    uint64_t next = modules;
+    for(size_t threads : threadCounts) {
+        report.add("instantiate", threads, ops, measure(threads, ops, body));
+        // Every module owns resources, so the writer stops after a while.
+        std::atomic_bool done{ false };
+        std::thread writer([&, last = next + writes] {
+            while(!done.load() && next < last)
+                if(!add(next++))
+                    std::terminate();
+        });
+        report.add("instantiate+writer", threads, ops,
+                   measure(threads, ops, body));
+        done = true;
+        writer.join();
+    }
+    report.write(std::cout);
+    return 0;
+}
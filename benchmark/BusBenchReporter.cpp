@@ -0,0 +1,74 @@
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+
+using namespace BusBench;
+using namespace Bus;
+
+// Producer throughput of Reporter::apply and of BUS_REPORT with arguments
+// to format, synchronous and asynchronous, and the latency of flush behind
+// a full queue.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 100000);
+    size_t capacity = options.get("capacity", 4096);
+    size_t drains = options.get("drains", 1);
+    size_t maxThreads = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+
+    Report report("reporter");
+    report.config("capacity", capacity);
+    report.config("drains", drains);
+
+    std::atomic_uint64_t sink{ 0 };
+    auto action = [&](ReportLevel, const std::string& message,
+                      const SourceLocation&) { sink += message.size(); };
+    auto body = [](Reporter& reporter) {
+        return [&reporter](size_t, uint64_t) {
+            reporter.apply(ReportLevel::Info, "benchmark record",
+                           BUS_SRCLOC("BusBench"));
+        };
+    };
+    auto formatted = [](Reporter& reporter) {
+        return [&reporter](size_t thread, uint64_t i) {
+            BUS_REPORT(reporter, Info, BUS_SRCLOC("BusBench"), "record ", i,
+                       " of thread ", thread, ": ", GUID(0x5747, i), ' ',
+                       1.5 * static_cast<double>(i));
+        };
+    };
+    std::vector<size_t> threadCounts;
+    for(size_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    for(size_t threads : threadCounts) {
+        Reporter sync;
+        sync.addAction(ReportLevel::Info, action);
+        report.add("apply/sync", threads, ops,
+                   measure(threads, ops, body(sync)));
+        report.add("report/sync", threads, ops,
+                   measure(threads, ops, formatted(sync)));
+        for(auto policy : { OverflowPolicy::Block, OverflowPolicy::Drop }) {
+            Reporter async;
+            async.addAction(ReportLevel::Info, action);
+            async.enableAsync(capacity, policy,
+                              static_cast<unsigned>(drains));
+            const char* name = policy == OverflowPolicy::Block ?
+                "apply/async/block" :
+                "apply/async/drop";
+            report.add(name, threads, ops,
+                       measure(threads, ops, body(async)));
+            async.flush();
+            report.add(policy == OverflowPolicy::Block ?
+                           "report/async/block" :
+                           "report/async/drop",
+                       threads, ops, measure(threads, ops, formatted(async)));
+            auto beg = std::chrono::steady_clock::now();
+            async.flush();
+            report.add(std::string(name) + "/flush", threads, 1,
+                       std::chrono::duration<double, std::nano>(
+                           std::chrono::steady_clock::now() - beg)
+                           .count());
+        }
+    }
+    report.write(std::cout);
+    return sink == 0;
+}
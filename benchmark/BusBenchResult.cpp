@@ -0,0 +1,60 @@
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+#include "BusResult.hpp"
+#include "BusSystem.hpp"
+
+using namespace BusBench;
+using namespace Bus;
+
+static int throwing(int depth) {
+    BUS_TRACE_BEGIN("BusBenchResult") {
+        if(depth == 0)
+            BUS_TRACE_THROW(std::runtime_error("failed"));
+        return throwing(depth - 1) + 1;
+    }
+    BUS_TRACE_END();
+}
+
+static Result<int> returning(int depth) {
+    if(depth == 0)
+        BUS_RESULT_FAIL("BusBenchResult", "failed");
+    BUS_RESULT_TRY("BusBenchResult", value, returning(depth - 1));
+    return value + 1;
+}
+
+// The failure path of a call chain as nested exceptions against Result,
+// and a missed lookup through tryParse against parse, which reports it.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 100000);
+
+    Report report("result");
+    uint64_t sink = 0;
+    for(int depth : { 1, 5, 10 }) {
+        auto suffix = "/depth=" + std::to_string(depth);
+        report.add("nested exceptions" + suffix, 1, ops,
+                   measure(1, ops, [&](size_t, uint64_t) {
+                       try {
+                           sink += throwing(depth);
+                       } catch(...) {
+                           ++sink;
+                       }
+                   }));
+        report.add("Result" + suffix, 1, ops,
+                   measure(1, ops, [&](size_t, uint64_t) {
+                       sink += returning(depth) ? 0 : 1;
+                   }));
+    }
+
+    ModuleSystem system(std::make_shared<Reporter>(), [] {});
+    report.add("tryParse/miss", 1, ops,
+               measure(1, ops, [&](size_t, uint64_t) {
+                   sink += system.tryParse("Missing", "Iface") ? 0 : 1;
+               }));
+    report.add("parse/miss", 1, ops,
+               measure(1, ops, [&](size_t, uint64_t) {
+                   sink += system.parse("Missing", "Iface").second.size();
+               }));
+    report.write(std::cout);
+    return sink == 0;
+}
@@ -0,0 +1,71 @@
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+#include "BusScheduler.hpp"
+
+using namespace BusBench;
+using namespace Bus;
+
+// Task submission and completion through groups, parallelFor against one
+// std::thread per chunk, and how long an outside thread takes to notice
+// that its group is done.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t ops = options.get("ops", 100000);
+    size_t items = options.get("items", 1 << 16);
+    size_t workers = options.get(
+        "threads", (std::max)(std::thread::hardware_concurrency(), 1U));
+
+    Report report("scheduler");
+    report.config("items", items);
+
+    Reporter reporter;
+    Scheduler scheduler(static_cast<unsigned>(workers), reporter, [] {});
+    std::atomic_uint64_t sink{ 0 };
+
+    {
+        TaskGroup group(scheduler);
+        report.add("TaskGroup::run", workers, ops,
+                   measure(1, ops, [&](size_t, uint64_t i) {
+                       group.run([&sink, i] { sink += i; });
+                   }));
+        auto beg = std::chrono::steady_clock::now();
+        group.wait();
+        report.add("TaskGroup::wait/drain", workers, ops,
+                   std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - beg)
+                           .count() /
+                       static_cast<double>(ops ? ops : 1));
+    }
+
+    std::vector<uint64_t> data(items, 1);
+    auto sum = [&](size_t first, size_t last) {
+        uint64_t res = 0;
+        for(size_t i = first; i < last; ++i)
+            res += data[i];
+        sink += res;
+    };
+    size_t rounds = (std::max)(ops / 100, size_t(1));
+    report.add("parallelFor", workers, rounds,
+               measure(1, rounds, [&](size_t, uint64_t) {
+                   scheduler.parallelFor(0, items, 1024, sum);
+               }));
+    report.add("std::thread per chunk", workers, rounds,
+               measure(1, rounds, [&](size_t, uint64_t) {
+                   std::vector<std::thread> threads;
+                   size_t step = (items + workers - 1) / workers;
+                   for(size_t first = 0; first < items; first += step)
+                       threads.emplace_back(
+                           sum, first, (std::min)(first + step, items));
+                   for(auto&& thread : threads)
+                       thread.join();
+               }));
+    // One short task, waited for by a thread outside the pool.
+    report.add("TaskGroup::wait/external", workers, rounds,
+               measure(1, rounds, [&](size_t, uint64_t i) {
+                   TaskGroup group(scheduler);
+                   group.run([&sink, i] { sink += i; });
+                   group.wait();
+               }));
+    report.write(std::cout);
+    return sink == 0;
+}
@@ -0,0 +1,72 @@
+#include "BusBenchmark.hpp"
+#include "BusReporter.hpp"
+#include "BusStatic.hpp"
+#include "BusSynthetic.hpp"
+
+using namespace BusBench;
+
+namespace {
+    class StaticFunction final : public BenchFunction {
+    public:
+        explicit StaticFunction(ModuleInstance& instance)
+            : BenchFunction(instance) {}
+        uint64_t value() override {
+            return 1;
+        }
+    };
+}  // namespace
+
+BUS_STATIC_MODULE(BusBenchStatic, "BusBenchStatic", GUID(0x5747, 1), "1.0.0",
+                  "", "",
+                  BUS_STATIC_FUNCTION(BenchFunction, "F0", StaticFunction),
+                  BUS_STATIC_FUNCTION(BenchFunction, "F1", StaticFunction),
+                  BUS_STATIC_FUNCTION(BenchFunction, "F2", StaticFunction),
+                  BUS_STATIC_FUNCTION(BenchFunction, "F3", StaticFunction));
+
+// Startup: a fresh ModuleSystem registers one module with four functions,
+// instantiates one of them and shuts down again. The module is statically
+// linked, against loaded from a shared library.
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    size_t rounds = options.get("rounds", 200);
+
+    Report report("static");
+    auto reporter = std::make_shared<Reporter>();
+    auto fail = [] { std::terminate(); };
+
+    report.add("ModuleSystem", 1, rounds,
+               measure(1, rounds, [&](size_t, uint64_t) {
+                   ModuleSystem system(reporter, fail);
+               }));
+    FunctionId staticId(GUID(0x5747, 1), "F0");
+    report.add("loadStaticModules+instantiate", 1, rounds,
+               measure(1, rounds, [&](size_t, uint64_t) {
+                   ModuleSystem system(reporter, fail);
+                   if(loadStaticModules(system) != 1 ||
+                      !system.instantiate<BenchFunction>(staticId))
+                       std::terminate();
+               }));
+#ifdef BUS_SYNTHETIC_MODULE
+    fs::path source = BUS_SYNTHETIC_MODULE;
+    auto dir = fs::temp_directory_path() /
+        ("BusBenchStatic" +
+         std::to_string(
+             std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(dir);
+    fs::path file = syntheticFile(dir, 0, 1, 4, source.extension());
+    fs::copy_file(source, file);
+    FunctionId dynamicId(syntheticGUID(0), "F0");
+    // Each round unloads the library again with its ModuleSystem.
+    report.add("loadModuleFile+instantiate", 1, rounds,
+               measure(1, rounds, [&](size_t, uint64_t) {
+                   ModuleSystem system(reporter, fail);
+                   if(!system.loadModuleFile(file) ||
+                      !system.instantiate<BenchFunction>(dynamicId))
+                       std::terminate();
+               }));
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+#endif
+    report.write(std::cout);
+    return 0;
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "BusMetrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace BusBench {
+    // "--key value" pairs from the command line, with defaults.
+    class Options final {
+    private:
+        std::map<std::string, std::string> mValues;
+
+    public:
+        Options(int argc, char** argv) {
+            for(int i = 1; i + 1 < argc; i += 2) {
+                std::string key = argv[i];
+                if(key.rfind("--", 0) == 0)
+                    mValues[key.substr(2)] = argv[i + 1];
+            }
+        }
+        size_t get(const std::string& key, size_t def) const {
+            auto iter = mValues.find(key);
+            return iter == mValues.cend() ?
+                def :
+                static_cast<size_t>(std::strtoull(iter->second.c_str(),
+                                                  nullptr, 10));
+        }
+        std::string get(const std::string& key, const char* def) const {
+            auto iter = mValues.find(key);
+            return iter == mValues.cend() ? def : iter->second;
+        }
+    };
+
+    struct Measurement final {
+        std::string name;
+        size_t threads;
+        uint64_t ops;
+        double nsPerOp;
+        // Heap allocations per operation, negative if not counted.
+        double allocsPerOp;
+    };
+
+    // Runs body(thread, i) for i in [0, ops) on every thread, all threads
+    // starting together. Returns the wall time per operation of one thread.
+    template <typename Body>
+    double measure(size_t threads, uint64_t ops, Body&& body) {
+        std::atomic_size_t ready{ 0 };
+        std::atomic_bool go{ false };
+        std::vector<std::thread> workers;
+        for(size_t t = 1; t < threads; ++t)
+            workers.emplace_back([&, t] {
+                ++ready;
+                while(!go.load())
+                    std::this_thread::yield();
+                for(uint64_t i = 0; i < ops; ++i)
+                    body(t, i);
+            });
+        while(ready.load() + 1 < threads)
+            std::this_thread::yield();
+        auto beg = std::chrono::steady_clock::now();
+        go = true;
+        for(uint64_t i = 0; i < ops; ++i)
+            body(size_t(0), i);
+        for(auto&& worker : workers)
+            worker.join();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - beg).count() /
+            static_cast<double>(ops ? ops : 1);
+    }
+
+    // Results are printed as one JSON document so that runs of different
+    // versions can be compared by scripts.
+    class Report final {
+    private:
+        std::string mSuite;
+        std::vector<std::pair<std::string, size_t>> mConfig;
+        std::vector<Measurement> mResults;
+
+    public:
+        explicit Report(std::string suite) : mSuite(std::move(suite)) {}
+        void config(const std::string& key, size_t value) {
+            mConfig.emplace_back(key, value);
+        }
+        void add(const std::string& name, size_t threads, uint64_t ops,
+                 double nsPerOp, double allocsPerOp = -1.0) {
+            mResults.push_back({ name, threads, ops, nsPerOp, allocsPerOp });
+            std::cerr << name << " [threads=" << threads << "] " << nsPerOp
+                      << " ns/op";
+            if(allocsPerOp >= 0.0)
+                std::cerr << ", " << allocsPerOp << " allocs/op";
+            std::cerr << std::endl;
+        }
+        void write(std::ostream& out) const {
+            out << "{\"suite\":";
+            Bus::writeJSONString(out, mSuite);
+            out << ",\"version\":\"" BUS_VERSION "\",\"config\":{";
+            for(size_t i = 0; i < mConfig.size(); ++i) {
+                out << (i ? "," : "");
+                Bus::writeJSONString(out, mConfig[i].first);
+                out << ':' << mConfig[i].second;
+            }
+            out << "},\"results\":[";
+            for(size_t i = 0; i < mResults.size(); ++i) {
+                auto&& res = mResults[i];
+                out << (i ? ",{" : "{") << "\"name\":";
+                Bus::writeJSONString(out, res.name);
+                out << ",\"threads\":" << res.threads << ",\"ops\":" << res.ops
+                    << ",\"nsPerOp\":" << res.nsPerOp;
+                if(res.allocsPerOp >= 0.0)
+                    out << ",\"allocsPerOp\":" << res.allocsPerOp;
+                out << '}';
+            }
+            out << "]}" << std::endl;
+        }
+    };
+}  // namespace BusBench
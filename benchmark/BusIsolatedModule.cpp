@@ -0,0 +1,82 @@
+#include "BusIsolated.hpp"
+#include "BusSystem.hpp"
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+
+// Isolated functions for the benchmark and the tests: Echo returns its
+// arguments, Throw fails and Crash takes its host down.
+namespace BusBench {
+    using namespace Bus;
+
+    class Echo final : public IsolatedFunction {
+    public:
+        explicit Echo(ModuleInstance& instance) : IsolatedFunction(instance) {}
+        size_t invoke(const void* in, size_t inSize, void* out,
+                      size_t outCapacity) override {
+            if(inSize > outCapacity)
+                throw std::runtime_error("Echo doesn't fit");
+            if(inSize)
+                std::memcpy(out, in, inSize);
+            return inSize;
+        }
+    };
+
+    class Throw final : public IsolatedFunction {
+    public:
+        explicit Throw(ModuleInstance& instance)
+            : IsolatedFunction(instance) {}
+        size_t invoke(const void*, size_t, void*, size_t) override {
+            throw std::runtime_error("Isolated failure");
+        }
+    };
+
+    class Crash final : public IsolatedFunction {
+    public:
+        explicit Crash(ModuleInstance& instance)
+            : IsolatedFunction(instance) {}
+        size_t invoke(const void*, size_t, void*, size_t) override {
+            std::raise(SIGKILL);
+            return 0;
+        }
+    };
+
+    class IsolatedInstance final : public ModuleInstance {
+    public:
+        IsolatedInstance(const fs::path& path, ModuleSystem& system)
+            : ModuleInstance(path, system) {}
+        ModuleInfo info() const override {
+            ModuleInfo res;
+            res.name = "Isolated";
+            res.guid = GUID(0x150A7ED, 1);
+            res.busVersion = BUS_VERSION;
+            res.version = "1.0.0";
+            res.description = "Isolated benchmark module";
+            res.copyright = "";
+            res.modulePath = mModulePath;
+            return res;
+        }
+        std::vector<Name> list(Name interfaceName) const override {
+            if(interfaceName != IsolatedFunction::getInterface())
+                return {};
+            return { "Echo", "Throw", "Crash" };
+        }
+        std::vector<Name> interfaces() const override {
+            return { IsolatedFunction::getInterface() };
+        }
+        std::shared_ptr<ModuleFunctionBase> instantiate(Name name) override {
+            if(name == "Echo")
+                return std::make_shared<Echo>(*this);
+            if(name == "Throw")
+                return std::make_shared<Throw>(*this);
+            if(name == "Crash")
+                return std::make_shared<Crash>(*this);
+            return nullptr;
+        }
+    };
+}  // namespace BusBench
+
+BUS_API void busInitModule(const Bus::fs::path& path, Bus::ModuleSystem& system,
+                           std::shared_ptr<Bus::ModuleInstance>& instance) {
+    instance = std::make_shared<BusBench::IsolatedInstance>(path, system);
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "BusModule.hpp"
+#include "BusSystem.hpp"
+#include <deque>
+#include <string>
+
+namespace BusBench {
+    using namespace Bus;
+
+    // Every synthetic function implements it. Interface m is called
+    // "Bench.Interface<m>", the function type answers to all of them.
+    class BenchFunction : public ModuleFunctionBase {
+    protected:
+        explicit BenchFunction(ModuleInstance& instance)
+            : ModuleFunctionBase(instance) {}
+
+    public:
+        static Name getInterface() {
+            return "Bench.Interface0";
+        }
+        virtual uint64_t value() = 0;
+    };
+
+    inline GUID syntheticGUID(uint64_t index) {
+        return GUID(0xB05B05B05ULL, index + 1);
+    }
+
+    // Path of the copy of BusSyntheticModule that busInitModule turns into
+    // module number index, depending on the given module numbers and taking
+    // initUs microseconds to initialize.
+    inline std::string
+    syntheticFile(const fs::path& dir, size_t index, size_t interfaces,
+                  size_t functions, const fs::path& ext,
+                  const std::vector<size_t>& dependencies = {},
+                  size_t initUs = 0) {
+        auto name = "synth_" + std::to_string(index) + '_' +
+            std::to_string(interfaces) + '_' + std::to_string(functions);
+        for(size_t i = 0; i < dependencies.size(); ++i)
+            name += (i ? '-' : '_') + std::to_string(dependencies[i]);
+        if(initUs)
+            name += '+' + std::to_string(initUs);
+        return (dir / name).string() + ext.string();
+    }
+
+    // Module number index with interfaces x functions functions, named
+    // "Synthetic<index>" and "F<k>".
+    class SyntheticInstance final : public ModuleInstance {
+    private:
+        class Function final : public BenchFunction {
+        private:
+            uint64_t mValue;
+
+        public:
+            Function(ModuleInstance& instance, uint64_t value)
+                : BenchFunction(instance), mValue(value) {}
+            uint64_t value() override {
+                return mValue;
+            }
+        };
+
+        uint64_t mIndex;
+        size_t mInterfaces;
+        std::deque<std::string> mStrings;
+        std::vector<Name> mFunctions;
+        std::vector<Name> mInterfaceNames;
+        Name mName;
+
+        Name store(std::string str) {
+            mStrings.emplace_back(std::move(str));
+            return mStrings.back();
+        }
+
+    public:
+        SyntheticInstance(const fs::path& path, ModuleSystem& system,
+                          uint64_t index, size_t interfaces, size_t functions)
+            : ModuleInstance(path, system), mIndex(index),
+              mInterfaces(interfaces) {
+            mName = store("Synthetic" + std::to_string(index));
+            for(size_t i = 0; i < interfaces; ++i)
+                mInterfaceNames.push_back(
+                    store("Bench.Interface" + std::to_string(i)));
+            for(size_t i = 0; i < functions; ++i)
+                mFunctions.push_back(store("F" + std::to_string(i)));
+        }
+        ModuleInfo info() const override {
+            ModuleInfo res;
+            res.name = mName;
+            res.guid = syntheticGUID(mIndex);
+            res.busVersion = BUS_VERSION;
+            res.version = "1.0.0";
+            res.description = "Synthetic benchmark module";
+            res.copyright = "";
+            res.modulePath = mModulePath;
+            return res;
+        }
+        std::vector<Name> list(Name interfaceName) const override {
+            for(auto&& name : mInterfaceNames)
+                if(name == interfaceName)
+                    return mFunctions;
+            return {};
+        }
+        std::vector<Name> interfaces() const override {
+            return mInterfaceNames;
+        }
+        std::shared_ptr<ModuleFunctionBase> instantiate(Name name) override {
+            for(size_t i = 0; i < mFunctions.size(); ++i)
+                if(mFunctions[i] == name)
+                    return std::make_shared<Function>(*this, mIndex << 32 | i);
+            return nullptr;
+        }
+    };
+}  // namespace BusBench
@@ -0,0 +1,58 @@
+#include "BusSynthetic.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+// The benchmark copies this library to
+// "synth_<index>_<interfaces>_<functions>[_<dependency>-...][+<initUs>]"
+// plus the platform suffix, so one binary yields any number of modules.
+struct SyntheticName final {
+    uint64_t values[3] = { 0, 1, 1 };
+    std::vector<Bus::GUID> dependencies;
+    uint64_t initUs = 0;
+    explicit SyntheticName(const Bus::fs::path& path) {
+        std::string stem = path.stem().string();
+        char* ptr = stem.data() + (std::min)(stem.find('_'), stem.size());
+        for(size_t i = 0; i < 3 && *ptr == '_'; ++i)
+            values[i] = std::strtoull(ptr + 1, &ptr, 10);
+        while(*ptr == '_' || *ptr == '-')
+            dependencies.push_back(
+                BusBench::syntheticGUID(std::strtoull(ptr + 1, &ptr, 10)));
+        if(*ptr == '+')
+            initUs = std::strtoull(ptr + 1, &ptr, 10);
+    }
+};
+
+#ifdef BUS_SYNTHETIC_EXTERN
+// Test builds call a function from another library here, which only
+// resolves if that library is loaded with the module.
+extern "C" int BUS_SYNTHETIC_EXTERN();
+BUS_API int busSyntheticExtern() {
+    return BUS_SYNTHETIC_EXTERN();
+}
+#endif
+
+BUS_API void busGetDependencies(const Bus::fs::path& path, Bus::GUID& guid,
+                                std::vector<Bus::GUID>& dependencies) {
+    SyntheticName name(path);
+    guid = BusBench::syntheticGUID(name.values[0]);
+    dependencies = name.dependencies;
+}
+
+// A module refuses to initialize before its dependencies. initUs stands in
+// for the work a real module does here.
+BUS_API void busInitModule(const Bus::fs::path& path, Bus::ModuleSystem& system,
+                           std::shared_ptr<Bus::ModuleInstance>& instance) {
+    SyntheticName name(path);
+    auto modules = system.listModules();
+    for(auto dep : name.dependencies) {
+        bool found = false;
+        for(auto&& info : modules)
+            found |= info.guid == dep;
+        if(!found)
+            return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(name.initUs));
+    instance = std::make_shared<BusBench::SyntheticInstance>(
+        path, system, name.values[0], name.values[1], name.values[2]);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "BusReporter.hpp"
+#include "BusSystem.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef BUS_SYNTHETIC_MODULE
+#include "BusSynthetic.hpp"
+#endif
+
+// Checks keep running after a failure so that one run reports all of them.
+// main returns BusTest::finish().
+namespace BusTest {
+    inline std::atomic_int& failures() {
+        static std::atomic_int res{ 0 };
+        return res;
+    }
+    inline bool check(bool res, const char* expr, const char* file,
+                      int line) {
+        if(!res) {
+            ++failures();
+            std::cerr << file << ':' << line << ": check failed: " << expr
+                      << std::endl;
+        }
+        return res;
+    }
+    inline int finish() {
+        int count = failures();
+        if(count)
+            std::cerr << count << " checks failed" << std::endl;
+        return count ? 1 : 0;
+    }
+
+    // Fresh directory under the system temporary directory.
+    inline Bus::fs::path tempDir(const std::string& prefix) {
+        auto dir = Bus::fs::temp_directory_path() /
+            (prefix +
+             std::to_string(
+                 std::chrono::steady_clock::now().time_since_epoch().count()));
+        Bus::fs::create_directories(dir);
+        return dir;
+    }
+
+#ifdef BUS_SYNTHETIC_MODULE
+    // Copies the synthetic module into dir as module number index, see
+    // BusSyntheticModule.cpp.
+    inline Bus::fs::path copyModule(const Bus::fs::path& dir, size_t index,
+                                    size_t interfaces, size_t functions,
+                                    const std::vector<size_t>& dependencies =
+                                        {}) {
+        Bus::fs::path source = BUS_SYNTHETIC_MODULE;
+        Bus::fs::path res =
+            BusBench::syntheticFile(dir, index, interfaces, functions,
+                                    source.extension(), dependencies);
+        Bus::fs::copy_file(source, res,
+                           Bus::fs::copy_options::overwrite_existing);
+        return res;
+    }
+#endif
+
+    // Collects the errors and warnings a ModuleSystem reports.
+    struct Errors final {
+        std::shared_ptr<Bus::Reporter> reporter =
+            std::make_shared<Bus::Reporter>();
+        std::atomic_size_t count{ 0 };
+        std::mutex mutex;
+        std::vector<std::string> messages;
+        std::vector<std::string> warnings;
+        Errors() {
+            reporter->addAction(Bus::ReportLevel::Error,
+                                [this](Bus::ReportLevel,
+                                       const std::string& msg,
+                                       const Bus::SourceLocation&) {
+                                    std::lock_guard guard(mutex);
+                                    messages.push_back(msg);
+                                    ++count;
+                                });
+            reporter->addAction(Bus::ReportLevel::Warning,
+                                [this](Bus::ReportLevel,
+                                       const std::string& msg,
+                                       const Bus::SourceLocation&) {
+                                    std::lock_guard guard(mutex);
+                                    warnings.push_back(msg);
+                                });
+        }
+        // Errors that mention both where and what.
+        size_t matching(const std::string& where, const std::string& what) {
+            return find(messages, where, what);
+        }
+        // Warnings that mention both where and what.
+        size_t warned(const std::string& where, const std::string& what) {
+            return find(warnings, where, what);
+        }
+
+    private:
+        size_t find(const std::vector<std::string>& list,
+                    const std::string& where, const std::string& what) {
+            std::lock_guard guard(mutex);
+            size_t res = 0;
+            for(auto&& msg : list)
+                res += msg.find(where) != std::string::npos &&
+                    msg.find(what) != std::string::npos;
+            return res;
+        }
+    };
+}  // namespace BusTest
+
+#define BUS_CHECK(expr) BusTest::check(static_cast<bool>(expr), #expr, \
+                                       __FILE__, __LINE__)
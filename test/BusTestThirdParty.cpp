@@ -0,0 +1,5 @@
+// A library that BusTestLinked links to and that the loader only finds
+// through the module's thirdPartySearchPath, see TestLoader.
+extern "C" __attribute__((visibility("default"))) int busTestThirdParty() {
+    return 42;
+}
@@ -0,0 +1,71 @@
+#include "BusBinaryLog.hpp"
+#include "BusTest.hpp"
+#include <cstring>
+#include <sstream>
+
+using namespace Bus;
+
+static std::string decode(const fs::path& path) {
+    std::stringstream out;
+    decodeBinaryLog(path, out);
+    return out.str();
+}
+
+// The segment holds exactly the header, the tags and the record fields.
+static void testLayout() {
+    auto dir = BusTest::tempDir("BusTestBinaryLog");
+    BinaryLogConfig config;
+    config.path = dir / "log";
+    auto loc = BUS_SRCLOC("Test");
+    {
+        BinaryLogWriter writer(config);
+        writer.write(ReportLevel::Warning, "hello", loc);
+        writer.write(ReportLevel::Info, "world!", loc);
+    }
+    size_t location = 1 + 14 + std::strlen(loc.module) +
+        std::strlen(loc.srcFile) + std::strlen(loc.functionName);
+    size_t messages = 2 * (1 + 25) + 5 + 6;
+    BUS_CHECK(fs::file_size(dir / "log.0") == 32 + location + messages);
+    auto text = decode(dir / "log.0");
+    BUS_CHECK(text.find("[Warning]") != std::string::npos);
+    BUS_CHECK(text.find("hello\n") != std::string::npos);
+    BUS_CHECK(text.find("world!\n") != std::string::npos);
+    fs::remove_all(dir);
+}
+
+// A second run must not overwrite segment 0 while the first run's later
+// segments are still there.
+static void testRestart() {
+    auto dir = BusTest::tempDir("BusTestBinaryLog");
+    BinaryLogConfig config;
+    config.path = dir / "log";
+    config.segmentSize = 1 << 18;
+    config.maxSegments = 3;
+    std::string big(100000, 'x');
+    auto loc = BUS_SRCLOC("Test");
+    {
+        BinaryLogWriter writer(config);
+        for(int i = 0; i < 7; ++i)
+            writer.write(ReportLevel::Info, big, loc);
+        BUS_CHECK(writer.currentSegment() == dir / "log.3");
+    }
+    BUS_CHECK(!fs::exists(dir / "log.0"));
+    BUS_CHECK(fs::exists(dir / "log.1"));
+    {
+        BinaryLogWriter writer(config);
+        BUS_CHECK(writer.currentSegment() == dir / "log.4");
+        writer.write(ReportLevel::Info, "second run", loc);
+    }
+    BUS_CHECK(!fs::exists(dir / "log.1"));
+    BUS_CHECK(fs::exists(dir / "log.2"));
+    BUS_CHECK(fs::exists(dir / "log.3"));
+    BUS_CHECK(decode(dir / "log.4").find("second run") != std::string::npos);
+    BUS_CHECK(decode(dir / "log.3").find("second run") == std::string::npos);
+    fs::remove_all(dir);
+}
+
+int main() {
+    testLayout();
+    testRestart();
+    return BusTest::finish();
+}
@@ -0,0 +1,92 @@
+#include "BusTest.hpp"
+#include <fstream>
+
+using namespace Bus;
+using namespace BusBench;
+
+static size_t countFunctions(ModuleSystem& system) {
+    return system.listFunctions(BenchFunction::getInterface()).size();
+}
+
+// Modules are registered from the catalog of an earlier run, and from the
+// scan itself when the refreshed catalog can't be written.
+static void testWriteFailure() {
+    auto dir = BusTest::tempDir("BusTestCatalog");
+    auto modules = dir / "modules";
+    fs::create_directories(modules);
+    auto catalog = dir / "modules.catalog";
+    BusTest::copyModule(modules, 0, 1, 2);
+    auto changed = BusTest::copyModule(modules, 1, 1, 2);
+    BusTest::Errors errors;
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.loadCatalog(catalog, modules) == 2);
+        BUS_CHECK(countFunctions(system) == 4);
+    }
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.loadCatalog(catalog, modules) == 2);
+    }
+    BUS_CHECK(errors.count == 0);
+
+    BusTest::copyModule(modules, 2, 1, 3);
+    fs::last_write_time(changed, fs::last_write_time(changed) +
+                                     std::chrono::seconds(10));
+    // The writer can't create its temporary file.
+    fs::path tmp = catalog;
+    tmp += ".tmp";
+    fs::create_directories(tmp);
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.loadCatalog(catalog, modules) == 3);
+        BUS_CHECK(countFunctions(system) == 7);
+        BUS_CHECK(system.instantiate<BenchFunction>(
+            FunctionId(syntheticGUID(2), "F2")));
+    }
+    BUS_CHECK(errors.count != 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+// Registered names point into the mapped catalog instead of copies.
+static void testMappedNames() {
+#ifdef __linux__
+    auto dir = BusTest::tempDir("BusTestCatalog");
+    auto modules = dir / "modules";
+    fs::create_directories(modules);
+    auto catalog = dir / "modules.catalog";
+    BusTest::copyModule(modules, 0, 1, 2);
+    BusTest::Errors errors;
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.loadCatalog(catalog, modules) == 1);
+    }
+    ModuleSystem system(errors.reporter, [] {});
+    BUS_CHECK(system.loadCatalog(catalog, modules) == 1);
+    auto functions = system.listFunctions(BenchFunction::getInterface());
+    BUS_CHECK(functions.size() == 2);
+    std::ifstream maps("/proc/self/maps");
+    std::string file = fs::canonical(catalog).string();
+    uintptr_t beg = 0, end = 0;
+    for(std::string line; std::getline(maps, line);)
+        if(line.size() > file.size() &&
+           line.compare(line.size() - file.size(), file.size(), file) == 0) {
+            beg = std::stoull(line, nullptr, 16);
+            end = std::stoull(line.substr(line.find('-') + 1), nullptr, 16);
+        }
+    BUS_CHECK(beg != 0);
+    for(auto&& id : functions) {
+        auto ptr = reinterpret_cast<uintptr_t>(id.name.data());
+        BUS_CHECK(ptr >= beg && ptr < end);
+    }
+    BUS_CHECK(errors.count == 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+#endif
+}
+
+int main() {
+    testWriteFailure();
+    testMappedNames();
+    return BusTest::finish();
+}
@@ -0,0 +1,122 @@
+#include "BusMetrics.hpp"
+#include "BusPool.hpp"
+#include "BusStatic.hpp"
+#include "BusSynthetic.hpp"
+#include "BusTest.hpp"
+#include <iterator>
+
+using namespace BusBench;
+
+namespace {
+    class TableFunction final : public BenchFunction {
+    public:
+        explicit TableFunction(ModuleInstance& instance)
+            : BenchFunction(instance) {}
+        uint64_t value() override {
+            return 7;
+        }
+    };
+
+    // Its name hashes differently, the entry below claims the id of
+    // Bench.Interface0 anyway.
+    class Impostor : public ModuleFunctionBase {
+    public:
+        explicit Impostor(ModuleInstance& instance)
+            : ModuleFunctionBase(instance) {}
+        static Name getInterface() {
+            return "Impostor";
+        }
+    };
+
+    const FactoryEntry builtinTable[] = {
+        BUS_FACTORY(BenchFunction, "F1", TableFunction),
+        Detail::makeFactoryEntry<Impostor>(
+            interfaceId(BenchFunction::getInterface()),
+            &Impostor::getInterface, "F0"),
+    };
+}  // namespace
+
+BUS_STATIC_MODULE(TestFactoryA, "TestFactoryA", GUID(0x7E57, 2), "1.0.0",
+                  "", "",
+                  BUS_STATIC_FUNCTION(BenchFunction, "F", TableFunction));
+BUS_STATIC_MODULE(TestFactoryB, "TestFactoryB", GUID(0x7E57, 3), "1.0.0",
+                  "", "",
+                  BUS_STATIC_FUNCTION(BenchFunction, "F", TableFunction));
+
+static std::shared_ptr<ModuleInstance> synthetic(ModuleSystem& system) {
+    return std::make_shared<SyntheticInstance>("", system, 0, 1, 2);
+}
+
+// A builtin module with a table is instantiated through it, by every path.
+static void testBuiltinTable() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(synthetic, builtinTable,
+                                 std::size(builtinTable)));
+    FunctionId id(syntheticGUID(0), "F1");
+    BUS_CHECK(system.instantiate<BenchFunction>(id)->value() == 7);
+    auto handle = system.getHandle<BenchFunction>(id);
+    BUS_CHECK(handle && handle.create()->value() == 7);
+    auto pool = system.getPool<BenchFunction>(id);
+    BUS_CHECK(pool && pool.create()->value() == 7);
+    BUS_CHECK(errors.count == 0);
+}
+
+// An entry whose id matches but whose interface doesn't is ignored, the
+// module's own instantiate answers instead.
+static void testIdCollision() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(synthetic, builtinTable,
+                                 std::size(builtinTable)));
+    FunctionId id(syntheticGUID(0), "F0");
+    BUS_CHECK(system.instantiate<BenchFunction>(id)->value() == 0);
+    auto handle = system.getHandle<BenchFunction>(id);
+    BUS_CHECK(handle && handle.create()->value() == 0);
+    BUS_CHECK(errors.count == 0);
+    BUS_CHECK(!system.getPool<BenchFunction>(id));
+    BUS_CHECK(errors.count == 1);
+}
+
+// A handle calls the table entry directly, or through the metrics wrapper
+// if stats were on when it was made.
+static void testHandleStats() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(synthetic, builtinTable,
+                                 std::size(builtinTable)));
+    FunctionId id(syntheticGUID(0), "F1");
+    auto direct = system.getHandle<BenchFunction>(id);
+    system.enableStats(true);
+    auto tracked = system.getHandle<BenchFunction>(id);
+    BUS_CHECK(direct.create()->value() == 7);
+    auto object = tracked.create();
+    BUS_CHECK(object && object->value() == 7);
+    auto stats = system.stats();
+    BUS_CHECK(stats.size() == 1 && stats[0].functions.size() == 1);
+    BUS_CHECK(stats[0].functions[0].instantiations == 1 &&
+              stats[0].functions[0].live == 1);
+    object.reset();
+    BUS_CHECK(system.stats()[0].functions[0].live == 0);
+    BUS_CHECK(errors.count == 0);
+}
+
+static void testStaticModules() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(loadStaticModules(system) == 2);
+    BUS_CHECK(loadStaticModules(system) == 0);
+    BUS_CHECK(system.list<BenchFunction>().size() == 2);
+    BUS_CHECK(system.instantiate<BenchFunction>(
+                        FunctionId(GUID(0x7E57, 3), "F"))
+                  ->value() == 7);
+    BUS_CHECK(errors.count == 0);
+}
+
+int main() {
+    testBuiltinTable();
+    testIdCollision();
+    testHandleStats();
+    testStaticModules();
+    return BusTest::finish();
+}
@@ -0,0 +1,43 @@
+#include "BusTest.hpp"
+#include <unordered_set>
+
+using namespace Bus;
+
+static void testParse() {
+    constexpr GUID literal = "{0123ABCD-4567-89EF-0123-456789ABCDEF}"_guid;
+    static_assert(literal.first == 0x0123ABCD456789EFULL &&
+                  literal.second == 0x0123456789ABCDEFULL);
+    // Also usable outside of constant expressions.
+    GUID runtime = "{00000000-0000-0000-0000-000000000001}"_guid;
+    BUS_CHECK(runtime == GUID(0, 1));
+
+    char buf[guidStrSize];
+    GUID2Str(literal, buf);
+    BUS_CHECK(Name(buf, guidStrSize) ==
+              "{0123ABCD-4567-89EF-0123-456789ABCDEF}");
+    BUS_CHECK(GUID2Str(literal) == Name(buf, guidStrSize));
+    GUID parsed(0, 0);
+    BUS_CHECK(tryParseGUID(GUID2Str(literal), parsed) && parsed == literal);
+
+    for(Name bad : { "", "{0123ABCD-4567-89EF-0123-456789ABCDE}",
+                     "{0123abcd-4567-89EF-0123-456789ABCDEF}",
+                     "{0123ABCD+4567-89EF-0123-456789ABCDEF}",
+                     "[0123ABCD-4567-89EF-0123-456789ABCDEF]",
+                     "{0123ABCD-4567-89EF-0123-456789ABCDEG}" })
+        BUS_CHECK(!tryParseGUID(bad, parsed));
+}
+
+static void testHash() {
+    std::unordered_set<size_t> hashes;
+    for(uint64_t i = 0; i < 1000; ++i) {
+        hashes.insert(GUIDHash{}(GUID(0, i)));
+        hashes.insert(GUIDHash{}(GUID(i + 1, 0)));
+    }
+    BUS_CHECK(hashes.size() == 2000);
+}
+
+int main() {
+    testParse();
+    testHash();
+    return BusTest::finish();
+}
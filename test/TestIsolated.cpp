@@ -0,0 +1,117 @@
+#include "BusIsolated.hpp"
+#include "BusTest.hpp"
+#include <csignal>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Bus;
+
+static size_t echo(IsolatedFunction& func, const std::string& in,
+                   std::string& out) {
+    out.assign(in.size() + 16, '\0');
+    size_t size = func.invoke(in.data(), in.size(), out.data(), out.size());
+    out.resize(size);
+    return size;
+}
+
+static bool throws(IsolatedFunction& func) {
+    try {
+        char buffer[16];
+        func.invoke(nullptr, 0, buffer, sizeof(buffer));
+    } catch(const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+// Calls, failures inside the host and a restart after a crash.
+static void testCalls() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    BUS_CHECK(system.loadModuleIsolated(BUS_ISOLATED_MODULE));
+    BUS_CHECK(system.list<IsolatedFunction>().size() == 3);
+    auto echoFunc = system.instantiateByName<IsolatedFunction>("Echo");
+    BUS_CHECK(echoFunc);
+    if(!echoFunc)
+        return;
+    std::string out;
+    std::string big(30000, 'x');
+    BUS_CHECK(echo(*echoFunc, "isolated", out) == 8 && out == "isolated");
+    BUS_CHECK(echo(*echoFunc, big, out) == big.size() && out == big);
+
+    auto throwFunc = system.instantiateByName<IsolatedFunction>("Throw");
+    BUS_CHECK(throwFunc && throws(*throwFunc));
+    BUS_CHECK(errors.count == 0);
+
+    auto crashFunc = system.instantiateByName<IsolatedFunction>("Crash");
+    BUS_CHECK(crashFunc && throws(*crashFunc));
+    // The crash is reported, the next call runs on a new host.
+    BUS_CHECK(errors.count == 1);
+    BUS_CHECK(echo(*echoFunc, "again", out) == 5 && out == "again");
+}
+
+// With SIGCHLD ignored the host is never a zombie and waitpid fails, a
+// crash must still end the call.
+static void testIgnoredChildSignal() {
+    BusTest::Errors errors;
+    auto previous = std::signal(SIGCHLD, SIG_IGN);
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.loadModuleIsolated(BUS_ISOLATED_MODULE));
+        auto crashFunc = system.instantiateByName<IsolatedFunction>("Crash");
+        BUS_CHECK(crashFunc && throws(*crashFunc));
+        BUS_CHECK(errors.count == 1);
+    }
+    std::signal(SIGCHLD, previous);
+}
+
+// More callers than slots: the ones without a slot sleep until a call
+// frees one. The callers share one proxy.
+static void testBusySlots() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    IsolationConfig config;
+    config.slots = 2;
+    BUS_CHECK(system.loadModuleIsolated(BUS_ISOLATED_MODULE, config));
+    auto echoFunc = system.instantiateByName<IsolatedFunction>("Echo");
+    BUS_CHECK(echoFunc);
+    if(!echoFunc)
+        return;
+    std::atomic_size_t wrong{ 0 };
+    std::vector<std::thread> callers;
+    for(size_t t = 0; t < 6; ++t)
+        callers.emplace_back([&, t] {
+            std::string in = "caller" + std::to_string(t), out;
+            for(size_t i = 0; i < 200; ++i)
+                if(echo(*echoFunc, in, out) != in.size() || out != in)
+                    ++wrong;
+        });
+    for(auto&& caller : callers)
+        caller.join();
+    BUS_CHECK(wrong == 0);
+    BUS_CHECK(errors.count == 0);
+}
+
+// A missing host executable fails the load instead of hanging.
+static void testMissingHost() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    IsolationConfig config;
+    config.host = BusTest::tempDir("BusIsolated") / "missing";
+    bool failed = false;
+    try {
+        system.loadModuleIsolated(BUS_ISOLATED_MODULE, config);
+    } catch(...) {
+        failed = true;
+    }
+    BUS_CHECK(failed && system.listModules().empty());
+}
+
+int main() {
+    testCalls();
+    testIgnoredChildSignal();
+    testBusySlots();
+    testMissingHost();
+    return BusTest::finish();
+}
@@ -0,0 +1,133 @@
+#include "BusManifest.hpp"
+#include "BusTest.hpp"
+
+using namespace Bus;
+using namespace BusBench;
+
+// Modules without a manifest are ordered by busGetDependencies. Module 0
+// sorts first but only initializes after module 1.
+static void testExportedDependencies() {
+    auto dir = BusTest::tempDir("BusTestLoader");
+    BusTest::copyModule(dir, 0, 1, 1, { 1 });
+    BusTest::copyModule(dir, 1, 1, 1);
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    BUS_CHECK(system.loadModuleDirectory(dir, 1) == 2);
+    BUS_CHECK(errors.count == 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+// 2 <-> 3 and 5 <-> 6 are cycles, 4 sits between them and 7 depends on
+// the second one. Only cycle members are reported as such.
+static void testCycles() {
+    auto dir = BusTest::tempDir("BusTestLoader");
+    BusTest::copyModule(dir, 1, 1, 1);
+    BusTest::copyModule(dir, 2, 1, 1, { 3 });
+    BusTest::copyModule(dir, 3, 1, 1, { 1, 2 });
+    BusTest::copyModule(dir, 4, 1, 1, { 2 });
+    BusTest::copyModule(dir, 5, 1, 1, { 4, 6 });
+    BusTest::copyModule(dir, 6, 1, 1, { 5 });
+    BusTest::copyModule(dir, 7, 1, 1, { 5 });
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    BUS_CHECK(system.loadModuleDirectory(dir, 2) == 1);
+    const char* member = "is part of a dependency cycle";
+    const char* downstream = "depends on a dependency cycle";
+    for(auto name : { "synth_2_", "synth_3_", "synth_5_", "synth_6_" }) {
+        BUS_CHECK(errors.matching(name, member) == 1);
+        BUS_CHECK(errors.matching(name, downstream) == 0);
+    }
+    for(auto name : { "synth_4_", "synth_7_" }) {
+        BUS_CHECK(errors.matching(name, member) == 0);
+        BUS_CHECK(errors.matching(name, downstream) == 1);
+    }
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+// The preloader opens every module with LoadPolicy::Now, so it reports
+// the one with a missing function and leaves it to the lazy load.
+static void testPreload() {
+    auto dir = BusTest::tempDir("BusTestLoader");
+    BusTest::copyModule(dir, 0, 1, 1);
+    BusTest::copyModule(dir, 1, 1, 1);
+#ifdef BUS_UNRESOLVED_MODULE
+    fs::path source = BUS_UNRESOLVED_MODULE;
+    fs::copy_file(source, syntheticFile(dir, 2, 1, 1, source.extension()));
+    size_t count = 3;
+#else
+    size_t count = 2;
+#endif
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    system.preloadModules(dir);
+    system.waitPreload();
+    BUS_CHECK(errors.warned("synth_2_", "Failed to preload module") ==
+              count - 2);
+    BUS_CHECK(system.loadModuleDirectory(dir, 1) == count);
+    BUS_CHECK(errors.count == 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+#ifdef BUS_UNRESOLVED_MODULE
+// Lazy binding leaves the missing function until its first call, which
+// never comes. LoadPolicy::Now fails the load instead.
+static void testLoadPolicy() {
+    auto dir = BusTest::tempDir("BusTestLoader");
+    fs::path source = BUS_UNRESOLVED_MODULE;
+    fs::copy_file(source, syntheticFile(dir, 0, 1, 1, source.extension()));
+    {
+        ModuleSystem system(std::make_shared<Reporter>(), [] {});
+        BUS_CHECK(system.getLoadPolicy() == LoadPolicy::Lazy);
+        BUS_CHECK(system.loadModuleDirectory(dir, 1) == 1);
+    }
+    ModuleSystem system(std::make_shared<Reporter>(), [] {});
+    system.setLoadPolicy(LoadPolicy::Now);
+    BUS_CHECK(system.getLoadPolicy() == LoadPolicy::Now);
+    BUS_CHECK(system.loadModuleDirectory(dir, 1) == 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+// The module links to a library in a directory dlopen doesn't search. Its
+// ModuleInfo comes too late to help, but the manifest is read first.
+static void testThirdPartySearchPath() {
+    auto dir = BusTest::tempDir("BusTestLoader");
+    fs::path source = BUS_LINKED_MODULE;
+    fs::path library = BUS_THIRD_PARTY;
+    auto file = syntheticFile(dir, 0, 1, 1, source.extension());
+    fs::copy_file(source, file);
+    fs::create_directories(dir / "third");
+    fs::copy_file(library, dir / "third" / library.filename());
+    {
+        ModuleSystem system(std::make_shared<Reporter>(), [] {});
+        BUS_CHECK(system.loadModuleDirectory(dir, 1) == 0);
+    }
+    ModuleInfo info;
+    info.name = "linked";
+    info.guid = syntheticGUID(0);
+    info.thirdPartySearchPath = { "third" };
+    ModuleManifest(info, {}).write(ModuleManifest::pathOf(file));
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    BUS_CHECK(system.loadModuleDirectory(dir, 1) == 1);
+    BUS_CHECK(system.instantiate<BenchFunction>(
+        FunctionId(syntheticGUID(0), "F0")));
+    BUS_CHECK(errors.count == 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+#endif
+
+int main() {
+    testExportedDependencies();
+    testCycles();
+    testPreload();
+#ifdef BUS_UNRESOLVED_MODULE
+    testLoadPolicy();
+    testThirdPartySearchPath();
+#endif
+    return BusTest::finish();
+}
@@ -0,0 +1,104 @@
+#include "BusManifest.hpp"
+#include "BusMetrics.hpp"
+#include "BusTest.hpp"
+#include <fstream>
+#include <mutex>
+
+using namespace Bus;
+using namespace BusBench;
+
+// Keeps every message at or above Warning.
+struct Messages final {
+    std::shared_ptr<Reporter> reporter = std::make_shared<Reporter>();
+    std::mutex mutex;
+    std::vector<std::string> text;
+    Messages() {
+        for(auto level : { ReportLevel::Warning, ReportLevel::Error })
+            reporter->addAction(level,
+                                [this](ReportLevel, const std::string& msg,
+                                       const SourceLocation&) {
+                                    std::lock_guard guard(mutex);
+                                    text.push_back(msg);
+                                });
+    }
+    bool contains(const std::string& str) {
+        std::lock_guard guard(mutex);
+        for(auto&& msg : text)
+            if(msg.find(str) != std::string::npos)
+                return true;
+        return false;
+    }
+};
+
+// A manifest older than its library must not be trusted.
+static void testStale() {
+    auto dir = BusTest::tempDir("BusTestManifest");
+    auto path = BusTest::copyModule(dir, 0, 1, 2);
+    {
+        ModuleSystem system(std::make_shared<Reporter>(), [] {});
+        BUS_CHECK(system.generateManifest(path));
+    }
+    BUS_CHECK(ModuleManifest::read(ModuleManifest::pathOf(path))
+                  .describes(path));
+    fs::last_write_time(path, fs::last_write_time(path) +
+                                  std::chrono::seconds(10));
+    BUS_CHECK(!ModuleManifest::read(ModuleManifest::pathOf(path))
+                   .describes(path));
+    Messages messages;
+    {
+        ModuleSystem system(messages.reporter, [] {});
+        system.enableStats(true);
+        BUS_CHECK(system.loadModuleLazily(path));
+        BUS_CHECK(messages.contains("out of date"));
+        auto stats = system.stats();
+        BUS_CHECK(stats.size() == 1 && stats[0].loadNs != 0);
+    }
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+// A module that fails to load on first use is loaded on a later use, and
+// the failure is not reported as a missing function.
+static void testRetry() {
+    auto dir = BusTest::tempDir("BusTestManifest");
+    auto path = BusTest::copyModule(dir, 0, 1, 2);
+    Messages messages;
+    {
+        ModuleSystem system(messages.reporter, [] {});
+        BUS_CHECK(system.generateManifest(path));
+        BUS_CHECK(system.loadModuleLazily(path));
+        // Keeps the stamp, only the contents become unloadable.
+        auto time = fs::last_write_time(path);
+        std::ofstream(path, std::ios::trunc) << "not a library";
+        fs::last_write_time(path, time);
+        FunctionId id(syntheticGUID(0), "F1");
+        BUS_CHECK(!system.getHandle<BenchFunction>(id));
+        BUS_CHECK(!system.instantiate<BenchFunction>(id));
+        BUS_CHECK(messages.contains("failed to load"));
+        BUS_CHECK(!messages.contains("doesn't have function"));
+        BusTest::copyModule(dir, 0, 1, 2);
+        auto handle = system.getHandle<BenchFunction>(id);
+        BUS_CHECK(handle && handle.create());
+        BUS_CHECK(system.instantiate<BenchFunction>(id));
+    }
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+static void testGenerateFailure() {
+    auto dir = BusTest::tempDir("BusTestManifest");
+    auto path = dir / "broken.so";
+    std::ofstream(path) << "not a library";
+    ModuleSystem system(std::make_shared<Reporter>(), [] {});
+    BUS_CHECK(!system.generateManifest(path));
+    BUS_CHECK(!fs::exists(ModuleManifest::pathOf(path)));
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+int main() {
+    testStale();
+    testRetry();
+    testGenerateFailure();
+    return BusTest::finish();
+}
@@ -0,0 +1,85 @@
+#include "BusMemory.hpp"
+#include "BusTest.hpp"
+#include <thread>
+#include <vector>
+
+using namespace Bus;
+
+// A reporter action may look at the stats while the warning is reported.
+static void testReportFromAction() {
+    auto reporter = std::make_shared<Reporter>();
+    ModuleSystem system(reporter, [] { std::terminate(); });
+    std::vector<MemoryStats> seen;
+    reporter->addAction(ReportLevel::Warning,
+                        [&](ReportLevel, const std::string&,
+                            const SourceLocation&) {
+                            seen = system.memoryStats();
+                        });
+    auto memory = system.createModuleMemory();
+    memory->label(GUID(1, 2), "Memory");
+    BUS_CHECK(system.setMemoryLimit(GUID(1, 2), 1024));
+    void* ptr = memory->allocate(2048);
+    BUS_CHECK(seen.size() == 1 && seen[0].live == 2048 &&
+              seen[0].name == "Memory");
+    memory->deallocate(ptr, 2048);
+}
+
+// Pools must not depend on a per-resource thread key, there can be more
+// modules than keys.
+static void testManyModules() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    std::vector<std::shared_ptr<ModuleMemory>> memories;
+    std::vector<void*> blocks;
+    for(size_t i = 0; i < 2048; ++i) {
+        memories.push_back(system.createModuleMemory());
+        blocks.push_back(memories.back()->allocate(64));
+    }
+    auto stats = system.memoryStats();
+    BUS_CHECK(stats.size() == memories.size());
+    for(auto&& module : stats)
+        BUS_CHECK(module.live == 64 && module.allocations == 1);
+    for(size_t i = 0; i < blocks.size(); ++i)
+        memories[i]->deallocate(blocks[i], 64);
+    BUS_CHECK(errors.count == 0);
+}
+
+static void testConcurrent(MemoryKind kind) {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    MemoryConfig config;
+    config.kind = kind;
+    system.setMemoryConfig(config);
+    auto memory = system.createModuleMemory();
+    constexpr size_t threads = 4, rounds = 2000;
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            std::vector<std::pair<void*, size_t>> live;
+            for(size_t i = 0; i < rounds; ++i) {
+                size_t size = 16 + (i * 7 + t) % 500;
+                live.emplace_back(memory->allocate(size), size);
+                if(i % 3 == 2) {
+                    memory->deallocate(live.front().first,
+                                       live.front().second);
+                    live.erase(live.begin());
+                }
+            }
+            for(auto [ptr, size] : live)
+                memory->deallocate(ptr, size);
+        });
+    for(auto&& worker : workers)
+        worker.join();
+    auto stats = memory->stats();
+    BUS_CHECK(stats.live == 0 && stats.peak != 0);
+    BUS_CHECK(stats.allocations == threads * rounds);
+    BUS_CHECK(errors.count == 0);
+}
+
+int main() {
+    testReportFromAction();
+    testManyModules();
+    testConcurrent(MemoryKind::Pool);
+    testConcurrent(MemoryKind::Monotonic);
+    return BusTest::finish();
+}
@@ -0,0 +1,129 @@
+#include "BusMessage.hpp"
+#include "BusTest.hpp"
+#include <thread>
+#include <vector>
+
+using namespace Bus;
+
+// Every policy delivers in order what fits and accounts for the rest.
+static void testPolicies() {
+    BusTest::Errors errors;
+    MessageBus bus(errors.reporter);
+    auto publisher = bus.publisher<int>("numbers");
+    auto drop = bus.subscribe<int>("numbers", 4, OverflowPolicy::Drop);
+    auto oldest =
+        bus.subscribe<int>("numbers", 4, OverflowPolicy::DropOldest);
+    for(int i = 0; i < 6; ++i)
+        BUS_CHECK(publisher.publish(int(i)) == (i < 4 ? 2 : 1));
+    std::vector<std::shared_ptr<const int>> batch;
+    BUS_CHECK(drop.poll(batch, 16) == 4 && *batch.front() == 0);
+    std::vector<int> values;
+    BUS_CHECK(oldest.poll([&](const int& value) { values.push_back(value); },
+                          16) == 4);
+    BUS_CHECK(values == std::vector<int>({ 2, 3, 4, 5 }));
+    auto stats = bus.stats();
+    BUS_CHECK(stats.size() == 1 && stats[0].subscribers == 2);
+    BUS_CHECK(stats[0].published == 6 && stats[0].delivered == 10);
+    BUS_CHECK(stats[0].dropped == 2 && stats[0].overwritten == 2);
+    BUS_CHECK(errors.count == 0);
+}
+
+// A publisher blocked on a full mailbox gives up once its subscriber is
+// gone.
+static void testBlockedPublisher() {
+    BusTest::Errors errors;
+    MessageBus bus(errors.reporter);
+    auto subscription =
+        bus.subscribe<int>("blocked", 2, OverflowPolicy::Block);
+    std::atomic_size_t published{ 0 };
+    std::thread thread([&] {
+        auto publisher = bus.publisher<int>("blocked");
+        for(int i = 0; i < 100; ++i)
+            publisher.publish(int(i));
+        published = 100;
+    });
+    while(bus.stats()[0].delivered < 2)
+        std::this_thread::yield();
+    subscription.reset();
+    thread.join();
+    BUS_CHECK(published == 100);
+    BUS_CHECK(errors.count == 0);
+}
+
+// A blocked publisher sleeps until the consumer makes room, then goes on
+// in order.
+static void testBlockedResumes() {
+    BusTest::Errors errors;
+    MessageBus bus(errors.reporter);
+    auto subscription =
+        bus.subscribe<int>("resumed", 2, OverflowPolicy::Block);
+    std::thread thread([&] {
+        auto publisher = bus.publisher<int>("resumed");
+        for(int i = 0; i < 100; ++i)
+            publisher.publish(int(i));
+    });
+    std::vector<int> values;
+    while(values.size() < 100) {
+        subscription.wait(std::chrono::milliseconds(10));
+        subscription.poll([&](const int& value) { values.push_back(value); },
+                          1);
+    }
+    thread.join();
+    bool ordered = true;
+    for(int i = 0; i < 100; ++i)
+        ordered &= values[static_cast<size_t>(i)] == i;
+    BUS_CHECK(ordered);
+    BUS_CHECK(bus.stats()[0].delivered == 100 && errors.count == 0);
+}
+
+// The first user of a topic fixes its payload type.
+static void testTypeMismatch() {
+    BusTest::Errors errors;
+    MessageBus bus(errors.reporter);
+    auto publisher = bus.publisher<int>("typed");
+    BUS_CHECK(publisher && errors.count == 0);
+    auto subscription = bus.subscribe<std::string>("typed");
+    BUS_CHECK(!subscription && errors.count == 1);
+    std::vector<std::shared_ptr<const std::string>> batch;
+    BUS_CHECK(subscription.poll(batch, 1) == 0);
+    auto other = bus.publisher<double>("typed");
+    BUS_CHECK(!other && other.publish(1.0) == 0 && errors.count == 2);
+    BUS_CHECK(bus.subscribe<int>("typed") && errors.count == 2);
+}
+
+// Subscribers come and go while messages are published.
+static void testChurn() {
+    BusTest::Errors errors;
+    MessageBus bus(errors.reporter);
+    std::atomic_bool stop{ false };
+    std::thread publisher([&] {
+        auto topic = bus.publisher<int>("churn");
+        while(!stop)
+            topic.publish(1);
+    });
+    std::vector<std::thread> subscribers;
+    for(size_t t = 0; t < 3; ++t)
+        subscribers.emplace_back([&] {
+            for(size_t i = 0; i < 200; ++i) {
+                auto subscription =
+                    bus.subscribe<int>("churn", 8, OverflowPolicy::Block);
+                subscription.wait(std::chrono::milliseconds(1));
+                subscription.poll([](const int&) {}, 8);
+            }
+        });
+    for(auto&& thread : subscribers)
+        thread.join();
+    stop = true;
+    publisher.join();
+    BUS_CHECK(bus.stats()[0].subscribers == 0);
+    BUS_CHECK(errors.count == 0);
+}
+
+int main() {
+    testPolicies();
+    testBlockedPublisher();
+    testBlockedResumes();
+    testTypeMismatch();
+    testChurn();
+    return BusTest::finish();
+}
@@ -0,0 +1,109 @@
+#include "BusMetrics.hpp"
+#include "BusTest.hpp"
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace Bus;
+using namespace BusBench;
+
+static std::string micros(uint64_t ns) {
+    std::stringstream out;
+    writeMicroseconds(out, ns);
+    return out.str();
+}
+
+// Timestamps an hour into the run must keep their nanoseconds.
+static void testMicroseconds() {
+    BUS_CHECK(micros(0) == "0.000");
+    BUS_CHECK(micros(7) == "0.007");
+    BUS_CHECK(micros(1234567) == "1234.567");
+    BUS_CHECK(micros(3600000000001ULL) == "3600000000.001");
+}
+
+// Every thread must get the same counters for a name, however the table
+// grows underneath.
+static void testFunctionTable() {
+    ModuleMetrics module(GUID(1, 2), "Module", 0, 0);
+    std::vector<std::string> names;
+    for(size_t i = 0; i < 64; ++i)
+        names.push_back("F" + std::to_string(i));
+    std::vector<std::vector<FunctionMetrics*>> seen(4);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < seen.size(); ++t)
+        threads.emplace_back([&, t] {
+            for(size_t i = 0; i < names.size(); ++i)
+                seen[t].push_back(
+                    &module.function(names[(i + t * 16) % names.size()]));
+        });
+    for(auto&& thread : threads)
+        thread.join();
+    for(size_t t = 0; t < seen.size(); ++t)
+        for(size_t i = 0; i < names.size(); ++i) {
+            auto ptr = seen[t][i];
+            BUS_CHECK(ptr->name() == names[(i + t * 16) % names.size()]);
+            BUS_CHECK(ptr == &module.function(ptr->name()));
+        }
+    BUS_CHECK(module.stats().functions.size() == names.size());
+}
+
+// Resizing the trace buffer must not free it under concurrent pushes.
+static void testTraceResize() {
+    SystemMetrics metrics;
+    std::atomic_bool stop{ false };
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < 4; ++t)
+        threads.emplace_back([&] {
+            while(!stop)
+                metrics.trace("test", "Module", "F", metrics.now(), 1);
+        });
+    for(size_t i = 0; i < 200; ++i)
+        metrics.enableTrace(i % 3 ? 16 + i : 0);
+    stop = true;
+    for(auto&& thread : threads)
+        thread.join();
+    metrics.trace("test", "Module", "F", metrics.now(), 1);
+    std::stringstream out;
+    metrics.exportTrace(out);
+    BUS_CHECK(out.str().find("\"Module.F\"") != std::string::npos);
+    // The export drained the buffer.
+    std::stringstream again;
+    metrics.exportTrace(again);
+    BUS_CHECK(again.str().find("\"Module.F\"") == std::string::npos);
+}
+
+// A lazily registered module reports its load time once it is used.
+static void testLazyLoadStats() {
+    auto dir = BusTest::tempDir("BusTestMetrics");
+    auto path = BusTest::copyModule(dir, 0, 1, 2);
+    BusTest::Errors errors;
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.generateManifest(path));
+        system.enableStats(true);
+        system.enableTrace(64);
+        BUS_CHECK(system.loadModuleLazily(path));
+        auto stats = system.stats();
+        BUS_CHECK(stats.size() == 1 && stats[0].loadNs == 0);
+        BUS_CHECK(system.instantiate<BenchFunction>(
+            FunctionId(syntheticGUID(0), "F1")));
+        stats = system.stats();
+        BUS_CHECK(stats.size() == 1 && stats[0].loadNs != 0);
+        BUS_CHECK(stats[0].functions.size() == 1 &&
+                  stats[0].functions[0].instantiations == 1);
+        std::stringstream out;
+        system.exportTrace(out);
+        BUS_CHECK(out.str().find("\"cat\":\"load\"") != std::string::npos);
+    }
+    BUS_CHECK(errors.count == 0);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+int main() {
+    testMicroseconds();
+    testFunctionTable();
+    testTraceResize();
+    testLazyLoadStats();
+    return BusTest::finish();
+}
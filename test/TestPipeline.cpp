@@ -0,0 +1,133 @@
+#include "BusPipeline.hpp"
+#include "BusStatic.hpp"
+#include "BusTest.hpp"
+#include <numeric>
+
+using namespace Bus;
+
+namespace {
+    class IntStage : public BatchFunction<int> {
+    protected:
+        explicit IntStage(ModuleInstance& instance)
+            : BatchFunction<int>(instance) {}
+
+    public:
+        static Name getInterface() {
+            return "TestPipeline.IntStage";
+        }
+    };
+
+    class Increment final : public IntStage {
+    public:
+        explicit Increment(ModuleInstance& instance) : IntStage(instance) {}
+        void apply(int& item) override {
+            ++item;
+        }
+    };
+
+    class Twice final : public IntStage {
+    public:
+        explicit Twice(ModuleInstance& instance) : IntStage(instance) {}
+        void apply(int& item) override {
+            item *= 2;
+        }
+    };
+
+    // Fails on the item 1000.
+    class Fail final : public IntStage {
+    public:
+        explicit Fail(ModuleInstance& instance) : IntStage(instance) {}
+        void apply(int& item) override {
+            if(item == 1000)
+                throw std::runtime_error("Stage failed");
+        }
+    };
+}  // namespace
+
+BUS_STATIC_MODULE(TestPipeline, "TestPipeline", GUID(0x919E, 1), "1.0.0", "",
+                  "", BUS_STATIC_FUNCTION(IntStage, "Increment", Increment),
+                  BUS_STATIC_FUNCTION(IntStage, "Twice", Twice),
+                  BUS_STATIC_FUNCTION(IntStage, "Fail", Fail));
+
+static std::vector<int> iota(size_t count) {
+    std::vector<int> items(count);
+    std::iota(items.begin(), items.end(), 0);
+    return items;
+}
+
+// Both modes run every stage over every item, in stage order.
+static void testRun() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(loadStaticModules(system) == 1);
+    for(bool parallel : { false, true }) {
+        PipelineConfig config;
+        config.batchSize = 64;
+        config.parallel = parallel;
+        auto pipeline = system.getPipelineByName<IntStage>(
+            { "Increment", "Twice", "Increment" }, config);
+        BUS_CHECK(pipeline && pipeline->stageCount() == 3);
+        if(!pipeline)
+            continue;
+        auto items = iota(10000);
+        pipeline->run(items);
+        bool ok = true;
+        for(size_t i = 0; i < items.size(); ++i)
+            ok &= items[i] == static_cast<int>(i + 1) * 2 + 1;
+        BUS_CHECK(ok);
+        auto stats = pipeline->stats();
+        BUS_CHECK(stats.size() == 3 && stats[1].name == "Twice" &&
+                  stats[1].batches == 157 && stats[1].items == 10000);
+    }
+    BUS_CHECK(errors.count == 0);
+}
+
+// The first failure reaches the caller, in both modes.
+static void testFailure() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    loadStaticModules(system);
+    for(bool parallel : { false, true }) {
+        PipelineConfig config;
+        config.batchSize = 16;
+        config.parallel = parallel;
+        auto pipeline = system.getPipelineByName<IntStage>(
+            { "Increment", "Fail", "Twice" }, config);
+        BUS_CHECK(pipeline);
+        if(!pipeline)
+            continue;
+        auto items = iota(4096);
+        bool thrown = false;
+        try {
+            pipeline->run(items);
+        } catch(const std::runtime_error&) {
+            thrown = true;
+        }
+        BUS_CHECK(thrown);
+    }
+    BUS_CHECK(errors.count == 0);
+}
+
+// An unknown stage is reported once, with its name.
+static void testUnknownStage() {
+    auto reporter = std::make_shared<Reporter>();
+    std::vector<std::string> messages;
+    reporter->addAction(ReportLevel::Error,
+                        [&](ReportLevel, const std::string& message,
+                            const SourceLocation&) {
+                            messages.push_back(message);
+                        });
+    ModuleSystem system(reporter, [] { std::terminate(); });
+    loadStaticModules(system);
+    auto pipeline = system.getPipelineByName<IntStage>(
+        { "Increment", "Missing" }, PipelineConfig{});
+    BUS_CHECK(!pipeline && messages.size() == 1 &&
+              messages[0].find("Missing") != std::string::npos);
+}
+
+int main() {
+    testRun();
+    testFailure();
+    testUnknownStage();
+    return BusTest::finish();
+}
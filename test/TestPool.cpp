@@ -0,0 +1,96 @@
+#include "BusPool.hpp"
+#include "BusSynthetic.hpp"
+#include "BusTest.hpp"
+#include <iterator>
+
+using namespace BusBench;
+
+namespace {
+    class TableFunction final : public BenchFunction {
+    public:
+        explicit TableFunction(ModuleInstance& instance)
+            : BenchFunction(instance) {}
+        uint64_t value() override {
+            return 7;
+        }
+    };
+
+    const FactoryEntry table[] = {
+        BUS_FACTORY(BenchFunction, "F1", TableFunction),
+    };
+
+    // As written by a module built against another layout.
+    const FactoryEntry otherVersion[] = {
+        [] {
+            auto entry = BUS_FACTORY(BenchFunction, "F1", TableFunction);
+            entry.version = factoryEntryVersion + 1;
+            return entry;
+        }(),
+    };
+}  // namespace
+
+static std::shared_ptr<ModuleInstance> synthetic(ModuleSystem& system) {
+    return std::make_shared<SyntheticInstance>("", system, 0, 1, 2);
+}
+
+static const FunctionId id(syntheticGUID(0), "F1");
+
+// Batches give their bytes back, chunks keep theirs until the pool goes.
+static void testBytes() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(synthetic, table, std::size(table)));
+    auto pool = system.getPool<BenchFunction>(id, 4);
+    BUS_CHECK(pool.stats().bytes == 0);
+    std::vector<std::shared_ptr<BenchFunction>> objects;
+    for(size_t i = 0; i < 6; ++i)
+        objects.push_back(pool.create());
+    auto stats = pool.stats();
+    BUS_CHECK(stats.chunks == 2 && stats.bytes != 0);
+    auto chunkBytes = stats.bytes;
+    for(size_t round = 0; round < 3; ++round) {
+        auto batch = pool.create(16);
+        BUS_CHECK(batch.size() == 16 && batch[15]->value() == 7);
+        stats = pool.stats();
+        BUS_CHECK(stats.batches == 1 && stats.bytes > chunkBytes);
+    }
+    objects.clear();
+    stats = pool.stats();
+    BUS_CHECK(stats.batches == 0 && stats.bytes == chunkBytes);
+    BUS_CHECK(errors.count == 0);
+}
+
+// Only the pooled objects hold a replaced version back, not the pool.
+static void testDrain() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(synthetic, table, std::size(table)));
+    auto pool = system.getPool<BenchFunction>(id);
+    auto object = pool.create();
+    BUS_CHECK(system.reloadBuiltin(synthetic, table, std::size(table)));
+    BUS_CHECK(!pool && !pool.create() && pool.create(4).empty());
+    BUS_CHECK(system.drainRetired() == 1);
+    BUS_CHECK(object->value() == 7);
+    object.reset();
+    BUS_CHECK(system.drainRetired() == 0);
+    BUS_CHECK(errors.count == 0);
+}
+
+// A table of another layout is ignored, the module's own instantiate
+// answers instead and nothing can be pooled.
+static void testVersion() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(synthetic, otherVersion,
+                                 std::size(otherVersion)));
+    BUS_CHECK(system.instantiate<BenchFunction>(id)->value() == 1);
+    BUS_CHECK(!system.getPool<BenchFunction>(id));
+    BUS_CHECK(errors.count == 1);
+}
+
+int main() {
+    testBytes();
+    testDrain();
+    testVersion();
+    return BusTest::finish();
+}
@@ -0,0 +1,84 @@
+#define BUS_ENABLE_PROFILER
+#include "BusTest.hpp"
+#include <sstream>
+#include <thread>
+
+using namespace Bus;
+
+static int traced(int depth) {
+    BUS_TRACE_BEGIN("TestProfiler") {
+        return depth ? traced(depth - 1) + 1 : 0;
+    }
+    BUS_TRACE_END();
+}
+
+static const ScopeStats* find(const std::vector<ScopeStats>& stats,
+                              const std::string& function) {
+    for(auto&& scope : stats)
+        if(scope.function == function)
+            return &scope;
+    return nullptr;
+}
+
+static void testStats() {
+    resetProfile();
+    enableProfiler(true);
+    for(int i = 0; i < 10; ++i)
+        traced(2);
+    enableProfiler(false);
+    traced(2);
+    auto stats = profileStats();
+    auto scope = find(stats, "traced");
+    BUS_CHECK(scope && scope->module == "TestProfiler" && scope->calls == 30);
+    BUS_CHECK(scope && scope->exclusiveNs <= scope->inclusiveNs);
+}
+
+// Spans keep their names after the strings they were recorded with are
+// gone, as with an unloaded module.
+static void testOwnedStrings() {
+    resetProfile();
+    enableProfiler(true);
+    std::string module = "Unloaded", file = "Unloaded.cpp",
+                function = "unloadedFunction";
+    { ProfileScope scope(module.c_str(), file.c_str(), function.c_str(), 1); }
+    enableProfiler(false);
+    Detail::profileUnload();
+    module.assign(module.size(), 'x');
+    file.assign(file.size(), 'x');
+    function.assign(function.size(), 'x');
+    auto stats = profileStats();
+    auto scope = find(stats, "unloadedFunction");
+    BUS_CHECK(scope && scope->module == "Unloaded" &&
+              scope->srcFile == "Unloaded.cpp");
+    std::stringstream out;
+    exportProfile(out);
+    BUS_CHECK(out.str().find("\"unloadedFunction\"") != std::string::npos);
+}
+
+// Timestamps past one second keep microsecond resolution.
+static void testTimestamps() {
+    resetProfile();
+    enableProfiler(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    traced(0);
+    enableProfiler(false);
+    std::stringstream out;
+    exportProfile(out);
+    auto json = out.str();
+    auto pos = json.find("\"ts\":");
+    BUS_CHECK(pos != std::string::npos);
+    if(pos == std::string::npos)
+        return;
+    auto end = json.find(',', pos);
+    auto ts = json.substr(pos + 5, end - pos - 5);
+    auto dot = ts.find('.');
+    BUS_CHECK(ts.find('e') == std::string::npos && dot != std::string::npos &&
+              ts.size() - dot == 4 && std::stoull(ts) >= 1000000);
+}
+
+int main() {
+    testStats();
+    testOwnedStrings();
+    testTimestamps();
+    return BusTest::finish();
+}
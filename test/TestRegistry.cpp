@@ -0,0 +1,109 @@
+#include "BusSynthetic.hpp"
+#include "BusTest.hpp"
+#include <thread>
+#include <vector>
+
+using namespace BusBench;
+
+static std::shared_ptr<ModuleInstance>
+synthetic(ModuleSystem& system, uint64_t index, size_t functions) {
+    return std::make_shared<SyntheticInstance>("", system, index, 2,
+                                               functions);
+}
+
+// Indexes built before a load must pick up the new module's functions.
+static void testIndexAfterLoad() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.listFunctions("Bench.Interface1").empty());
+    BUS_CHECK(system.wrapBuiltin(
+        [](ModuleSystem& sys) { return synthetic(sys, 0, 3); }));
+    BUS_CHECK(system.listFunctions("Bench.Interface1").size() == 3);
+    BUS_CHECK(system.listFunctions("Bench.Interface2").empty());
+    BUS_CHECK(system.wrapBuiltin(
+        [](ModuleSystem& sys) { return synthetic(sys, 1, 2); }));
+    BUS_CHECK(system.listFunctions("Bench.Interface1").size() == 5);
+    BUS_CHECK(system.parse("Synthetic1.F1", "Bench.Interface1").first ==
+              syntheticGUID(1));
+    // Same GUID again.
+    BUS_CHECK(!system.wrapBuiltin(
+        [](ModuleSystem& sys) { return synthetic(sys, 1, 2); }));
+    BUS_CHECK(system.listModules().size() == 2);
+    BUS_CHECK(errors.count == 0);
+}
+
+// Lists come out by GUID whatever the load order.
+static void testOrder() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    for(uint64_t i = 40; i-- > 0;) {
+        BUS_CHECK(system.wrapBuiltin(
+            [i](ModuleSystem& sys) { return synthetic(sys, i, 2); }));
+        if(i % 7 == 0)
+            system.listFunctions("Bench.Interface0");
+    }
+    auto modules = system.listModules();
+    BUS_CHECK(modules.size() == 40);
+    for(size_t i = 0; i < modules.size(); ++i)
+        BUS_CHECK(modules[i].guid == syntheticGUID(i));
+    auto functions = system.listFunctions("Bench.Interface0");
+    BUS_CHECK(functions.size() == 80);
+    for(size_t i = 0; i < functions.size(); ++i) {
+        BUS_CHECK(functions[i].guid == syntheticGUID(i / 2));
+        BUS_CHECK(functions[i].name == (i % 2 ? "F1" : "F0"));
+    }
+}
+
+// Loads race with lookups: readers must always see a consistent snapshot
+// and never lose a module that was registered before they started.
+static void testConcurrentLoads() {
+    constexpr size_t modules = 200, functions = 4, readers = 4;
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(system.wrapBuiltin(
+        [](ModuleSystem& sys) { return synthetic(sys, 0, functions); }));
+    std::atomic_bool done{ false };
+    std::atomic_size_t bad{ 0 }, lookups{ 0 };
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < readers; ++t)
+        threads.emplace_back([&, t] {
+            size_t last = 0;
+            for(uint64_t i = 0; !done.load() || i < 1000; ++i) {
+                auto func = system.instantiate<BenchFunction>(
+                    FunctionId(syntheticGUID(0), "F1"));
+                if(!func || func->value() != 1)
+                    ++bad;
+                if(!system.instantiateByName<BenchFunction>("Synthetic0.F2"))
+                    ++bad;
+                size_t size =
+                    system.listFunctions(t % 2 ? "Bench.Interface0" :
+                                                 "Bench.Interface1")
+                        .size();
+                if(size % functions || size < last)
+                    ++bad;
+                last = size;
+                ++lookups;
+            }
+        });
+    for(size_t i = 1; i < modules; ++i)
+        if(!system.wrapBuiltin([i](ModuleSystem& sys) {
+               return synthetic(sys, i, functions);
+           }))
+            ++bad;
+    done = true;
+    for(auto&& thread : threads)
+        thread.join();
+    BUS_CHECK(bad == 0);
+    BUS_CHECK(lookups >= readers * 1000);
+    BUS_CHECK(system.listModules().size() == modules);
+    BUS_CHECK(system.listFunctions("Bench.Interface0").size() ==
+              modules * functions);
+    BUS_CHECK(errors.count == 0);
+}
+
+int main() {
+    testIndexAfterLoad();
+    testOrder();
+    testConcurrentLoads();
+    return BusTest::finish();
+}
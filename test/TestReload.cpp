@@ -0,0 +1,107 @@
+#include "BusMetrics.hpp"
+#include "BusStatic.hpp"
+#include "BusTest.hpp"
+
+using namespace Bus;
+using namespace BusBench;
+
+namespace {
+    class TableFunction final : public BenchFunction {
+    public:
+        explicit TableFunction(ModuleInstance& instance)
+            : BenchFunction(instance) {}
+        uint64_t value() override {
+            return 42;
+        }
+    };
+}  // namespace
+
+BUS_STATIC_MODULE(TestReload, "TestReload", GUID(0x7E57, 1), "1.0.0",
+                  "Reload test module", "",
+                  BUS_STATIC_FUNCTION(BenchFunction, "Static",
+                                      TableFunction));
+
+// Objects built from a factory table share one allocation with their
+// control block and keep working with stats enabled.
+static void testTable() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    BUS_CHECK(loadStaticModules(system) == 1);
+    FunctionId id(GUID(0x7E57, 1), "Static");
+    for(bool stats : { false, true }) {
+        system.enableStats(stats);
+        auto object = system.instantiate<BenchFunction>(id);
+        BUS_CHECK(object && object->value() == 42);
+        auto handle = system.getHandle<BenchFunction>(id);
+        BUS_CHECK(handle && handle.create()->value() == 42);
+    }
+    BUS_CHECK(errors.count == 0);
+}
+
+// Reloading from the path that is still mapped would get the old image
+// back. Objects and handles of the old version keep it loaded.
+static void testReload() {
+    auto dir = BusTest::tempDir("BusTestReload");
+    auto path = BusTest::copyModule(dir, 0, 1, 2);
+    BusTest::Errors errors;
+    {
+        ModuleSystem system(errors.reporter, [] {});
+        BUS_CHECK(system.loadModuleFile(path));
+        FunctionId id(syntheticGUID(0), "F1");
+        auto object = system.instantiate<BenchFunction>(id);
+        auto handle = system.getHandle<BenchFunction>(id);
+        BUS_CHECK(object && handle);
+
+        BUS_CHECK(!system.reloadModule(syntheticGUID(0), path));
+        BUS_CHECK(errors.count == 1);
+        BUS_CHECK(handle.valid());
+
+        auto copy = dir / "next";
+        fs::create_directories(copy);
+        BUS_CHECK(system.reloadModule(syntheticGUID(0),
+                                      BusTest::copyModule(copy, 0, 1, 2)));
+        BUS_CHECK(!handle.valid() && !handle.create());
+        BUS_CHECK(system.drainRetired() == 1);
+        object.reset();
+        BUS_CHECK(system.drainRetired() == 1);
+        handle = {};
+        BUS_CHECK(system.drainRetired() == 0);
+        BUS_CHECK(system.instantiate<BenchFunction>(id)->value() == 1);
+    }
+    BUS_CHECK(errors.count == 1);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+// Objects a module builds itself keep its old version alive as well.
+// Only the registered version is listed in stats.
+static void testBuiltin() {
+    BusTest::Errors errors;
+    ModuleSystem system(errors.reporter, [] {});
+    system.enableStats(true);
+    auto synthetic = [](ModuleSystem& sys) {
+        return std::make_shared<SyntheticInstance>("", sys, 0, 1, 1);
+    };
+    BUS_CHECK(system.wrapBuiltin(synthetic));
+    FunctionId id(syntheticGUID(0), "F0");
+    auto object = system.instantiate<BenchFunction>(id);
+    BUS_CHECK(object);
+    BUS_CHECK(system.reloadBuiltin(synthetic));
+    BUS_CHECK(system.stats().size() == 1);
+    BUS_CHECK(system.drainRetired() == 1);
+    BUS_CHECK(object->value() == 0);
+    object.reset();
+    BUS_CHECK(system.drainRetired() == 0);
+    BUS_CHECK(system.instantiate<BenchFunction>(id));
+    auto stats = system.stats();
+    BUS_CHECK(stats.size() == 1 && stats[0].functions.size() == 1 &&
+              stats[0].functions[0].instantiations == 1);
+    BUS_CHECK(errors.count == 0);
+}
+
+int main() {
+    testTable();
+    testReload();
+    testBuiltin();
+    return BusTest::finish();
+}
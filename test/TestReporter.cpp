@@ -0,0 +1,166 @@
+#include "BusTest.hpp"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace Bus;
+
+static void produce(Reporter& reporter, size_t threads, size_t count) {
+    std::vector<std::thread> producers;
+    for(size_t t = 0; t < threads; ++t)
+        producers.emplace_back([&] {
+            for(size_t i = 0; i < count; ++i)
+                reporter.apply(ReportLevel::Info, "record",
+                               BUS_SRCLOC("TestReporter"));
+        });
+    for(auto&& producer : producers)
+        producer.join();
+}
+
+// flush must wait for records other drain threads are still dispatching.
+static void testFlushWithDrainThreads() {
+    Reporter reporter;
+    std::atomic_size_t handled{ 0 };
+    reporter.addAction(ReportLevel::Info,
+                       [&](ReportLevel, const std::string&,
+                           const SourceLocation&) {
+                           if(handled % 64 == 0)
+                               std::this_thread::yield();
+                           ++handled;
+                       });
+    reporter.enableAsync(256, OverflowPolicy::Block, 4);
+    size_t total = 0;
+    for(size_t round = 0; round < 20; ++round) {
+        produce(reporter, 3, 200);
+        total += 600;
+        reporter.flush();
+        BUS_CHECK(handled == total);
+    }
+    BUS_CHECK(reporter.stats().processed == total);
+    reporter.disableAsync();
+    reporter.apply(ReportLevel::Info, "sync", BUS_SRCLOC("TestReporter"));
+    BUS_CHECK(handled == total + 1);
+}
+
+// Records pushed while the drain thread sleeps must be picked up without
+// waiting for another push.
+static void testWakeup() {
+    Reporter reporter;
+    std::atomic_size_t handled{ 0 };
+    reporter.addAction(ReportLevel::Info,
+                       [&](ReportLevel, const std::string&,
+                           const SourceLocation&) { ++handled; });
+    reporter.enableAsync(16, OverflowPolicy::Block, 2);
+    for(size_t i = 0; i < 200; ++i) {
+        reporter.apply(ReportLevel::Info, "record",
+                       BUS_SRCLOC("TestReporter"));
+        auto beg = std::chrono::steady_clock::now();
+        while(handled != i + 1 &&
+              std::chrono::steady_clock::now() - beg <
+                  std::chrono::seconds(5))
+            std::this_thread::yield();
+        BUS_CHECK(handled == i + 1);
+    }
+}
+
+static void testOverflow() {
+    for(auto policy : { OverflowPolicy::Drop, OverflowPolicy::DropOldest }) {
+        Reporter reporter;
+        std::atomic_bool release{ false };
+        std::atomic_size_t handled{ 0 };
+        reporter.addAction(ReportLevel::Info,
+                           [&](ReportLevel, const std::string&,
+                               const SourceLocation&) {
+                               while(!release)
+                                   std::this_thread::yield();
+                               ++handled;
+                           });
+        reporter.enableAsync(8, policy, 1);
+        produce(reporter, 2, 100);
+        release = true;
+        reporter.flush();
+        auto stats = reporter.stats();
+        BUS_CHECK(stats.processed == handled);
+        BUS_CHECK(stats.processed + stats.dropped + stats.overwritten == 200);
+        BUS_CHECK(policy == OverflowPolicy::Drop ? stats.dropped > 0 :
+                                                   stats.overwritten > 0);
+    }
+}
+
+// Drain threads must not wait on each other while running actions.
+static void testConcurrentActions() {
+    Reporter reporter;
+    std::atomic_size_t running{ 0 }, peak{ 0 };
+    reporter.addAction(ReportLevel::Info,
+                       [&](ReportLevel, const std::string&,
+                           const SourceLocation&) {
+                           size_t now = ++running;
+                           size_t seen = peak;
+                           while(seen < now &&
+                                 !peak.compare_exchange_weak(seen, now))
+                               ;
+                           std::this_thread::sleep_for(
+                               std::chrono::milliseconds(2));
+                           --running;
+                       });
+    reporter.enableAsync(64, OverflowPolicy::Block, 4);
+    produce(reporter, 1, 32);
+    reporter.flush();
+    BUS_CHECK(peak > 1);
+}
+
+// An action that reports under Block must not wait on its own full queue.
+static void testReportFromAction() {
+    Reporter reporter;
+    std::atomic_size_t warnings{ 0 };
+    reporter.addAction(ReportLevel::Info,
+                       [&](ReportLevel, const std::string&,
+                           const SourceLocation&) {
+                           BUS_REPORT(reporter, Warning,
+                                      BUS_SRCLOC("TestReporter"), "nested");
+                       });
+    reporter.addAction(ReportLevel::Warning,
+                       [&](ReportLevel, const std::string&,
+                           const SourceLocation&) { ++warnings; });
+    reporter.enableAsync(2, OverflowPolicy::Block, 1);
+    produce(reporter, 2, 100);
+    reporter.flush();
+    BUS_CHECK(warnings == 200);
+}
+
+// Deferred reports format copies of their arguments on the drain thread.
+static void testDeferredFormat() {
+    Reporter reporter;
+    std::mutex mutex;
+    std::vector<std::string> messages;
+    reporter.addAction(ReportLevel::Error,
+                       [&](ReportLevel, const std::string& message,
+                           const SourceLocation&) {
+                           std::lock_guard guard(mutex);
+                           messages.push_back(message);
+                       });
+    reporter.enableAsync(16, OverflowPolicy::Block, 1);
+    {
+        std::string name = "first";
+        char buffer[] = "buffer";
+        const char* null = nullptr;
+        BUS_REPORT(reporter, Error, BUS_SRCLOC("TestReporter"), name, ' ',
+                   std::string_view(buffer), ' ', null, ' ', 42, ' ',
+                   fs::path("a"));
+        name = "second";
+        buffer[0] = 'B';
+    }
+    reporter.flush();
+    BUS_CHECK(messages.size() == 1);
+    BUS_CHECK(messages.front() == "first buffer (null) 42 a");
+}
+
+int main() {
+    testFlushWithDrainThreads();
+    testWakeup();
+    testOverflow();
+    testConcurrentActions();
+    testReportFromAction();
+    testDeferredFormat();
+    return BusTest::finish();
+}
@@ -0,0 +1,122 @@
+#include "BusResult.hpp"
+#include "BusTest.hpp"
+#include <cstring>
+#include <vector>
+
+using namespace Bus;
+
+static Result<int> fail(int depth) {
+    if(depth == 0)
+        BUS_RESULT_FAIL("TestResult", "failed", 7);
+    BUS_RESULT_TRY("TestResult", value, fail(depth - 1));
+    return value + 1;
+}
+
+BUS_MODULE_NAME("TestResult");
+
+// The _DEF forms take the file's module name.
+static Result<void> check(int depth) {
+    if(depth == 0)
+        BUS_RESULT_FAIL_DEF("failed", 8);
+    BUS_RESULT_TRY_DEF(next, Result<int>(depth - 1));
+    BUS_RESULT_CHECK_DEF(check(next));
+    return {};
+}
+
+// Frames of the thrown form, outermost first, and the innermost message.
+static std::vector<int> unwind(std::exception_ptr ptr, std::string& message) {
+    std::vector<int> lines;
+    while(ptr) {
+        try {
+            std::rethrow_exception(ptr);
+        } catch(const SourceLocation& loc) {
+            lines.push_back(loc.line);
+            ptr = nullptr;
+            try {
+                std::rethrow_if_nested(loc);
+            } catch(...) {
+                ptr = std::current_exception();
+            }
+        } catch(const std::exception& ex) {
+            message = ex.what();
+            ptr = nullptr;
+        }
+    }
+    return lines;
+}
+
+static std::vector<int> thrown(Result<int>& res, std::string& message) {
+    try {
+        res.value();
+    } catch(...) {
+        return unwind(std::current_exception(), message);
+    }
+    return {};
+}
+
+static void testTrace() {
+    auto res = fail(3);
+    BUS_CHECK(!res && res.error().code == 7);
+    BUS_CHECK(std::strcmp(res.error().message, "failed") == 0);
+    BUS_CHECK(currentErrorTrace().size == 4);
+    std::string message;
+    auto lines = thrown(res, message);
+    BUS_CHECK(lines.size() == 4 && message == "failed");
+    // The origin is recorded first and ends up innermost.
+    BUS_CHECK(lines.back() == currentErrorTrace().frames[0].line);
+}
+
+static void testDefaultModule() {
+    auto res = check(2);
+    BUS_CHECK(!res && res.error().code == 8);
+    auto&& trace = currentErrorTrace();
+    BUS_CHECK(trace.size == 3);
+    for(size_t i = 0; i < trace.size; ++i)
+        BUS_CHECK(std::strcmp(trace.frames[i].module, "TestResult") == 0);
+}
+
+// A Result kept across another failure doesn't take that failure's frames.
+static void testStaleTrace() {
+    auto kept = fail(1);
+    auto last = fail(2);
+    std::string message;
+    BUS_CHECK(thrown(kept, message).empty() && message == "failed");
+    BUS_CHECK(thrown(last, message).size() == 3);
+    // Nor does forwarding it add to them.
+    auto forward = [&]() -> Result<int> {
+        BUS_RESULT_TRY("TestResult", value, kept);
+        return value;
+    };
+    BUS_CHECK(!forward() && currentErrorTrace().size == 3);
+}
+
+// parse reports what tryParse only returns.
+static void testParseMessages() {
+    auto reporter = std::make_shared<Reporter>();
+    std::vector<std::string> messages;
+    reporter->addAction(ReportLevel::Error,
+                        [&](ReportLevel, const std::string& message,
+                            const SourceLocation&) {
+                            messages.push_back(message);
+                        });
+    ModuleSystem system(reporter, [] {});
+    BUS_CHECK(!system.tryParse("Missing", "Iface") && messages.empty());
+    auto id = system.parse("Missing", "Iface");
+    BUS_CHECK(id.first == GUID(0, 0) && messages.size() == 1 &&
+              messages.back().find("No function called Missing "
+                                   "[interface=Iface].") !=
+                  std::string::npos);
+    auto guid = GUID2Str(GUID(1, 2));
+    system.parse(guid + ".Missing", "Iface");
+    BUS_CHECK(messages.size() == 2 &&
+              messages.back().find("No module's GUID is " + guid + '.') !=
+                  std::string::npos);
+}
+
+int main() {
+    testTrace();
+    testDefaultModule();
+    testStaleTrace();
+    testParseMessages();
+    return BusTest::finish();
+}
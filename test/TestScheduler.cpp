@@ -0,0 +1,130 @@
+#include "BusScheduler.hpp"
+#include "BusTest.hpp"
+#include <future>
+#include <vector>
+
+using namespace Bus;
+
+static void testParallelFor() {
+    BusTest::Errors errors;
+    Scheduler scheduler(4, *errors.reporter, [] { std::terminate(); });
+    std::vector<std::atomic_int> hits(10000);
+    scheduler.parallelFor(0, hits.size(), 16, [&](size_t first, size_t last) {
+        for(size_t i = first; i < last; ++i)
+            ++hits[i];
+    });
+    bool once = true;
+    for(auto&& hit : hits)
+        once &= hit == 1;
+    BUS_CHECK(once);
+    BUS_CHECK(errors.count == 0);
+}
+
+// Groups waited for from inside tasks, with more of them than workers.
+static size_t fib(Scheduler& scheduler, size_t n) {
+    if(n < 2)
+        return n;
+    size_t lhs = 0, rhs = 0;
+    TaskGroup group(scheduler);
+    group.run([&] { lhs = fib(scheduler, n - 1); });
+    rhs = fib(scheduler, n - 2);
+    group.wait();
+    return lhs + rhs;
+}
+
+static void testNested() {
+    BusTest::Errors errors;
+    Scheduler scheduler(2, *errors.reporter, [] { std::terminate(); });
+    BUS_CHECK(fib(scheduler, 18) == 2584);
+    BUS_CHECK(errors.count == 0);
+}
+
+// A thread outside the pool sleeps until the last task is done.
+static void testExternalWait() {
+    BusTest::Errors errors;
+    Scheduler scheduler(2, *errors.reporter, [] { std::terminate(); });
+    std::atomic_int done{ 0 };
+    {
+        TaskGroup group(scheduler);
+        for(int i = 0; i < 4; ++i)
+            group.run([&] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                ++done;
+            });
+        BUS_CHECK(group.wait() && done == 4 && group.done());
+    }
+    BUS_CHECK(errors.count == 0);
+}
+
+// The group only finishes once the failure is handled.
+static void testExceptions() {
+    BusTest::Errors errors;
+    std::atomic_int handled{ 0 };
+    Scheduler scheduler(2, *errors.reporter, [&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ++handled;
+    });
+    TaskGroup group(scheduler);
+    group.run([] { throw std::runtime_error("task"); });
+    group.run([] {});
+    // Lets the workers take the tasks rather than wait running them.
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    BUS_CHECK(!group.wait());
+    BUS_CHECK(handled == 1 && errors.count == 1);
+    BUS_CHECK(scheduler.stats().failed == 1);
+}
+
+#ifdef BUS_HAS_COROUTINE
+struct Detached final {
+    struct promise_type final {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+static Detached awaitGroup(Scheduler& scheduler, std::promise<bool>& res,
+                           std::atomic_int& done) {
+    co_await scheduler.schedule();
+    TaskGroup group(scheduler);
+    for(int i = 0; i < 8; ++i)
+        group.run([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ++done;
+        });
+    bool ok = co_await group;
+    res.set_value(ok && done == 8 && scheduler.onWorker());
+}
+
+// The coroutine is resumed by the group's last task.
+static void testCoroutine() {
+    BusTest::Errors errors;
+    Scheduler scheduler(1, *errors.reporter, [] { std::terminate(); });
+    std::promise<bool> res;
+    std::atomic_int done{ 0 };
+    awaitGroup(scheduler, res, done);
+    BUS_CHECK(res.get_future().get());
+    BUS_CHECK(errors.count == 0);
+}
+#endif
+
+int main() {
+    testParallelFor();
+    testNested();
+    testExternalWait();
+    testExceptions();
+#ifdef BUS_HAS_COROUTINE
+    testCoroutine();
+#endif
+    return BusTest::finish();
+}
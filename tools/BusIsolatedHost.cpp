@@ -0,0 +1,7 @@
+#include "../BusIsolated.hpp"
+
+// Started by ModuleSystem::loadModuleIsolated with the shared memory of the
+// module as descriptor 3, runs the module until its parent stops it.
+int main(int argc, char** argv) {
+    return Bus::runIsolatedHost(argc, argv);
+}
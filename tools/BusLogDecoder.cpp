@@ -0,0 +1,43 @@
+#include "../BusBinaryLog.hpp"
+#include <iostream>
+
+static void printException(std::exception_ptr ptr) {
+    try {
+        std::rethrow_exception(ptr);
+    } catch(const Bus::SourceLocation& loc) {
+        std::cerr << "at " << loc.module << ' ' << loc.srcFile << ':'
+                  << loc.line << ' ' << loc.functionName << std::endl;
+        try {
+            std::rethrow_if_nested(loc);
+        } catch(...) {
+            printException(std::current_exception());
+        }
+    } catch(const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        try {
+            std::rethrow_if_nested(ex);
+        } catch(...) {
+            printException(std::current_exception());
+        }
+    } catch(...) {
+        std::cerr << "Unknown exception" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <segment>..." << std::endl;
+        return 1;
+    }
+    int res = 0;
+    for(int i = 1; i < argc; ++i) {
+        try {
+            Bus::decodeBinaryLog(argv[i], std::cout);
+        } catch(...) {
+            std::cerr << "Failed to decode " << argv[i] << std::endl;
+            printException(std::current_exception());
+            res = 1;
+        }
+    }
+    return res;
+}